@@ -0,0 +1,237 @@
+// AssetCooker.cpp
+#include "AssetCooker.h"
+#include "../MeshCache.h"
+
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <filesystem>
+#include <algorithm>
+#include <stdexcept>
+
+namespace
+{
+	// The version of the cooking steps, it's increased when the output changes without the change of the settings
+	const uint32_t COOKER_VERSION = 1;
+	const char* MANIFEST_NAME = "cook_manifest.txt";
+	// The extension of the mesh cache that the renderer maps next to the model
+	const char* MESH_CACHE_EXTENSION = ".vkmesh";
+	const char* TEXTURE_EXTENSION = ".ktx2";
+
+	const uint64_t FNV_OFFSET_BASIS = 14695981039346656037ull;
+	const uint64_t FNV_PRIME = 1099511628211ull;
+}
+
+AssetCooker::AssetCooker(ThreadPool& pool, const CookSettings& settings) : pool(pool), settings(settings)
+{
+}
+
+
+
+uint32_t AssetCooker::run(const std::string& assetRoot)
+{
+	std::vector<Asset> assets;
+	findAssets(assetRoot, "models", ".obj", false, assets);
+	findAssets(assetRoot, "textures", ".png", true, assets);
+
+	std::string manifestPath = (std::filesystem::path(assetRoot) / MANIFEST_NAME).string();
+	std::unordered_map<std::string, ManifestEntry> manifest = loadManifest(manifestPath);
+
+	// Each asset is one task, the large assets also split their steps between the workers
+	pool.parallelFor(assets.size(), [&](size_t i)
+	{
+		try
+		{
+			cookAsset(assets[i], manifest);
+		}
+		catch (const std::exception& ex)
+		{
+			assets[i].error = ex.what();
+		}
+	});
+
+	// Only the successful results are saved, so the failed assets are cooked again on the next run
+	uint32_t cooked = 0;
+	uint32_t skipped = 0;
+	uint32_t failed = 0;
+	for (const auto& asset : assets)
+	{
+		if (!asset.error.empty())
+		{
+			std::cerr << "--Failed: " << asset.source << ": " << asset.error << std::endl;
+			manifest.erase(asset.name);
+			++failed;
+			continue;
+		}
+
+		std::cout << (asset.skipped ? "--Up to date: " : "--Cooked: ") << asset.source << " -> " << asset.output << std::endl;
+		manifest[asset.name] = ManifestEntry{ asset.contentHash, asset.settingsHash };
+		asset.skipped ? ++skipped : ++cooked;
+	}
+	saveManifest(manifestPath, manifest);
+
+	std::cout << "--Assets: " << assets.size() << " cooked: " << cooked << " up to date: " << skipped << " failed: " << failed << std::endl;
+	return failed;
+}
+
+
+
+void AssetCooker::findAssets(const std::string& assetRoot, const std::string& directory, const std::string& extension, bool texture, std::vector<Asset>& assets) const
+{
+	std::error_code error;
+	std::vector<std::string> names;
+	for (const auto& entry : std::filesystem::directory_iterator(std::filesystem::path(assetRoot) / directory, error))
+	{
+		if (entry.is_regular_file() && entry.path().extension() == extension)
+		{
+			names.push_back(directory + "/" + entry.path().filename().generic_string());
+		}
+	}
+	// The order of the directory isn't defined, the sorted list keeps the output and the manifest stable
+	std::sort(names.begin(), names.end());
+
+	for (const auto& name : names)
+	{
+		std::string source = (std::filesystem::path(assetRoot) / name).generic_string();
+		Asset asset{};
+		asset.name = name;
+		asset.source = source;
+		asset.output = texture ? std::filesystem::path(source).replace_extension(TEXTURE_EXTENSION).generic_string() : source + MESH_CACHE_EXTENSION;
+		asset.texture = texture;
+		assets.emplace_back(asset);
+	}
+}
+
+
+
+void AssetCooker::cookAsset(Asset& asset, const std::unordered_map<std::string, ManifestEntry>& manifest)
+{
+	asset.contentHash = hashFile(asset.source);
+	asset.settingsHash = settingsHash(asset.texture);
+
+	auto entry = manifest.find(asset.name);
+	if (!settings.force && entry != manifest.end() &&
+		entry->second.contentHash == asset.contentHash && entry->second.settingsHash == asset.settingsHash &&
+		std::filesystem::exists(asset.output))
+	{
+		// The renderer checks the mesh cache by the size and the write time of the model, they are refreshed for the touched model
+		asset.skipped = asset.texture || MeshCache::restamp(asset.output, asset.source);
+		if (asset.skipped)
+		{
+			return;
+		}
+	}
+
+	if (asset.texture)
+	{
+		TextureCooker cooker(pool, settings.texture);
+		cooker.cook(asset.source, asset.output);
+	}
+	else
+	{
+		MeshCooker cooker(pool, settings.mesh);
+		MeshCache cache;
+		cooker.cook(asset.source, asset.output, cache);
+		// The cache writes the file quietly, so the result is checked by opening it
+		if (!cache.open(asset.output, asset.source, cooker.cacheFlags()))
+		{
+			throw std::runtime_error("ERROR::AssetCooker::cookAsset()::Failed to write the mesh cache: " + asset.output);
+		}
+	}
+}
+
+
+
+uint64_t AssetCooker::settingsHash(bool texture) const
+{
+	std::ostringstream stream;
+	stream << COOKER_VERSION << ' ';
+	if (texture)
+	{
+		stream << "texture " << settings.texture.compressBC1;
+	}
+	else
+	{
+		MeshCooker cooker(pool, settings.mesh);
+		stream << "mesh " << MeshCache::VERSION << ' ' << cooker.cacheFlags() << ' ' << settings.mesh.maxLodCount;
+	}
+
+	std::string text = stream.str();
+	return hashBytes(text.data(), text.size(), FNV_OFFSET_BASIS);
+}
+
+
+
+std::unordered_map<std::string, AssetCooker::ManifestEntry> AssetCooker::loadManifest(const std::string& manifestPath)
+{
+	// Each line is "<content hash> <settings hash> <source>", the hashes are hexadecimal
+	std::unordered_map<std::string, ManifestEntry> manifest;
+	std::ifstream file(manifestPath);
+	std::string line;
+	while (std::getline(file, line))
+	{
+		std::istringstream stream(line);
+		ManifestEntry entry{};
+		std::string source;
+		if (stream >> std::hex >> entry.contentHash >> entry.settingsHash && std::getline(stream >> std::ws, source))
+		{
+			manifest[source] = entry;
+		}
+	}
+	return manifest;
+}
+
+
+
+void AssetCooker::saveManifest(const std::string& manifestPath, const std::unordered_map<std::string, ManifestEntry>& manifest)
+{
+	std::vector<std::string> sources;
+	for (const auto& entry : manifest)
+	{
+		sources.push_back(entry.first);
+	}
+	std::sort(sources.begin(), sources.end());
+
+	std::ofstream file(manifestPath, std::ios::trunc);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("ERROR::AssetCooker::saveManifest()::Failed to write the manifest: " + manifestPath);
+	}
+	for (const auto& source : sources)
+	{
+		const ManifestEntry& entry = manifest.at(source);
+		file << std::hex << entry.contentHash << ' ' << entry.settingsHash << ' ' << source << '\n';
+	}
+}
+
+
+
+uint64_t AssetCooker::hashFile(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("ERROR::AssetCooker::hashFile()::Failed to open the file: " + path);
+	}
+
+	uint64_t hash = FNV_OFFSET_BASIS;
+	std::vector<char> buffer(1024 * 1024);
+	while (file)
+	{
+		file.read(buffer.data(), static_cast<std::streamsize>(buffer.size()));
+		hash = hashBytes(buffer.data(), static_cast<size_t>(file.gcount()), hash);
+	}
+	return hash;
+}
+
+
+
+uint64_t AssetCooker::hashBytes(const void* data, size_t size, uint64_t hash)
+{
+	const unsigned char* bytes = static_cast<const unsigned char*>(data);
+	for (size_t i = 0; i < size; ++i)
+	{
+		hash = (hash ^ bytes[i]) * FNV_PRIME;
+	}
+	return hash;
+}
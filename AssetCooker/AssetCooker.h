@@ -0,0 +1,77 @@
+// AssetCooker.h
+
+#ifndef ASSETCOOKER_H
+#define ASSETCOOKER_H
+
+#include "../ThreadPool.h"
+#include "../MeshCooker.h"
+#include "../TextureCooker.h"
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+// The options of the command line
+struct CookSettings
+{
+	MeshCookSettings mesh;
+	TextureCookSettings texture;
+	// Cooking of all assets even if their content and settings weren't changed
+	bool force;
+};
+
+// The offline tool that cooks models/*.obj to the mesh caches and textures/*.png to the KTX2 textures with the mip chains
+/// The assets are cooked in parallel, each of them also uses the worker threads for its own steps
+/// The hashes of the content and of the settings are kept in the manifest, the asset is skipped when both match and its output exists
+class AssetCooker
+{
+public:
+	AssetCooker(ThreadPool& pool, const CookSettings& settings);
+
+	// 1. Function to cook all assets under assetRoot, returns the number of the assets that failed
+	uint32_t run(const std::string& assetRoot);
+
+private:
+	// The asset found in the directories of the sources
+	struct Asset
+	{
+		// The path relative to the asset root, it's the key of the manifest
+		std::string name;
+		std::string source;
+		std::string output;
+		bool texture;
+		uint64_t contentHash;
+		uint64_t settingsHash;
+		// The result of the cooking
+		bool skipped;
+		std::string error;
+	};
+
+	// The hashes of the last successful cooking of the source
+	struct ManifestEntry
+	{
+		uint64_t contentHash;
+		uint64_t settingsHash;
+	};
+
+	// Function to find the sources with the extension in the directory
+	void findAssets(const std::string& assetRoot, const std::string& directory, const std::string& extension, bool texture, std::vector<Asset>& assets) const;
+	// Function to cook one asset or to skip it when it's up to date
+	void cookAsset(Asset& asset, const std::unordered_map<std::string, ManifestEntry>& manifest);
+	// Function to get the hash of the settings that change the output of the asset type
+	uint64_t settingsHash(bool texture) const;
+
+	// Function to read and write the manifest, the missing manifest is empty
+	static std::unordered_map<std::string, ManifestEntry> loadManifest(const std::string& manifestPath);
+	static void saveManifest(const std::string& manifestPath, const std::unordered_map<std::string, ManifestEntry>& manifest);
+
+	// Function to hash the content of the file by 64-bit FNV-1a
+	static uint64_t hashFile(const std::string& path);
+	static uint64_t hashBytes(const void* data, size_t size, uint64_t hash);
+
+	ThreadPool& pool;
+	CookSettings settings;
+};
+
+#endif // ASSETCOOKER_H
@@ -0,0 +1,67 @@
+// main.cpp
+
+#define STB_IMAGE_IMPLEMENTATION
+
+#include "AssetCooker.h"
+
+#include <iostream>
+#include <string>
+#include <cstdlib>
+
+// The command line: AssetCooker [asset root] [--bc1] [--force] [--threads N]
+/// The asset root is the working directory of the renderer, it has the models and textures directories
+int main(int argc, char* argv[])
+{
+	std::string assetRoot = ".";
+	uint32_t threadCount = std::thread::hardware_concurrency();
+
+	// The settings match the options of the renderer in Screen.h, otherwise the renderer rebuilds the mesh caches
+	CookSettings settings{};
+	settings.mesh.optimize = true;
+	settings.mesh.compactVertices = true;
+	settings.mesh.packedNormals = true;
+	settings.mesh.maxLodCount = 6;
+	settings.mesh.lodTrianglePercent = 50;
+	settings.mesh.lodErrorPermille = 50;
+	settings.mesh.verbose = false;
+	settings.texture.compressBC1 = false;
+	settings.force = false;
+
+	for (int i = 1; i < argc; ++i)
+	{
+		std::string option = argv[i];
+		if (option == "--bc1")
+		{
+			settings.texture.compressBC1 = true;
+		}
+		else if (option == "--force")
+		{
+			settings.force = true;
+		}
+		else if (option == "--threads" && i + 1 < argc)
+		{
+			threadCount = static_cast<uint32_t>(std::strtoul(argv[++i], nullptr, 10));
+		}
+		else if (!option.empty() && option[0] != '-')
+		{
+			assetRoot = option;
+		}
+		else
+		{
+			std::cerr << "Usage: AssetCooker [asset root] [--bc1] [--force] [--threads N]" << std::endl;
+			return 1;
+		}
+	}
+
+	try
+	{
+		ThreadPool pool(threadCount);
+		AssetCooker cooker(pool, settings);
+		return (cooker.run(assetRoot) == 0) ? 0 : 1;
+	}
+	catch (const std::exception& ex)
+	{
+		std::cerr << ex.what() << std::endl;
+		return 1;
+	}
+}
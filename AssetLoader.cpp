@@ -0,0 +1,238 @@
+// AssetLoader.cpp
+#include "AssetLoader.h"
+#include "Ktx2Loader.h"
+#include "MipGenerator.h"
+#include "TextureDecoder.h"
+
+#include <stdexcept>
+#include <chrono>
+#include <thread>
+
+void AssetLoader::WorkerAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+	loader.pool.submit([handle]() { handle.resume(); });
+}
+
+
+
+void AssetLoader::RenderThreadAwaiter::await_suspend(std::coroutine_handle<> handle)
+{
+	std::lock_guard<std::mutex> lock(loader.readyMutex);
+	loader.ready.emplace_back(handle);
+}
+
+
+
+AssetLoader::AssetLoader(ThreadPool& pool) : pool(pool)
+{
+	cancelled = false;
+}
+
+
+
+AssetTask<std::unique_ptr<MeshCache>> AssetLoader::loadMesh(std::string path)
+{
+	co_await resumeOnWorker();
+
+	// The error is passed after the return to the render thread, so the caller always continues there
+	auto cache = std::make_unique<MeshCache>();
+	std::exception_ptr error;
+	try
+	{
+		if (!meshLoader)
+		{
+			throw std::runtime_error("ERROR::AssetLoader::loadMesh()::The mesh loader isn't set");
+		}
+		if (!isCancelled())
+		{
+			meshLoader(path, *cache);
+		}
+	}
+	catch (...)
+	{
+		error = std::current_exception();
+	}
+
+	co_await resumeOnRenderThread();
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+	co_return cache;
+}
+
+
+
+AssetTask<TextureData> AssetLoader::loadTexture(std::string path, bool generateMips)
+{
+	co_await resumeOnWorker();
+
+	TextureData texture{};
+	std::exception_ptr error;
+	try
+	{
+		if (!isCancelled() && Ktx2Loader::isKtx2(path))
+		{
+			// The file that stores only the RGBA8 level 0 gets its levels here, the same way as the decoded image
+			Ktx2Loader::load(path, texture);
+			if (generateMips && texture.levels.empty())
+			{
+				MipGenerator generator(pool);
+				generator.generateInPlace(texture.pixels, texture.width, texture.height, texture.format == VK_FORMAT_R8G8B8A8_SRGB, texture.levels);
+			}
+		}
+		else if (!isCancelled())
+		{
+			TextureDecoder::Header header;
+			if (!TextureDecoder::readInfo(path, header))
+			{
+				throw std::runtime_error("ERROR::AssetLoader::loadTexture()::Failed to load texture image: " + path);
+			}
+			texture.width = header.width;
+			texture.height = header.height;
+
+			// The image is decoded into the first level of the chain, the next levels are added after it without copying it
+			texture.pixels.resize(static_cast<size_t>(texture.width) * texture.height * 4);
+			TextureDecoder::decode(path, header, texture.pixels.data());
+			if (generateMips)
+			{
+				MipGenerator generator(pool);
+				generator.generateInPlace(texture.pixels, texture.width, texture.height, true, texture.levels);
+			}
+		}
+	}
+	catch (...)
+	{
+		error = std::current_exception();
+	}
+
+	co_await resumeOnRenderThread();
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+	co_return texture;
+}
+
+
+
+AssetTask<TextureData> AssetLoader::loadTextureToStaging(std::string path, StagingRing& staging)
+{
+	// The KTX2 levels are read to the pixels, the renderer copies them to the ring
+	if (Ktx2Loader::isKtx2(path))
+	{
+		co_return co_await loadTexture(path);
+	}
+
+	co_await resumeOnWorker();
+
+	TextureData texture{};
+	std::exception_ptr error;
+	try
+	{
+		if (!isCancelled())
+		{
+			TextureDecoder::Header header;
+			if (!TextureDecoder::readInfo(path, header))
+			{
+				throw std::runtime_error("ERROR::AssetLoader::loadTextureToStaging()::Failed to load texture image: " + path);
+			}
+			texture.width = header.width;
+			texture.height = header.height;
+
+			// The region is aligned to the texel for vkCmdCopyBufferToImage, the image is decoded to the memory when the ring is full
+			uint64_t size = static_cast<uint64_t>(texture.width) * texture.height * 4;
+			if (staging.reserve(size, 16, texture.staged))
+			{
+				try
+				{
+					TextureDecoder::decode(path, header, texture.staged.data);
+				}
+				catch (...)
+				{
+					staging.release(texture.staged);
+					throw;
+				}
+			}
+			else
+			{
+				texture.pixels.resize(static_cast<size_t>(size));
+				TextureDecoder::decode(path, header, texture.pixels.data());
+			}
+		}
+	}
+	catch (...)
+	{
+		error = std::current_exception();
+	}
+
+	co_await resumeOnRenderThread();
+	if (error)
+	{
+		std::rethrow_exception(error);
+	}
+	co_return texture;
+}
+
+
+
+void AssetLoader::start(AssetTask<void> task)
+{
+	tasks.emplace_back(std::move(task));
+	tasks.back().resume();
+}
+
+
+
+void AssetLoader::pump()
+{
+	std::vector<std::coroutine_handle<>> resumed;
+	{
+		std::lock_guard<std::mutex> lock(readyMutex);
+		resumed.swap(ready);
+	}
+
+	for (auto handle : resumed)
+	{
+		handle.resume();
+	}
+
+	// The finished coroutines are removed before their errors are passed on, so each error is reported once
+	for (size_t i = 0; i < tasks.size();)
+	{
+		if (!tasks[i].isDone())
+		{
+			++i;
+			continue;
+		}
+
+		AssetTask<void> task = std::move(tasks[i]);
+		tasks.erase(tasks.begin() + i);
+		task.result();
+	}
+}
+
+
+
+void AssetLoader::drain()
+{
+	cancelled = true;
+
+	// The coroutines on the worker threads return to the render thread, they see the cancellation and finish
+	while (!tasks.empty())
+	{
+		try
+		{
+			pump();
+		}
+		catch (const std::exception&)
+		{
+			// The errors of the cancelled loading aren't needed anymore
+		}
+
+		if (!tasks.empty())
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+}
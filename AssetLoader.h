@@ -0,0 +1,213 @@
+// AssetLoader.h
+
+#ifndef ASSETLOADER_H
+#define ASSETLOADER_H
+
+#include "ThreadPool.h"
+#include "MeshCache.h"
+#include "TextureData.h"
+
+#include <coroutine>
+#include <exception>
+#include <functional>
+#include <optional>
+#include <utility>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+template<typename T>
+class AssetTask;
+
+// The common part of the promises: the coroutine starts when it's awaited and returns to the awaiting coroutine at the end
+struct AssetPromiseBase
+{
+	struct FinalAwaiter
+	{
+		bool await_ready() const noexcept { return false; }
+
+		template<typename Promise>
+		std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept
+		{
+			std::coroutine_handle<> continuation = handle.promise().continuation;
+			return continuation ? continuation : std::noop_coroutine();
+		}
+
+		void await_resume() const noexcept {}
+	};
+
+	std::suspend_always initial_suspend() noexcept { return {}; }
+	FinalAwaiter final_suspend() noexcept { return {}; }
+	void unhandled_exception() { error = std::current_exception(); }
+
+	std::coroutine_handle<> continuation;
+	std::exception_ptr error;
+};
+
+template<typename T>
+struct AssetPromise : AssetPromiseBase
+{
+	AssetTask<T> get_return_object();
+	void return_value(T result) { value.emplace(std::move(result)); }
+
+	T result()
+	{
+		if (error)
+		{
+			std::rethrow_exception(error);
+		}
+		return std::move(*value);
+	}
+
+	std::optional<T> value;
+};
+
+template<>
+struct AssetPromise<void> : AssetPromiseBase
+{
+	AssetTask<void> get_return_object();
+	void return_void() {}
+
+	void result()
+	{
+		if (error)
+		{
+			std::rethrow_exception(error);
+		}
+	}
+};
+
+// The coroutine of the asset loading, its result is taken by co_await
+/// The exception of the coroutine is passed to the awaiting coroutine
+template<typename T>
+class AssetTask
+{
+public:
+	using promise_type = AssetPromise<T>;
+
+	explicit AssetTask(std::coroutine_handle<promise_type> handle) : handle(handle) {}
+	AssetTask(AssetTask&& other) noexcept : handle(std::exchange(other.handle, {})) {}
+	AssetTask& operator=(AssetTask&& other) noexcept
+	{
+		if (this != &other)
+		{
+			if (handle)
+			{
+				handle.destroy();
+			}
+			handle = std::exchange(other.handle, {});
+		}
+		return *this;
+	}
+
+	AssetTask(const AssetTask&) = delete;
+	AssetTask& operator=(const AssetTask&) = delete;
+
+	bool await_ready() const noexcept { return false; }
+	std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept
+	{
+		handle.promise().continuation = awaiting;
+		return handle;
+	}
+	T await_resume() { return handle.promise().result(); }
+
+	// Function to run the coroutine that nobody awaits until its first suspension
+	void resume() { handle.resume(); };
+	bool isDone() const { return !handle || handle.done(); };
+	T result() { return handle.promise().result(); };
+
+	~AssetTask()
+	{
+		if (handle)
+		{
+			handle.destroy();
+		}
+	}
+
+private:
+	std::coroutine_handle<promise_type> handle;
+};
+
+template<typename T>
+AssetTask<T> AssetPromise<T>::get_return_object()
+{
+	return AssetTask<T>(std::coroutine_handle<AssetPromise<T>>::from_promise(*this));
+}
+
+inline AssetTask<void> AssetPromise<void>::get_return_object()
+{
+	return AssetTask<void>(std::coroutine_handle<AssetPromise<void>>::from_promise(*this));
+}
+
+// The class that moves the loading coroutines between the worker threads and the render thread
+/// The reading and the decoding of the files run on the workers, the continuations that use Vulkan are resumed by pump() on the render thread
+class AssetLoader
+{
+public:
+	// The awaitable that continues the coroutine on a worker thread
+	struct WorkerAwaiter
+	{
+		AssetLoader& loader;
+
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<> handle);
+		void await_resume() const noexcept {}
+	};
+
+	// The awaitable that continues the coroutine on the render thread at the next pump()
+	struct RenderThreadAwaiter
+	{
+		AssetLoader& loader;
+
+		bool await_ready() const noexcept { return false; }
+		void await_suspend(std::coroutine_handle<> handle);
+		void await_resume() const noexcept {}
+	};
+
+	explicit AssetLoader(ThreadPool& pool);
+
+	AssetLoader(const AssetLoader&) = delete;
+	AssetLoader& operator=(const AssetLoader&) = delete;
+
+	WorkerAwaiter resumeOnWorker() { return WorkerAwaiter{ *this }; };
+	RenderThreadAwaiter resumeOnRenderThread() { return RenderThreadAwaiter{ *this }; };
+
+	// 1. Coroutine to load the mesh by the mesh loader on a worker thread, it returns on the render thread
+	AssetTask<std::unique_ptr<MeshCache>> loadMesh(std::string path);
+	// 2. Coroutine to decode the texture on a worker thread, it returns on the render thread
+	/// The KTX2 file keeps its block compressed levels, the other images are decoded to RGBA8
+	/// The mip chain of the decoded image is built on the worker when generateMips is set, the streamed textures need all levels in memory
+	AssetTask<TextureData> loadTexture(std::string path, bool generateMips = false);
+	// 3. Coroutine to decode the image on a worker thread straight into the region of the staging ring, it returns on the render thread
+	/// The caller uploads the region and releases it, the image is decoded to the pixels when the ring is full or it's the KTX2 file
+	AssetTask<TextureData> loadTextureToStaging(std::string path, StagingRing& staging);
+
+	// 4. Function to run the coroutine, the loader keeps it until it's finished
+	void start(AssetTask<void> task);
+	// 5. Function to resume the coroutines that wait for the render thread, it's called once per frame
+	/// The exceptions of the finished coroutines are passed to the caller
+	void pump();
+	// 6. Function to cancel the loading and to wait for the started coroutines before the renderer is destroyed
+	void drain();
+
+	// The function that fills the mesh cache from the model file, it's called on the worker threads
+	void setMeshLoader(std::function<void(const std::string&, MeshCache&)> loader) { meshLoader = std::move(loader); };
+	bool isCancelled() const { return cancelled.load(); };
+	bool isIdle() const { return tasks.empty(); };
+
+private:
+	ThreadPool& pool;
+	std::function<void(const std::string&, MeshCache&)> meshLoader;
+
+	// The started coroutines, they are used only on the render thread
+	std::vector<AssetTask<void>> tasks;
+	// The coroutines that wait for the render thread, the worker threads add them
+	std::mutex readyMutex;
+	std::vector<std::coroutine_handle<>> ready;
+	std::atomic<bool> cancelled;
+};
+
+#endif // ASSETLOADER_H
@@ -0,0 +1,341 @@
+// Benchmark.cpp
+#include "Benchmark.h"
+#include "ObjParser.h"
+#include "Screen.h"
+
+#include <tiny_obj_loader.h>
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <filesystem>
+#include <chrono>
+#include <algorithm>
+#include <thread>
+#include <cmath>
+#include <stdexcept>
+
+bool Benchmark::run(const std::string& option)
+{
+	if (option == "--benchmark-obj")
+	{
+		objParser();
+		return true;
+	}
+	if (option == "--benchmark-startup")
+	{
+		startup();
+		return true;
+	}
+	if (option == "--benchmark-recording")
+	{
+		recording();
+		return true;
+	}
+	return false;
+}
+
+
+
+void Benchmark::objParser()
+{
+	std::vector<std::string> files;
+	for (const auto& entry : std::filesystem::directory_iterator("models"))
+	{
+		if (entry.path().extension() == ".obj")
+		{
+			files.emplace_back(entry.path().string());
+		}
+	}
+	std::sort(files.begin(), files.end());
+
+	// The synthetic meshes of 0.5M and 2M triangles show how the parser scales on the large scans
+	std::filesystem::path tempDirectory = std::filesystem::temp_directory_path();
+	for (int gridSize : { 512, 1024 })
+	{
+		std::string fileName = (tempDirectory / ("benchmark_grid_" + std::to_string(gridSize) + ".obj")).string();
+		writeSyntheticObj(fileName, gridSize);
+		files.emplace_back(fileName);
+	}
+
+	std::vector<unsigned> threads = threadCounts();
+
+	std::cout << "OBJ parsing, best of 3 runs in ms" << std::endl;
+	std::cout << std::left << std::setw(28) << "file" << std::right << std::setw(10) << "MB" << std::setw(12) << "tinyobj";
+	for (unsigned count : threads)
+	{
+		std::cout << std::setw(12) << ("x" + std::to_string(count));
+	}
+	std::cout << std::endl;
+
+	// The times mean nothing if the parsers read different meshes, so each file is compared once before the timing
+	for (const auto& fileName : files)
+	{
+		compareWithTinyobj(fileName);
+	}
+
+	for (const auto& fileName : files)
+	{
+		double fileSize = static_cast<double>(std::filesystem::file_size(fileName)) / (1024.0 * 1024.0);
+		std::cout << std::left << std::setw(28) << std::filesystem::path(fileName).filename().string() << std::right <<
+			std::fixed << std::setprecision(2) << std::setw(10) << fileSize;
+
+		double tinyobjTime = measure([&fileName]()
+		{
+			tinyobj::attrib_t attrib;
+			std::vector<tinyobj::shape_t> shapes;
+			std::vector<tinyobj::material_t> materials;
+			std::string warn, err;
+			tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, fileName.c_str());
+		});
+		std::cout << std::setw(12) << tinyobjTime;
+
+		for (unsigned count : threads)
+		{
+			// The calling thread takes part in the parsing, so the pool gets one thread less
+			ThreadPool pool(count - 1);
+			ObjParser parser(pool);
+			double parserTime = measure([&parser, &fileName]()
+			{
+				tinyobj::attrib_t attrib;
+				std::vector<tinyobj::index_t> indices;
+				parser.parse(fileName, attrib, indices);
+			});
+			std::cout << std::setw(12) << parserTime;
+		}
+		std::cout << std::endl;
+	}
+}
+
+
+
+void Benchmark::startup()
+{
+	// The serial run is the order of the stages before the task graph, its critical path is the sum of all stages
+	for (bool serial : { true, false })
+	{
+		std::vector<uint32_t> path;
+		std::vector<std::string> names;
+		std::vector<TaskTiming> timings;
+		double wallTime, totalTime, criticalTime;
+		{
+			Screen screen(serial);
+			const TaskGraph& graph = screen.getStartupGraph();
+			criticalTime = graph.criticalPath(path);
+			wallTime = graph.wallTime();
+			totalTime = graph.totalTime();
+			for (uint32_t i = 0; i < graph.size(); ++i)
+			{
+				names.emplace_back(graph.name(i));
+				timings.emplace_back(graph.timing(i));
+			}
+		}
+
+		std::cout << (serial ? "Serial startup" : "Task graph startup") << ", ms" << std::endl;
+		std::cout << std::left << std::setw(28) << "stage" << std::right << std::setw(10) << "start" << std::setw(10) << "time" << std::endl;
+		for (size_t i = 0; i < names.size(); ++i)
+		{
+			// The stages of the critical path are marked by *
+			bool critical = std::find(path.begin(), path.end(), static_cast<uint32_t>(i)) != path.end();
+			std::cout << std::left << std::setw(28) << (critical ? "*" : " ") + names[i] << std::right << std::fixed << std::setprecision(2) <<
+				std::setw(10) << timings[i].start << std::setw(10) << timings[i].duration << std::endl;
+		}
+		// In the serial run each stage waits for the previous one, the chain of the declared dependencies is what the task graph can reach
+		std::cout << "wall: " << wallTime << " stages: " << totalTime << " critical path: " << (serial ? totalTime : criticalTime) <<
+			" dependency chain: " << criticalTime << std::endl << std::endl;
+	}
+}
+
+
+
+void Benchmark::recording()
+{
+	Screen screen;
+	std::vector<unsigned> threads = threadCounts();
+
+	// On one thread the draws are recorded straight to the primary command buffer
+	std::cout << "Recording of the frame, one command per draw, best of 5 runs in ms" << std::endl;
+	std::cout << std::left << std::setw(12) << "draws" << std::right;
+	for (unsigned count : threads)
+	{
+		std::cout << std::setw(12) << ("x" + std::to_string(count));
+	}
+	std::cout << std::endl;
+
+	for (uint32_t drawCount : { 512u, 2048u, 8192u, 16384u })
+	{
+		std::cout << std::left << std::setw(12) << drawCount << std::right << std::fixed << std::setprecision(3);
+		for (unsigned count : threads)
+		{
+			screen.setRecordingBenchmark(count, drawCount);
+			std::cout << std::setw(12) << measure([&screen]() { screen.recordBenchmarkFrame(); }, 5);
+		}
+		std::cout << std::endl;
+	}
+
+	// The uploads of the startup can still be executing when the screen is destroyed
+	vkDeviceWaitIdle(screen.get_device());
+}
+
+
+
+double Benchmark::measure(const std::function<void()>& task, int runs)
+{
+	double best = 0.0;
+	for (int i = 0; i < runs; ++i)
+	{
+		auto startTime = std::chrono::high_resolution_clock::now();
+		task();
+		auto endTime = std::chrono::high_resolution_clock::now();
+
+		double time = std::chrono::duration<double, std::chrono::milliseconds::period>(endTime - startTime).count();
+		best = (i == 0) ? time : std::min(best, time);
+	}
+	return best;
+}
+
+
+
+void Benchmark::compareWithTinyobj(const std::string& fileName)
+{
+	tinyobj::attrib_t expected;
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	std::string warn, err;
+	// tinyobj splits the quads by the shorter diagonal and ObjParser makes a fan, so the polygons are read as they are written
+	/// and the fan of each of them is compared, the choice of the diagonal isn't the part of the check
+	if (!tinyobj::LoadObj(&expected, &shapes, &materials, &warn, &err, fileName.c_str(), nullptr, false))
+	{
+		throw std::runtime_error("ERROR::Benchmark::compareWithTinyobj()::tinyobj failed to load " + fileName + ": " + err);
+	}
+
+	ThreadPool pool(std::max(1u, std::thread::hardware_concurrency()) - 1);
+	ObjParser parser(pool);
+	tinyobj::attrib_t attrib;
+	std::vector<tinyobj::index_t> indices;
+	parser.parse(fileName, attrib, indices);
+
+	// The numbers are read by different float parsers, so they can differ in the last bits
+	auto sameFloats = [](const std::vector<tinyobj::real_t>& a, const std::vector<tinyobj::real_t>& b)
+	{
+		if (a.size() != b.size())
+		{
+			return false;
+		}
+		for (size_t i = 0; i < a.size(); ++i)
+		{
+			if (std::fabs(a[i] - b[i]) > 1e-5f * std::max(1.0f, std::fabs(static_cast<float>(a[i]))))
+			{
+				return false;
+			}
+		}
+		return true;
+	};
+	std::string mismatch;
+	if (!sameFloats(attrib.vertices, expected.vertices))
+	{
+		mismatch = "vertices";
+	}
+	else if (!sameFloats(attrib.normals, expected.normals))
+	{
+		mismatch = "normals";
+	}
+	else if (!sameFloats(attrib.texcoords, expected.texcoords))
+	{
+		mismatch = "texcoords";
+	}
+	// tinyobj fills the white color of each vertex when the file has no colors, ObjParser leaves them empty
+	else if (!attrib.colors.empty() && !sameFloats(attrib.colors, expected.colors))
+	{
+		mismatch = "colors";
+	}
+	else
+	{
+		// The indices of all shapes are in one array of ObjParser, each polygon is the fan around its first corner
+		std::vector<tinyobj::index_t> expectedIndices;
+		for (const auto& shape : shapes)
+		{
+			size_t first = 0;
+			for (size_t cornerCount : shape.mesh.num_face_vertices)
+			{
+				for (size_t i = 1; i + 1 < cornerCount; ++i)
+				{
+					expectedIndices.push_back(shape.mesh.indices[first]);
+					expectedIndices.push_back(shape.mesh.indices[first + i]);
+					expectedIndices.push_back(shape.mesh.indices[first + i + 1]);
+				}
+				first += cornerCount;
+			}
+		}
+		bool sameIndices = (indices.size() == expectedIndices.size());
+		for (size_t i = 0; sameIndices && i < indices.size(); ++i)
+		{
+			sameIndices = indices[i].vertex_index == expectedIndices[i].vertex_index &&
+							indices[i].normal_index == expectedIndices[i].normal_index &&
+							indices[i].texcoord_index == expectedIndices[i].texcoord_index;
+		}
+		if (!sameIndices)
+		{
+			mismatch = "indices";
+		}
+	}
+
+	if (!mismatch.empty())
+	{
+		throw std::runtime_error("ERROR::Benchmark::compareWithTinyobj()::ObjParser and tinyobj read different " + mismatch + " from " + fileName);
+	}
+}
+
+
+
+void Benchmark::writeSyntheticObj(const std::string& fileName, int gridSize)
+{
+	// The file is written on each run, the one that was left by an older or interrupted run could have a different mesh
+	std::ofstream file(fileName, std::ios::trunc);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("ERROR::Benchmark::writeSyntheticObj()::Failed to create file " + fileName);
+	}
+
+	file << std::fixed << std::setprecision(6);
+	for (int y = 0; y <= gridSize; ++y)
+	{
+		for (int x = 0; x <= gridSize; ++x)
+		{
+			float u = static_cast<float>(x) / gridSize;
+			float v = static_cast<float>(y) / gridSize;
+			file << "v " << u * 10.0f << ' ' << v * 10.0f << ' ' << 0.25f * std::sin(u * 20.0f) * std::cos(v * 20.0f) << '\n';
+			file << "vt " << u << ' ' << v << '\n';
+			file << "vn 0.000000 0.000000 1.000000\n";
+		}
+	}
+
+	int rowSize = gridSize + 1;
+	for (int y = 0; y < gridSize; ++y)
+	{
+		for (int x = 0; x < gridSize; ++x)
+		{
+			int i0 = y * rowSize + x + 1;
+			int i1 = i0 + 1;
+			int i2 = i0 + rowSize + 1;
+			int i3 = i0 + rowSize;
+			file << "f " << i0 << '/' << i0 << '/' << i0 << ' ' << i1 << '/' << i1 << '/' << i1 << ' ' << i2 << '/' << i2 << '/' << i2 << '\n';
+			file << "f " << i0 << '/' << i0 << '/' << i0 << ' ' << i2 << '/' << i2 << '/' << i2 << ' ' << i3 << '/' << i3 << '/' << i3 << '\n';
+		}
+	}
+}
+
+
+
+std::vector<unsigned> Benchmark::threadCounts()
+{
+	unsigned hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+
+	std::vector<unsigned> counts;
+	for (unsigned count = 1; count < hardwareThreads; count *= 2)
+	{
+		counts.emplace_back(count);
+	}
+	counts.emplace_back(hardwareThreads);
+	return counts;
+}
@@ -0,0 +1,38 @@
+// Benchmark.h
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <string>
+#include <vector>
+#include <functional>
+
+// The class that measures the loading stages of the renderer, it's started with the command line option
+/// --benchmark-obj : parsing of the OBJ files with tinyobj and with ObjParser on different number of threads
+/// --benchmark-startup : the stages of the initialization one after another and by the task graph, their times and critical paths
+/// --benchmark-recording : the recording of the draw commands to the secondary command buffers on different number of threads
+class Benchmark
+{
+public:
+	// 1. Function to run the benchmark selected by the command line option, returns false for unknown option
+	bool run(const std::string& option);
+
+	// 2. Benchmark of the OBJ parsers on the models of the repository and on the large synthetic meshes
+	void objParser();
+	// 3. Benchmark of the initialization of the renderer, the window and Vulkan are created once for each mode
+	void startup();
+	// 4. Benchmark of the recording of the command buffer of the frame, the number of the draws against the number of the recording threads
+	void recording();
+
+private:
+	// Function to get the best time of several runs in milliseconds
+	double measure(const std::function<void()>& task, int runs = 3);
+	// Function to compare the attributes and the indices of ObjParser with the ones of tinyobj, throws if they are different
+	void compareWithTinyobj(const std::string& fileName);
+	// Function to write the grid of quads with positions, texcoords and normals to the OBJ file
+	void writeSyntheticObj(const std::string& fileName, int gridSize);
+	// Function to make the list of thread counts 1, 2, 4 ... up to the number of hardware threads
+	std::vector<unsigned> threadCounts();
+};
+
+#endif // BENCHMARK_H
@@ -0,0 +1,106 @@
+// GeometryPool.cpp
+#include "GeometryPool.h"
+
+#include <gtc/matrix_transform.hpp>
+
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+GeometryPool::GeometryPool()
+{
+	vertexBytes = 0;
+	indexBytes = 0;
+	indexSize = sizeof(uint32_t);
+	vertexTop = 0;
+	indexTop = 0;
+}
+
+
+
+void GeometryPool::reset(VkDeviceSize vertexCapacity, VkDeviceSize indexCapacity, uint32_t indexSize)
+{
+	if (indexSize != sizeof(uint16_t) && indexSize != sizeof(uint32_t))
+	{
+		throw std::runtime_error("ERROR::GeometryPool::reset()::The index size must be 2 or 4 bytes");
+	}
+
+	meshes.clear();
+	vertexBytes = vertexCapacity;
+	indexBytes = indexCapacity;
+	this->indexSize = indexSize;
+	vertexTop = 0;
+	indexTop = 0;
+}
+
+
+
+uint32_t GeometryPool::addMesh(const std::string& path, const MeshCache& cache)
+{
+	const MeshCacheHeader& header = cache.getHeader();
+	if (cache.indexSize() > indexSize)
+	{
+		throw std::runtime_error("ERROR::GeometryPool::addMesh()::The 32-bit indices don't fit the 16-bit pool: " + path);
+	}
+
+	// The start of the mesh is aligned to its stride, so vertexOffset addresses it in the buffer that is bound at the offset 0
+	VkDeviceSize stride = header.vertexStride;
+	VkDeviceSize vertexStart = (vertexTop + stride - 1) / stride * stride;
+	VkDeviceSize indexStart = indexTop;
+	if (vertexStart + cache.vertexDataSize() > vertexBytes ||
+		indexStart + static_cast<VkDeviceSize>(cache.indexCount()) * indexSize > indexBytes)
+	{
+		throw std::runtime_error("ERROR::GeometryPool::addMesh()::The geometry pool is full: " + path);
+	}
+
+	PoolMesh mesh{};
+	mesh.path = path;
+	mesh.vertexLayout = static_cast<VertexLayout>(cache.vertexLayout());
+	mesh.vertexCount = cache.vertexCount();
+	mesh.indexCount = cache.indexCount();
+	mesh.vertexOffset = static_cast<int32_t>(vertexStart / stride);
+	mesh.firstIndex = static_cast<uint32_t>(indexStart / indexSize);
+	mesh.vertexByteOffset = vertexStart;
+	mesh.indexByteOffset = indexStart;
+	mesh.lods.assign(cache.lods(), cache.lods() + cache.lodCount());
+	mesh.meshlets.assign(cache.meshlets(), cache.meshlets() + cache.meshletCount());
+
+	glm::vec3 boundsMin(header.boundsMin[0], header.boundsMin[1], header.boundsMin[2]);
+	glm::vec3 boundsMax(header.boundsMax[0], header.boundsMax[1], header.boundsMax[2]);
+
+	// The unorm16 positions are in [0, 1] of the bounds, the scale and the offset return them to the model space
+	mesh.positionDecode = glm::mat4(1.0f);
+	if (mesh.vertexLayout != VERTEX_LAYOUT_FULL)
+	{
+		mesh.positionDecode = glm::translate(glm::mat4(1.0f), boundsMin) * glm::scale(glm::mat4(1.0f), boundsMax - boundsMin);
+	}
+	mesh.center = (boundsMin + boundsMax) * 0.5f;
+	mesh.radius = glm::length(boundsMax - boundsMin) * 0.5f;
+
+	vertexTop = vertexStart + cache.vertexDataSize();
+	indexTop = indexStart + static_cast<VkDeviceSize>(cache.indexCount()) * indexSize;
+
+	meshes.emplace_back(std::move(mesh));
+	return static_cast<uint32_t>(meshes.size() - 1);
+}
+
+
+
+void GeometryPool::writeIndices(const MeshCache& cache, void* destination, uint32_t firstIndex, uint32_t count) const
+{
+	count = std::min(count, cache.indexCount() - firstIndex);
+	if (cache.indexSize() == indexSize)
+	{
+		const unsigned char* source = static_cast<const unsigned char*>(cache.indexData());
+		memcpy(destination, source + static_cast<size_t>(firstIndex) * indexSize, static_cast<size_t>(count) * indexSize);
+		return;
+	}
+
+	// The 16-bit indices of the mesh are widened for the 32-bit pool
+	const uint16_t* source = static_cast<const uint16_t*>(cache.indexData()) + firstIndex;
+	uint32_t* output = static_cast<uint32_t*>(destination);
+	for (uint32_t i = 0; i < count; ++i)
+	{
+		output[i] = source[i];
+	}
+}
@@ -0,0 +1,76 @@
+// GeometryPool.h
+
+#ifndef GEOMETRYPOOL_H
+#define GEOMETRYPOOL_H
+
+#include "MeshCache.h"
+#include "VertexLayouts.h"
+
+#include <vulkan/vulkan.h>
+#include <glm.hpp>
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// The mesh placed in the shared vertex and index buffers of the pool
+struct PoolMesh
+{
+	std::string path;
+	VertexLayout vertexLayout;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	// The values of the draw commands: vertexOffset is counted in the vertices of the layout, firstIndex in the indices of the pool
+	int32_t vertexOffset;
+	uint32_t firstIndex;
+	// The ranges of the buffers in bytes for the upload
+	VkDeviceSize vertexByteOffset;
+	VkDeviceSize indexByteOffset;
+	// The levels of detail and the meshlets, their index ranges are relative to firstIndex
+	std::vector<MeshLod> lods;
+	std::vector<Meshlet> meshlets;
+	// Transformation of the quantized positions back to the model space
+	glm::mat4 positionDecode;
+	// The bounding sphere of the mesh in the model space
+	glm::vec3 center;
+	float radius;
+};
+
+// The class that sub-allocates one vertex buffer and one index buffer between all meshes of the scene
+/// The pool keeps only the ranges and the draw data of the meshes, the Vulkan buffers are created by the renderer with the capacity of the pool
+/// The allocation is linear: the meshes are added to the end and never removed
+class GeometryPool
+{
+public:
+	GeometryPool();
+
+	// 1. Function to set the capacity of the buffers and the size of the indices, all previous meshes are forgotten
+	/// The 16-bit pool can hold only the meshes with 16-bit indices, the indices are local to the mesh because of vertexOffset
+	void reset(VkDeviceSize vertexCapacity, VkDeviceSize indexCapacity, uint32_t indexSize);
+	// 2. Function to reserve the ranges of the mesh, returns the identifier of the mesh or throws when the pool is full
+	uint32_t addMesh(const std::string& path, const MeshCache& cache);
+	// 3. Function to write the indices of the mesh to the memory in the index size of the pool
+	/// The part of count indices from firstIndex is written for the chunks of the staging ring, by default all indices are written
+	void writeIndices(const MeshCache& cache, void* destination, uint32_t firstIndex = 0, uint32_t count = UINT32_MAX) const;
+
+	const PoolMesh& getMesh(uint32_t meshId) const { return meshes[meshId]; };
+	uint32_t meshCount() const { return static_cast<uint32_t>(meshes.size()); };
+	uint32_t getIndexSize() const { return indexSize; };
+	VkIndexType indexType() const { return (indexSize == sizeof(uint16_t)) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32; };
+	VkDeviceSize vertexCapacity() const { return vertexBytes; };
+	VkDeviceSize indexCapacity() const { return indexBytes; };
+	VkDeviceSize vertexUsed() const { return vertexTop; };
+	VkDeviceSize indexUsed() const { return indexTop; };
+
+private:
+	std::vector<PoolMesh> meshes;
+
+	VkDeviceSize vertexBytes;
+	VkDeviceSize indexBytes;
+	uint32_t indexSize;
+	// The ends of the allocated parts of the buffers in bytes
+	VkDeviceSize vertexTop;
+	VkDeviceSize indexTop;
+};
+
+#endif // GEOMETRYPOOL_H
@@ -0,0 +1,337 @@
+// GpuAllocator.cpp
+#include "GpuAllocator.h"
+
+#include <stdexcept>
+
+GpuAllocator::GpuAllocator()
+{
+	device = VK_NULL_HANDLE;
+	properties = {};
+	bufferImageGranularity = 1;
+	nonCoherentAtomSize = 1;
+	mappableDeviceLocal = false;
+	physicalDevice = VK_NULL_HANDLE;
+	budgetExtension = false;
+	dedicatedCount = 0;
+	dedicatedBytes = 0;
+	categoryBytes.fill(0);
+	heapBytes.fill(0);
+	warningThreshold = 1.0f;
+	heapWarned.fill(false);
+}
+
+
+
+void GpuAllocator::init(VkPhysicalDevice physicalDevice, VkDevice device, bool memoryBudget)
+{
+	this->physicalDevice = physicalDevice;
+	this->device = device;
+	budgetExtension = memoryBudget;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &properties);
+
+	VkPhysicalDeviceProperties deviceProperties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &deviceProperties);
+	bufferImageGranularity = deviceProperties.limits.bufferImageGranularity;
+	nonCoherentAtomSize = deviceProperties.limits.nonCoherentAtomSize;
+
+	// The blocks of the small heaps are smaller, so one block doesn't take most of the heap
+	pools.assign(properties.memoryTypeCount * 2, Pool{});
+	for (uint32_t i = 0; i < properties.memoryTypeCount; ++i)
+	{
+		VkDeviceSize heapSize = properties.memoryHeaps[properties.memoryTypes[i].heapIndex].size;
+		VkDeviceSize blockSize = heapSize <= 1024ull * 1024 * 1024 ? heapSize / 8 : 64ull * 1024 * 1024;
+		pools[i * 2].blockSize = blockSize;
+		pools[i * 2 + 1].blockSize = blockSize;
+	}
+
+	// Without resizable BAR the mapped video memory is a small window (usually 256MB) of the largest device local heap
+	VkDeviceSize videoMemorySize = 0;
+	for (uint32_t i = 0; i < properties.memoryHeapCount; ++i)
+	{
+		if ((properties.memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) && properties.memoryHeaps[i].size > videoMemorySize)
+		{
+			videoMemorySize = properties.memoryHeaps[i].size;
+		}
+	}
+	VkMemoryPropertyFlags mappable = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	mappableDeviceLocal = false;
+	for (uint32_t i = 0; i < properties.memoryTypeCount; ++i)
+	{
+		if ((properties.memoryTypes[i].propertyFlags & mappable) == mappable &&
+			properties.memoryHeaps[properties.memoryTypes[i].heapIndex].size >= videoMemorySize)
+		{
+			mappableDeviceLocal = true;
+		}
+	}
+}
+
+
+
+GpuAllocation GpuAllocator::allocate(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex, bool linear, const VkMemoryDedicatedAllocateInfo* dedicated,
+										MemoryCategory category)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	GpuAllocation allocation{};
+	allocation.size = requirements.size;
+	allocation.category = category;
+	categoryBytes[category] += requirements.size;
+	allocation.block = NO_BLOCK;
+	allocation.pool = memoryTypeIndex * 2 + (!linear && bufferImageGranularity > 1 ? 1 : 0);
+	Pool& pool = pools[allocation.pool];
+
+	if (dedicated != nullptr || requirements.size > pool.blockSize / 2)
+	{
+		if (!allocateMemory(requirements.size, memoryTypeIndex, dedicated, allocation.memory, allocation.mapped))
+		{
+			categoryBytes[category] -= requirements.size;
+			throw std::runtime_error("ERROR::GpuAllocator::allocate()::Failed to allocate the dedicated memory");
+		}
+		++dedicatedCount;
+		dedicatedBytes += requirements.size;
+		return allocation;
+	}
+
+	// The ranges of the non coherent memory are flushed by whole atoms, so they don't share an atom
+	VkDeviceSize alignment = requirements.alignment;
+	VkMemoryPropertyFlags flags = properties.memoryTypes[memoryTypeIndex].propertyFlags;
+	if ((flags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT) && !(flags & VK_MEMORY_PROPERTY_HOST_COHERENT_BIT))
+	{
+		alignment = alignment > nonCoherentAtomSize ? alignment : nonCoherentAtomSize;
+	}
+
+	TlsfRange range{};
+	uint32_t blockIndex = NO_BLOCK;
+	for (uint32_t i = 0; i < static_cast<uint32_t>(pool.blocks.size()); ++i)
+	{
+		if (pool.blocks[i].memory != VK_NULL_HANDLE && pool.blocks[i].allocator.allocate(requirements.size, alignment, range))
+		{
+			blockIndex = i;
+			break;
+		}
+	}
+
+	if (blockIndex == NO_BLOCK)
+	{
+		// The new block takes the place of a freed one, the smaller blocks are tried when the heap is nearly full
+		Block block{};
+		VkDeviceSize blockSize = pool.blockSize;
+		while (!allocateMemory(blockSize, memoryTypeIndex, nullptr, block.memory, block.mapped))
+		{
+			blockSize /= 2;
+			if (blockSize < requirements.size)
+			{
+				categoryBytes[category] -= requirements.size;
+				throw std::runtime_error("ERROR::GpuAllocator::allocate()::Failed to allocate the memory block");
+			}
+		}
+		block.allocator.reset(blockSize);
+		block.allocator.allocate(requirements.size, alignment, range);
+
+		for (uint32_t i = 0; i < static_cast<uint32_t>(pool.blocks.size()) && blockIndex == NO_BLOCK; ++i)
+		{
+			if (pool.blocks[i].memory == VK_NULL_HANDLE)
+			{
+				blockIndex = i;
+			}
+		}
+		if (blockIndex == NO_BLOCK)
+		{
+			blockIndex = static_cast<uint32_t>(pool.blocks.size());
+			pool.blocks.emplace_back();
+		}
+		pool.blocks[blockIndex] = std::move(block);
+	}
+
+	const Block& block = pool.blocks[blockIndex];
+	allocation.memory = block.memory;
+	allocation.offset = range.offset;
+	allocation.mapped = block.mapped ? static_cast<char*>(block.mapped) + range.offset : nullptr;
+	allocation.block = blockIndex;
+	allocation.node = range.node;
+	return allocation;
+}
+
+
+
+void GpuAllocator::free(GpuAllocation& allocation)
+{
+	if (allocation.memory == VK_NULL_HANDLE)
+	{
+		return;
+	}
+
+	std::lock_guard<std::mutex> lock(mutex);
+	categoryBytes[allocation.category] -= allocation.size;
+	if (allocation.block == NO_BLOCK)
+	{
+		heapBytes[properties.memoryTypes[allocation.pool / 2].heapIndex] -= allocation.size;
+		vkFreeMemory(device, allocation.memory, nullptr);
+		--dedicatedCount;
+		dedicatedBytes -= allocation.size;
+		allocation = GpuAllocation{};
+		return;
+	}
+
+	Pool& pool = pools[allocation.pool];
+	Block& block = pool.blocks[allocation.block];
+	block.allocator.free(allocation.node);
+
+	// One empty block is kept for the next allocations, the other empty blocks are freed
+	if (block.allocator.empty())
+	{
+		for (uint32_t i = 0; i < static_cast<uint32_t>(pool.blocks.size()); ++i)
+		{
+			if (i != allocation.block && pool.blocks[i].memory != VK_NULL_HANDLE && pool.blocks[i].allocator.empty())
+			{
+				heapBytes[properties.memoryTypes[allocation.pool / 2].heapIndex] -= block.allocator.capacity();
+				vkFreeMemory(device, block.memory, nullptr);
+				block.memory = VK_NULL_HANDLE;
+				block.mapped = nullptr;
+				block.allocator.reset(0);
+				break;
+			}
+		}
+	}
+	allocation = GpuAllocation{};
+}
+
+
+
+GpuAllocatorStats GpuAllocator::stats()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+
+	GpuAllocatorStats result{};
+	result.dedicatedCount = dedicatedCount;
+	result.dedicatedBytes = dedicatedBytes;
+	result.allocationCount = dedicatedCount;
+	VkDeviceSize freeBytes = 0;
+	for (const Pool& pool : pools)
+	{
+		for (const Block& block : pool.blocks)
+		{
+			if (block.memory == VK_NULL_HANDLE)
+			{
+				continue;
+			}
+			++result.blockCount;
+			result.allocationCount += block.allocator.allocationCount();
+			result.blockBytes += block.allocator.capacity();
+			result.usedBytes += block.allocator.usedBytes();
+			freeBytes += block.allocator.freeBytes();
+
+			VkDeviceSize largest = block.allocator.largestFreeRange();
+			result.largestFreeRange = largest > result.largestFreeRange ? largest : result.largestFreeRange;
+		}
+	}
+
+	// The free bytes that can't be taken by one allocation of the largest free range
+	if (freeBytes > 0)
+	{
+		result.fragmentation = 1.0f - static_cast<float>(result.largestFreeRange) / static_cast<float>(freeBytes);
+	}
+	return result;
+}
+
+
+
+void GpuAllocator::destroy()
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (Pool& pool : pools)
+	{
+		for (Block& block : pool.blocks)
+		{
+			if (block.memory != VK_NULL_HANDLE)
+			{
+				vkFreeMemory(device, block.memory, nullptr);
+			}
+		}
+		pool.blocks.clear();
+	}
+	heapBytes.fill(0);
+}
+
+
+
+GpuMemorySnapshot GpuAllocator::snapshot()
+{
+	GpuMemorySnapshot result{};
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		result.categoryBytes = categoryBytes;
+		result.heapAllocated = heapBytes;
+	}
+	result.heapCount = properties.memoryHeapCount;
+	result.budgetExtension = budgetExtension;
+
+	if (budgetExtension)
+	{
+		// The budget and the usage of the whole process are given by the driver, they change with the other applications
+		VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties{};
+		budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+		VkPhysicalDeviceMemoryProperties2 memoryProperties2{};
+		memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+		memoryProperties2.pNext = &budgetProperties;
+		vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &memoryProperties2);
+		for (uint32_t i = 0; i < result.heapCount; ++i)
+		{
+			result.heapUsage[i] = budgetProperties.heapUsage[i];
+			result.heapBudget[i] = budgetProperties.heapBudget[i];
+		}
+	}
+	else
+	{
+		for (uint32_t i = 0; i < result.heapCount; ++i)
+		{
+			result.heapUsage[i] = result.heapAllocated[i];
+			result.heapBudget[i] = properties.memoryHeaps[i].size / 10 * 8;
+		}
+	}
+
+	// The warning is called on the render thread that takes the snapshot, outside of the lock, so it can free the memory
+	for (uint32_t i = 0; i < result.heapCount; ++i)
+	{
+		bool above = result.heapUsage[i] > static_cast<VkDeviceSize>(static_cast<double>(result.heapBudget[i]) * warningThreshold);
+		if (above && !heapWarned[i] && budgetWarning)
+		{
+			budgetWarning(i, result);
+		}
+		heapWarned[i] = above;
+	}
+	return result;
+}
+
+
+
+void GpuAllocator::setBudgetWarning(float threshold, std::function<void(uint32_t, const GpuMemorySnapshot&)> warning)
+{
+	warningThreshold = threshold;
+	budgetWarning = std::move(warning);
+	heapWarned.fill(false);
+}
+
+
+
+bool GpuAllocator::allocateMemory(VkDeviceSize size, uint32_t memoryTypeIndex, const void* next, VkDeviceMemory& memory, void*& mapped)
+{
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.pNext = next;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = memoryTypeIndex;
+
+	if (vkAllocateMemory(device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+	{
+		return false;
+	}
+	heapBytes[properties.memoryTypes[memoryTypeIndex].heapIndex] += size;
+
+	mapped = nullptr;
+	if (properties.memoryTypes[memoryTypeIndex].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, &mapped);
+	}
+	return true;
+}
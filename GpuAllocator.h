@@ -0,0 +1,149 @@
+// GpuAllocator.h
+
+#ifndef GPUALLOCATOR_H
+#define GPUALLOCATOR_H
+
+#include "TlsfAllocator.h"
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <array>
+#include <mutex>
+#include <functional>
+#include <cstdint>
+
+// The purpose of the allocation, the bytes of each category are counted separately
+enum MemoryCategory : uint32_t
+{
+	MEMORY_CATEGORY_GEOMETRY = 0,
+	MEMORY_CATEGORY_TEXTURE = 1,
+	MEMORY_CATEGORY_UNIFORM = 2,
+	MEMORY_CATEGORY_ATTACHMENT = 3,
+	MEMORY_CATEGORY_STAGING = 4,
+	MEMORY_CATEGORY_COUNT = 5
+};
+
+// The memory of one buffer or image, the resource is bound to memory at offset
+struct GpuAllocation
+{
+	VkDeviceMemory memory;
+	VkDeviceSize offset;
+	VkDeviceSize size;
+	// The pointer to the offset of the persistently mapped block, nullptr for the memory that isn't host visible
+	void* mapped;
+	uint32_t pool;
+	// The block of the pool and the node of its allocator, block is NO_BLOCK for the dedicated allocation
+	uint32_t block;
+	uint32_t node;
+	MemoryCategory category;
+};
+
+// The usage of the video memory by the allocator
+struct GpuAllocatorStats
+{
+	uint32_t blockCount;
+	uint32_t dedicatedCount;
+	uint32_t allocationCount;
+	// The bytes of all blocks and the bytes that are taken from them
+	VkDeviceSize blockBytes;
+	VkDeviceSize usedBytes;
+	VkDeviceSize dedicatedBytes;
+	VkDeviceSize largestFreeRange;
+	// 0 when the free space of the blocks is one range, near 1 when it's split to many small ranges
+	float fragmentation;
+};
+
+// The memory of the heaps and the categories at one moment, it's taken once per frame
+struct GpuMemorySnapshot
+{
+	// The bytes of the resources of each category
+	std::array<VkDeviceSize, MEMORY_CATEGORY_COUNT> categoryBytes;
+	uint32_t heapCount;
+	// The bytes of VkDeviceMemory that the allocator took from each heap (the blocks and the dedicated allocations)
+	std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> heapAllocated;
+	// The usage of the heap by the whole process and the bytes it can use without paging
+	/// Without VK_EXT_memory_budget the usage is heapAllocated and the budget is 80% of the heap
+	std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> heapUsage;
+	std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> heapBudget;
+	bool budgetExtension;
+};
+
+// The class that places the buffers and the images in large VkDeviceMemory blocks
+/// Each memory type has the pools of the blocks, the resources are sub-allocated from them by TlsfAllocator
+/// When bufferImageGranularity is larger than 1, the linear resources (buffers) and the optimal images have separate pools, so it's never crossed
+/// The resources that the driver prefers in their own memory and the ones larger than half of the block get the dedicated allocation
+/// The host visible blocks are mapped once when they are created, allocate() and free() are called from any thread
+/// Each allocation has the category, the bytes of the categories and the heaps are compared with the budget of the heaps by snapshot()
+class GpuAllocator
+{
+public:
+	static const uint32_t NO_BLOCK = UINT32_MAX;
+
+	GpuAllocator();
+
+	GpuAllocator(const GpuAllocator&) = delete;
+	GpuAllocator& operator=(const GpuAllocator&) = delete;
+
+	// 1. Function to read the memory types and the limits of the device, memoryBudget is true when VK_EXT_memory_budget is enabled
+	void init(VkPhysicalDevice physicalDevice, VkDevice device, bool memoryBudget);
+	// 2. Function to allocate the memory of the requirements from the memory type
+	/// linear is true for the buffers and the images with VK_IMAGE_TILING_LINEAR, dedicated is the resource when the driver prefers its own memory
+	GpuAllocation allocate(const VkMemoryRequirements& requirements, uint32_t memoryTypeIndex, bool linear, const VkMemoryDedicatedAllocateInfo* dedicated,
+							MemoryCategory category);
+	// 3. Function to give the memory back, the allocation is cleared
+	void free(GpuAllocation& allocation);
+	// 4. Function to get the usage and the fragmentation of the memory
+	GpuAllocatorStats stats();
+	// 5. Function to free all blocks, all resources must be destroyed before
+	void destroy();
+	// 6. Function to read the budget of the heaps and to count the usage, the warning is called for each heap that goes above the threshold
+	GpuMemorySnapshot snapshot();
+	// 7. Function to set the warning that is called once when the usage of the heap goes above the part of its budget
+	/// It's called again after the usage falls below the threshold and rises above it
+	void setBudgetWarning(float threshold, std::function<void(uint32_t, const GpuMemorySnapshot&)> warning);
+
+	const VkPhysicalDeviceMemoryProperties& memoryProperties() const { return properties; };
+	// True when the device local memory that the CPU maps is as large as the whole video memory (integrated GPUs and resizable BAR)
+	bool mappableVideoMemory() const { return mappableDeviceLocal; };
+
+private:
+	struct Block
+	{
+		VkDeviceMemory memory;
+		void* mapped;
+		TlsfAllocator allocator;
+	};
+
+	struct Pool
+	{
+		std::vector<Block> blocks;
+		VkDeviceSize blockSize;
+	};
+
+	// Function to allocate the VkDeviceMemory and map it if it's host visible, returns false when the device is out of memory
+	bool allocateMemory(VkDeviceSize size, uint32_t memoryTypeIndex, const void* next, VkDeviceMemory& memory, void*& mapped);
+
+	VkDevice device;
+	VkPhysicalDeviceMemoryProperties properties;
+	VkDeviceSize bufferImageGranularity;
+	VkDeviceSize nonCoherentAtomSize;
+	bool mappableDeviceLocal;
+	VkPhysicalDevice physicalDevice;
+	bool budgetExtension;
+
+	std::mutex mutex;
+	// Two pools for each memory type, the pool of the linear resources is first
+	std::vector<Pool> pools;
+	uint32_t dedicatedCount;
+	VkDeviceSize dedicatedBytes;
+	std::array<VkDeviceSize, MEMORY_CATEGORY_COUNT> categoryBytes;
+	std::array<VkDeviceSize, VK_MAX_MEMORY_HEAPS> heapBytes;
+
+	float warningThreshold;
+	std::function<void(uint32_t, const GpuMemorySnapshot&)> budgetWarning;
+	// The heaps that are above the threshold, the warning isn't repeated for them
+	std::array<bool, VK_MAX_MEMORY_HEAPS> heapWarned;
+};
+
+#endif // GPUALLOCATOR_H
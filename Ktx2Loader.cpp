@@ -0,0 +1,310 @@
+// Ktx2Loader.cpp
+#include "Ktx2Loader.h"
+
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <filesystem>
+#include <cstring>
+
+namespace
+{
+	// «KTX 20»\r\n\x1A\n
+	const uint8_t KTX2_IDENTIFIER[12] = { 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+
+	// The values of the data format descriptor (Khronos Data Format Specification 1.3)
+	const uint32_t KHR_DF_MODEL_RGBSDA = 1;
+	const uint32_t KHR_DF_MODEL_BC1A = 128;
+	const uint32_t KHR_DF_MODEL_BC5 = 132;
+	const uint32_t KHR_DF_MODEL_BC7 = 134;
+	const uint32_t KHR_DF_PRIMARIES_BT709 = 1;
+	const uint32_t KHR_DF_TRANSFER_LINEAR = 1;
+	const uint32_t KHR_DF_TRANSFER_SRGB = 2;
+	const uint32_t KHR_DF_CHANNEL_BC1A_ALPHAPRESENT = 1;
+	const uint32_t KHR_DF_CHANNEL_ALPHA = 15;
+	const uint32_t KHR_DF_SAMPLE_DATATYPE_LINEAR = 0x10;
+	const uint32_t KHR_DF_SAMPLE_DATATYPE_SIGNED = 0x40;
+
+	// The size of one level in bytes, the partial blocks on the edges are stored as the whole blocks
+	uint64_t levelSize(uint32_t width, uint32_t height, uint32_t blockBytes, uint32_t blockExtent)
+	{
+		return static_cast<uint64_t>((width + blockExtent - 1) / blockExtent) * ((height + blockExtent - 1) / blockExtent) * blockBytes;
+	}
+
+	// The sample of the descriptor: the bits of the channel in the texel block and the range of its values
+	void appendSample(std::vector<uint32_t>& descriptor, uint32_t bitOffset, uint32_t bitLength, uint32_t channel, uint32_t upper, uint32_t lower = 0)
+	{
+		descriptor.push_back(bitOffset | ((bitLength - 1) << 16) | (channel << 24));
+		descriptor.push_back(0);
+		descriptor.push_back(lower);
+		descriptor.push_back(upper);
+	}
+}
+
+bool Ktx2Loader::isKtx2(const std::string& path)
+{
+	const std::string extension = ".ktx2";
+	return path.size() >= extension.size() && path.compare(path.size() - extension.size(), extension.size(), extension) == 0;
+}
+
+
+
+VkFormat Ktx2Loader::readFormat(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	Ktx2Header header{};
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || !validate(header))
+	{
+		return VK_FORMAT_UNDEFINED;
+	}
+	return static_cast<VkFormat>(header.vkFormat);
+}
+
+
+
+void Ktx2Loader::load(const std::string& path, TextureData& texture)
+{
+	std::ifstream file(path, std::ios::binary | std::ios::ate);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("ERROR::Ktx2Loader::load()::Failed to open the file: " + path);
+	}
+	uint64_t fileSize = static_cast<uint64_t>(file.tellg());
+	file.seekg(0);
+
+	Ktx2Header header{};
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || !validate(header))
+	{
+		throw std::runtime_error("ERROR::Ktx2Loader::load()::The file isn't the supported KTX2 texture: " + path);
+	}
+
+	// The level count 0 means that the file stores only the level 0 and the levels are generated after the loading
+	uint32_t levelCount = std::max(header.levelCount, 1u);
+	std::vector<Ktx2LevelIndex> index(levelCount);
+	if (!file.read(reinterpret_cast<char*>(index.data()), sizeof(Ktx2LevelIndex) * levelCount))
+	{
+		throw std::runtime_error("ERROR::Ktx2Loader::load()::The level index is truncated: " + path);
+	}
+
+	VkFormat format = static_cast<VkFormat>(header.vkFormat);
+	uint32_t blockBytes, blockExtent;
+	formatBlock(format, blockBytes, blockExtent);
+
+	// The levels are placed from the largest one, the file keeps them from the smallest one
+	texture.levels.clear();
+	uint64_t totalSize = 0;
+	for (uint32_t i = 0; i < levelCount; ++i)
+	{
+		uint32_t width = std::max(header.pixelWidth >> i, 1u);
+		uint32_t height = std::max(header.pixelHeight >> i, 1u);
+		uint64_t size = levelSize(width, height, blockBytes, blockExtent);
+		// The offset is compared first, so the broken offset near the 64-bit limit doesn't wrap the sum around
+		if (index[i].byteLength != size || index[i].byteOffset > fileSize || size > fileSize - index[i].byteOffset)
+		{
+			throw std::runtime_error("ERROR::Ktx2Loader::load()::The level " + std::to_string(i) + " has the wrong size: " + path);
+		}
+
+		texture.levels.push_back(MipLevel{ totalSize, width, height });
+		totalSize += size;
+	}
+
+	texture.pixels.resize(static_cast<size_t>(totalSize));
+	for (uint32_t i = 0; i < levelCount; ++i)
+	{
+		file.seekg(static_cast<std::streamoff>(index[i].byteOffset));
+		if (!file.read(reinterpret_cast<char*>(texture.pixels.data() + texture.levels[i].offset), static_cast<std::streamsize>(index[i].byteLength)))
+		{
+			throw std::runtime_error("ERROR::Ktx2Loader::load()::Failed to read the level " + std::to_string(i) + ": " + path);
+		}
+	}
+
+	texture.width = header.pixelWidth;
+	texture.height = header.pixelHeight;
+	texture.format = format;
+
+	// The RGBA8 level is given without the levels like the decoded image, so its mip chain is built by the renderer or by MipGenerator
+	/// The block-compressed level can't be filtered, it's uploaded alone
+	if (header.levelCount == 0 && !isBlockCompressed(format))
+	{
+		texture.levels.clear();
+	}
+}
+
+
+
+void Ktx2Loader::save(const std::string& path, const TextureData& texture)
+{
+	std::vector<uint32_t> descriptor = dataFormatDescriptor(texture.format);
+	uint32_t blockBytes, blockExtent;
+	if (descriptor.empty() || !formatBlock(texture.format, blockBytes, blockExtent) || texture.levels.empty())
+	{
+		throw std::runtime_error("ERROR::Ktx2Loader::save()::The texture can't be written to KTX2: " + path);
+	}
+
+	uint32_t levelCount = static_cast<uint32_t>(texture.levels.size());
+	Ktx2Header header{};
+	memcpy(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER));
+	header.vkFormat = texture.format;
+	header.typeSize = 1;
+	header.pixelWidth = texture.width;
+	header.pixelHeight = texture.height;
+	header.faceCount = 1;
+	header.levelCount = levelCount;
+	header.dfdByteOffset = static_cast<uint32_t>(sizeof(Ktx2Header) + sizeof(Ktx2LevelIndex) * levelCount);
+	header.dfdByteLength = static_cast<uint32_t>(descriptor.size() * sizeof(uint32_t));
+
+	// The levels follow the descriptor from the smallest one, each of them is aligned to the block and to 4 bytes
+	uint64_t alignment = (blockBytes % 4 == 0) ? blockBytes : blockBytes * 4;
+	uint64_t offset = header.dfdByteOffset + header.dfdByteLength;
+	std::vector<Ktx2LevelIndex> index(levelCount);
+	for (uint32_t i = levelCount; i-- > 0;)
+	{
+		const MipLevel& level = texture.levels[i];
+		uint64_t size = levelSize(level.width, level.height, blockBytes, blockExtent);
+		offset = (offset + alignment - 1) / alignment * alignment;
+		index[i] = Ktx2LevelIndex{ offset, size, size };
+		offset += size;
+	}
+
+	// The file is written to the temporary path first, so the renderer never reads a half written texture
+	std::string tempPath = path + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			throw std::runtime_error("ERROR::Ktx2Loader::save()::Failed to create the file: " + tempPath);
+		}
+
+		file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+		file.write(reinterpret_cast<const char*>(index.data()), sizeof(Ktx2LevelIndex) * levelCount);
+		file.write(reinterpret_cast<const char*>(descriptor.data()), header.dfdByteLength);
+		for (uint32_t i = levelCount; i-- > 0;)
+		{
+			// The padding before the level
+			std::vector<char> padding(static_cast<size_t>(index[i].byteOffset - static_cast<uint64_t>(file.tellp())), 0);
+			file.write(padding.data(), static_cast<std::streamsize>(padding.size()));
+			file.write(reinterpret_cast<const char*>(texture.pixels.data() + texture.levels[i].offset), static_cast<std::streamsize>(index[i].byteLength));
+		}
+		if (!file)
+		{
+			throw std::runtime_error("ERROR::Ktx2Loader::save()::Failed to write the file: " + tempPath);
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, path, error);
+	if (error)
+	{
+		std::filesystem::remove(tempPath, error);
+		throw std::runtime_error("ERROR::Ktx2Loader::save()::Failed to replace the file: " + path);
+	}
+}
+
+
+
+bool Ktx2Loader::formatBlock(VkFormat format, uint32_t& blockBytes, uint32_t& blockExtent)
+{
+	blockExtent = 4;
+	switch (format)
+	{
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+		blockBytes = 8;
+		return true;
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+	case VK_FORMAT_BC5_SNORM_BLOCK:
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+		blockBytes = 16;
+		return true;
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+		blockBytes = 4;
+		blockExtent = 1;
+		return true;
+	default:
+		blockBytes = 0;
+		return false;
+	}
+}
+
+
+
+bool Ktx2Loader::validate(const Ktx2Header& header)
+{
+	uint32_t blockBytes, blockExtent;
+	return memcmp(header.identifier, KTX2_IDENTIFIER, sizeof(KTX2_IDENTIFIER)) == 0 &&
+		formatBlock(static_cast<VkFormat>(header.vkFormat), blockBytes, blockExtent) &&
+		header.supercompressionScheme == 0 &&
+		header.pixelWidth > 0 && header.pixelHeight > 0 && header.pixelDepth == 0 &&
+		header.layerCount == 0 && header.faceCount == 1 &&
+		header.levelCount <= MipGenerator::levelCount(header.pixelWidth, header.pixelHeight);
+}
+
+
+
+std::vector<uint32_t> Ktx2Loader::dataFormatDescriptor(VkFormat format)
+{
+	// The basic descriptor block: the header of 24 bytes and 16 bytes for each sample
+	bool srgb = (format == VK_FORMAT_R8G8B8A8_SRGB || format == VK_FORMAT_BC1_RGB_SRGB_BLOCK || format == VK_FORMAT_BC1_RGBA_SRGB_BLOCK ||
+					format == VK_FORMAT_BC7_SRGB_BLOCK);
+	uint32_t colorSpace = (KHR_DF_PRIMARIES_BT709 << 8) | ((srgb ? KHR_DF_TRANSFER_SRGB : KHR_DF_TRANSFER_LINEAR) << 16);
+	std::vector<uint32_t> descriptor;
+	switch (format)
+	{
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+		descriptor = { 0, 0, 0, 0, 0, 4, 0 };
+		descriptor[3] = KHR_DF_MODEL_RGBSDA | colorSpace;
+		appendSample(descriptor, 0, 8, 0, 255);
+		appendSample(descriptor, 8, 8, 1, 255);
+		appendSample(descriptor, 16, 8, 2, 255);
+		// The alpha isn't encoded by the sRGB curve
+		appendSample(descriptor, 24, 8, KHR_DF_CHANNEL_ALPHA | (srgb ? KHR_DF_SAMPLE_DATATYPE_LINEAR : 0), 255);
+		break;
+	case VK_FORMAT_BC1_RGB_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGB_SRGB_BLOCK:
+	case VK_FORMAT_BC1_RGBA_UNORM_BLOCK:
+	case VK_FORMAT_BC1_RGBA_SRGB_BLOCK:
+	{
+		descriptor = { 0, 0, 0, 0, 0, 8, 0 };
+		descriptor[3] = KHR_DF_MODEL_BC1A | colorSpace;
+		// The block is 4x4 texels, the dimensions are stored minus one
+		descriptor[4] = 3 | (3 << 8);
+		// The blocks with the punch-through alpha are marked by the channel of the sample
+		bool alpha = (format == VK_FORMAT_BC1_RGBA_UNORM_BLOCK || format == VK_FORMAT_BC1_RGBA_SRGB_BLOCK);
+		appendSample(descriptor, 0, 64, alpha ? KHR_DF_CHANNEL_BC1A_ALPHAPRESENT : 0, 0xFFFFFFFF);
+		break;
+	}
+	case VK_FORMAT_BC5_UNORM_BLOCK:
+	case VK_FORMAT_BC5_SNORM_BLOCK:
+	{
+		descriptor = { 0, 0, 0, 0, 0, 16, 0 };
+		descriptor[3] = KHR_DF_MODEL_BC5 | colorSpace;
+		descriptor[4] = 3 | (3 << 8);
+		// The red and the green channels take 64 bits each, the signed ones range over the whole signed 32-bit values
+		bool snorm = (format == VK_FORMAT_BC5_SNORM_BLOCK);
+		uint32_t signedType = snorm ? KHR_DF_SAMPLE_DATATYPE_SIGNED : 0;
+		appendSample(descriptor, 0, 64, 0 | signedType, snorm ? 0x7FFFFFFF : 0xFFFFFFFF, snorm ? 0x80000000 : 0);
+		appendSample(descriptor, 64, 64, 1 | signedType, snorm ? 0x7FFFFFFF : 0xFFFFFFFF, snorm ? 0x80000000 : 0);
+		break;
+	}
+	case VK_FORMAT_BC7_UNORM_BLOCK:
+	case VK_FORMAT_BC7_SRGB_BLOCK:
+		descriptor = { 0, 0, 0, 0, 0, 16, 0 };
+		descriptor[3] = KHR_DF_MODEL_BC7 | colorSpace;
+		descriptor[4] = 3 | (3 << 8);
+		appendSample(descriptor, 0, 128, 0, 0xFFFFFFFF);
+		break;
+	default:
+		return descriptor;
+	}
+
+	// The total size of the descriptor, the version 2 and the size of the block
+	uint32_t blockSize = static_cast<uint32_t>((descriptor.size() - 1) * sizeof(uint32_t));
+	descriptor[0] = static_cast<uint32_t>(descriptor.size() * sizeof(uint32_t));
+	descriptor[2] = 2 | (blockSize << 16);
+	return descriptor;
+}
@@ -0,0 +1,70 @@
+// Ktx2Loader.h
+
+#ifndef KTX2LOADER_H
+#define KTX2LOADER_H
+
+#include "TextureData.h"
+
+#include <vulkan/vulkan.h>
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// The header of the KTX 2.0 container, the level index follows it
+struct Ktx2Header
+{
+	uint8_t identifier[12];
+	uint32_t vkFormat;
+	uint32_t typeSize;
+	uint32_t pixelWidth;
+	uint32_t pixelHeight;
+	uint32_t pixelDepth;
+	uint32_t layerCount;
+	uint32_t faceCount;
+	uint32_t levelCount;
+	uint32_t supercompressionScheme;
+	// The data format descriptor, the key/value data and the supercompression data aren't used by the loader
+	uint32_t dfdByteOffset;
+	uint32_t dfdByteLength;
+	uint32_t kvdByteOffset;
+	uint32_t kvdByteLength;
+	uint64_t sgdByteOffset;
+	uint64_t sgdByteLength;
+};
+
+// The position of one level in the file
+struct Ktx2LevelIndex
+{
+	uint64_t byteOffset;
+	uint64_t byteLength;
+	uint64_t uncompressedByteLength;
+};
+
+// The loader of the 2D textures in the KTX 2.0 container that are stored in the BC1, BC5, BC7 or RGBA8 formats
+/// The levels are uploaded as they are stored, so the file has to keep the whole mip chain
+/// AssetCooker writes the cooked textures in the RGBA8 or BC1 format by save()
+/// The supercompressed files (Basis Universal, Zstandard), the arrays, the cube maps and the 3D textures aren't supported
+class Ktx2Loader
+{
+public:
+	// 1. Function to check the extension of the file
+	static bool isKtx2(const std::string& path);
+	// 2. Function to read the format from the header, returns VK_FORMAT_UNDEFINED when the file is missing or can't be loaded
+	static VkFormat readFormat(const std::string& path);
+	// 3. Function to read all levels of the texture, throws when the file isn't the supported KTX2
+	static void load(const std::string& path, TextureData& texture);
+	// 4. Function to write the texture with all its levels in any format that formatBlock() accepts
+	static void save(const std::string& path, const TextureData& texture);
+	// 5. Function to get the size of the block of texels in bytes and its side, returns false for the formats that the loader doesn't support
+	static bool formatBlock(VkFormat format, uint32_t& blockBytes, uint32_t& blockExtent);
+	static bool isBlockCompressed(VkFormat format) { uint32_t bytes, extent; return formatBlock(format, bytes, extent) && extent > 1; };
+
+private:
+	// Function to check the identifier and the layout of the texture
+	static bool validate(const Ktx2Header& header);
+	// Function to build the data format descriptor of the format, the readers of KTX2 need it to interpret the texels
+	static std::vector<uint32_t> dataFormatDescriptor(VkFormat format);
+};
+
+#endif // KTX2LOADER_H
@@ -0,0 +1,360 @@
+// MeshCache.cpp
+#include "MeshCache.h"
+
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+#include <cstddef>
+#include <algorithm>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	const char MESH_CACHE_MAGIC[4] = { 'V', 'K', 'M', 'C' };
+
+	// The arrays are aligned to 16 bytes inside the file
+	uint64_t alignOffset(uint64_t offset)
+	{
+		return (offset + 15) & ~static_cast<uint64_t>(15);
+	}
+}
+
+
+
+MeshCache::MeshCache()
+{
+	fileData = nullptr;
+	header = nullptr;
+	mappedData = nullptr;
+	mappedSize = 0;
+#ifdef _WIN32
+	fileHandle = INVALID_HANDLE_VALUE;
+	mappingHandle = nullptr;
+#else
+	fileDescriptor = -1;
+#endif
+}
+
+
+
+bool MeshCache::open(const std::string& cachePath, const std::string& sourcePath, uint32_t flags)
+{
+	close();
+
+#ifdef _WIN32
+	fileHandle = CreateFileA(cachePath.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+	if (fileHandle == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(fileHandle, &fileSize) || fileSize.QuadPart < static_cast<LONGLONG>(sizeof(MeshCacheHeader)))
+	{
+		close();
+		return false;
+	}
+	mappedSize = static_cast<uint64_t>(fileSize.QuadPart);
+
+	mappingHandle = CreateFileMappingA(fileHandle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (mappingHandle == nullptr)
+	{
+		close();
+		return false;
+	}
+
+	mappedData = MapViewOfFile(mappingHandle, FILE_MAP_READ, 0, 0, 0);
+	if (mappedData == nullptr)
+	{
+		close();
+		return false;
+	}
+#else
+	fileDescriptor = ::open(cachePath.c_str(), O_RDONLY);
+	if (fileDescriptor < 0)
+	{
+		return false;
+	}
+
+	struct stat fileStat;
+	if (fstat(fileDescriptor, &fileStat) != 0 || fileStat.st_size < static_cast<off_t>(sizeof(MeshCacheHeader)))
+	{
+		close();
+		return false;
+	}
+	mappedSize = static_cast<uint64_t>(fileStat.st_size);
+
+	void* data = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fileDescriptor, 0);
+	if (data == MAP_FAILED)
+	{
+		close();
+		return false;
+	}
+	mappedData = data;
+	// The whole file is copied to the staging buffer right after loading, so ask for the read-ahead
+	madvise(mappedData, mappedSize, MADV_WILLNEED);
+#endif
+
+	fileData = static_cast<const char*>(mappedData);
+	header = reinterpret_cast<const MeshCacheHeader*>(fileData);
+
+	if (!validate(mappedSize, sourcePath, flags))
+	{
+		close();
+		return false;
+	}
+	return true;
+}
+
+
+
+void MeshCache::create(const std::string& cachePath, const std::string& sourcePath, const MeshCacheData& data)
+{
+	close();
+
+	MeshCacheHeader temp{};
+	memcpy(temp.magic, MESH_CACHE_MAGIC, sizeof(temp.magic));
+	temp.version = VERSION;
+	temp.vertexStride = data.vertexStride;
+	temp.vertexCount = data.vertexCount;
+	temp.indexCount = data.indexCount;
+	temp.flags = data.flags;
+	temp.vertexLayout = data.vertexLayout;
+	temp.indexSize = data.indexSize;
+	temp.lodCount = data.lodCount;
+	temp.meshletCount = data.meshletCount;
+	sourceStamp(sourcePath, temp.sourceSize, temp.sourceTime);
+	for (int i = 0; i < 3; ++i)
+	{
+		temp.boundsMin[i] = data.boundsMin[i];
+		temp.boundsMax[i] = data.boundsMax[i];
+	}
+
+	uint64_t vertexSize = static_cast<uint64_t>(data.vertexStride) * data.vertexCount;
+	uint64_t indexDataSize = static_cast<uint64_t>(data.indexSize) * data.indexCount;
+	uint64_t lodDataSize = sizeof(MeshLod) * static_cast<uint64_t>(data.lodCount);
+	uint64_t meshletDataSize = sizeof(Meshlet) * static_cast<uint64_t>(data.meshletCount);
+	temp.vertexOffset = alignOffset(sizeof(MeshCacheHeader));
+	temp.indexOffset = alignOffset(temp.vertexOffset + vertexSize);
+	temp.lodOffset = alignOffset(temp.indexOffset + indexDataSize);
+	temp.meshletOffset = alignOffset(temp.lodOffset + lodDataSize);
+
+	// Making the image of the file in memory, it's used by the renderer in this run
+	ownedData.assign(static_cast<size_t>(temp.meshletOffset + meshletDataSize), 0);
+	memcpy(ownedData.data(), &temp, sizeof(temp));
+	memcpy(ownedData.data() + temp.vertexOffset, data.vertices, static_cast<size_t>(vertexSize));
+	memcpy(ownedData.data() + temp.indexOffset, data.indices, static_cast<size_t>(indexDataSize));
+	memcpy(ownedData.data() + temp.lodOffset, data.lods, static_cast<size_t>(lodDataSize));
+	if (meshletDataSize > 0)
+	{
+		memcpy(ownedData.data() + temp.meshletOffset, data.meshlets, static_cast<size_t>(meshletDataSize));
+	}
+
+	fileData = ownedData.data();
+	header = reinterpret_cast<const MeshCacheHeader*>(fileData);
+
+	// The mesh without the path is kept only in memory
+	if (cachePath.empty())
+	{
+		return;
+	}
+
+	// The file is written to the temporary path first, so another run never maps a half written cache
+	std::string tempPath = cachePath + ".tmp";
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			return;
+		}
+		file.write(ownedData.data(), static_cast<std::streamsize>(ownedData.size()));
+		if (!file)
+		{
+			return;
+		}
+	}
+
+	std::error_code error;
+	std::filesystem::rename(tempPath, cachePath, error);
+	if (error)
+	{
+		std::filesystem::remove(tempPath, error);
+	}
+}
+
+
+
+void MeshCache::close()
+{
+#ifdef _WIN32
+	if (mappedData != nullptr)
+	{
+		UnmapViewOfFile(mappedData);
+	}
+	if (mappingHandle != nullptr)
+	{
+		CloseHandle(mappingHandle);
+	}
+	if (fileHandle != INVALID_HANDLE_VALUE)
+	{
+		CloseHandle(fileHandle);
+	}
+	fileHandle = INVALID_HANDLE_VALUE;
+	mappingHandle = nullptr;
+#else
+	if (mappedData != nullptr)
+	{
+		munmap(mappedData, mappedSize);
+	}
+	if (fileDescriptor >= 0)
+	{
+		::close(fileDescriptor);
+	}
+	fileDescriptor = -1;
+#endif
+	mappedData = nullptr;
+	mappedSize = 0;
+
+	ownedData.clear();
+	ownedData.shrink_to_fit();
+	fileData = nullptr;
+	header = nullptr;
+}
+
+
+
+bool MeshCache::restamp(const std::string& cachePath, const std::string& sourcePath)
+{
+	std::fstream file(cachePath, std::ios::binary | std::ios::in | std::ios::out);
+	MeshCacheHeader temp{};
+	if (!file.read(reinterpret_cast<char*>(&temp), sizeof(temp)) ||
+		memcmp(temp.magic, MESH_CACHE_MAGIC, sizeof(temp.magic)) != 0 || temp.version != VERSION)
+	{
+		return false;
+	}
+
+	if (!sourceStamp(sourcePath, temp.sourceSize, temp.sourceTime))
+	{
+		return false;
+	}
+
+	file.seekp(offsetof(MeshCacheHeader, sourceSize));
+	file.write(reinterpret_cast<const char*>(&temp.sourceSize), sizeof(temp.sourceSize));
+	file.write(reinterpret_cast<const char*>(&temp.sourceTime), sizeof(temp.sourceTime));
+	return static_cast<bool>(file);
+}
+
+
+
+bool MeshCache::sourceStamp(const std::string& sourcePath, uint64_t& size, int64_t& time)
+{
+	std::error_code error;
+	size = static_cast<uint64_t>(std::filesystem::file_size(sourcePath, error));
+	if (error)
+	{
+		size = 0;
+		time = 0;
+		return false;
+	}
+
+	auto writeTime = std::filesystem::last_write_time(sourcePath, error);
+	time = error ? 0 : static_cast<int64_t>(writeTime.time_since_epoch().count());
+	return true;
+}
+
+
+
+bool MeshCache::validate(uint64_t fileSize, const std::string& sourcePath, uint32_t flags) const
+{
+	if (memcmp(header->magic, MESH_CACHE_MAGIC, sizeof(header->magic)) != 0 ||
+		header->version != VERSION ||
+		header->flags != flags ||
+		(header->indexSize != sizeof(uint16_t) && header->indexSize != sizeof(uint32_t)))
+	{
+		return false;
+	}
+
+	// Checking that the arrays fit in the file one after another
+	/// The offset is compared with the file size before the size is subtracted from it, the sum of the broken offset and the size could wrap around
+	auto fits = [fileSize](uint64_t offset, uint64_t size, uint64_t begin)
+	{
+		return offset >= begin && offset <= fileSize && size <= fileSize - offset;
+	};
+	uint64_t lodDataSize = sizeof(MeshLod) * static_cast<uint64_t>(header->lodCount);
+	uint64_t meshletDataSize = sizeof(Meshlet) * static_cast<uint64_t>(header->meshletCount);
+	if (!fits(header->vertexOffset, vertexDataSize(), sizeof(MeshCacheHeader)) ||
+		!fits(header->indexOffset, indexDataSize(), header->vertexOffset + vertexDataSize()) ||
+		!fits(header->lodOffset, lodDataSize, header->indexOffset + indexDataSize()) ||
+		!fits(header->meshletOffset, meshletDataSize, header->lodOffset + lodDataSize) ||
+		header->lodCount == 0)
+	{
+		return false;
+	}
+
+	// Checking that the levels of detail are inside the index array
+	for (uint32_t i = 0; i < header->lodCount; ++i)
+	{
+		const MeshLod& lod = lods()[i];
+		if (static_cast<uint64_t>(lod.firstIndex) + lod.indexCount > header->indexCount ||
+			static_cast<uint64_t>(lod.firstMeshlet) + lod.meshletCount > header->meshletCount)
+		{
+			return false;
+		}
+	}
+
+	// Checking that the meshlets are inside the index array
+	for (uint32_t i = 0; i < header->meshletCount; ++i)
+	{
+		const Meshlet& meshlet = meshlets()[i];
+		if (static_cast<uint64_t>(meshlet.firstIndex) + meshlet.indexCount > header->indexCount)
+		{
+			return false;
+		}
+	}
+
+	// The cache is outdated when the source model was changed, a cache without the source model is used as is
+	uint64_t size;
+	int64_t time;
+	if (sourceStamp(sourcePath, size, time) && (size != header->sourceSize || time != header->sourceTime))
+	{
+		return false;
+	}
+
+	// Checking that the indices point to the vertices, the GPU would read outside of the mesh otherwise
+	/// It's the last check because it reads the whole index array
+	uint32_t maxIndex = 0;
+	if (header->indexSize == sizeof(uint16_t))
+	{
+		const uint16_t* indices = reinterpret_cast<const uint16_t*>(indexData());
+		for (uint32_t i = 0; i < header->indexCount; ++i)
+		{
+			maxIndex = std::max<uint32_t>(maxIndex, indices[i]);
+		}
+	}
+	else
+	{
+		const uint32_t* indices = reinterpret_cast<const uint32_t*>(indexData());
+		for (uint32_t i = 0; i < header->indexCount; ++i)
+		{
+			maxIndex = std::max(maxIndex, indices[i]);
+		}
+	}
+	return header->indexCount == 0 || maxIndex < header->vertexCount;
+}
+
+
+
+MeshCache::~MeshCache()
+{
+	close();
+}
@@ -0,0 +1,158 @@
+// MeshCache.h
+
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+#include "MeshletBuilder.h"
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// The header at the start of the binary mesh file, the vertex and index arrays follow it
+struct MeshCacheHeader
+{
+	// Identifier of the file format "VKMC"
+	char magic[4];
+	// Version of the file format, the cache is rebuilt when it doesn't match MeshCache::VERSION
+	uint32_t version;
+	// Size of one vertex in bytes, the cache is rebuilt when the Vertex struct is changed
+	uint32_t vertexStride;
+	uint32_t vertexCount;
+	uint32_t indexCount;
+	// Processing steps applied to the mesh (MeshCacheFlags) and the LOD settings, the cache is rebuilt when they don't match
+	uint32_t flags;
+	// Identifier of the vertex layout (VertexLayout) and the size of one index in bytes (2 or 4)
+	uint32_t vertexLayout;
+	uint32_t indexSize;
+	// Size and write time of the source model, used to detect an outdated cache
+	uint64_t sourceSize;
+	int64_t sourceTime;
+	// Axis aligned bounding box of the mesh
+	float boundsMin[3];
+	float boundsMax[3];
+	// Offsets of the vertex and index arrays from the start of the file
+	uint64_t vertexOffset;
+	uint64_t indexOffset;
+	// Offset and number of the levels of detail, the first level is the full mesh
+	uint64_t lodOffset;
+	// Offset and number of the meshlets of all levels
+	uint64_t meshletOffset;
+	uint32_t lodCount;
+	uint32_t meshletCount;
+};
+
+// The level of detail is a range of the index array that uses the same vertices
+struct MeshLod
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	// The meshlets that cover the index range of the level
+	uint32_t firstMeshlet;
+	uint32_t meshletCount;
+	// Geometric error of the level in the units of the model, the distance to the surface of the full mesh
+	float error;
+	uint32_t reserved;
+};
+
+// The mesh that is written to the cache
+struct MeshCacheData
+{
+	const void* vertices;
+	uint32_t vertexStride;
+	uint32_t vertexCount;
+	uint32_t vertexLayout;
+
+	const void* indices;
+	uint32_t indexSize;
+	uint32_t indexCount;
+
+	const MeshLod* lods;
+	uint32_t lodCount;
+
+	const Meshlet* meshlets;
+	uint32_t meshletCount;
+
+	float boundsMin[3];
+	float boundsMax[3];
+	uint32_t flags;
+};
+
+// The processing steps that change the content of the cached mesh
+enum MeshCacheFlags : uint32_t
+{
+	MESH_CACHE_OPTIMIZED = 1 << 0,
+	MESH_CACHE_COMPACT_VERTICES = 1 << 1,
+	MESH_CACHE_PACKED_NORMALS = 1 << 2,
+	// The positions of the LOD settings of MeshCookSettings in the flags: the level count, the triangle percent and the error per mille
+	MESH_CACHE_LOD_COUNT_SHIFT = 8,
+	MESH_CACHE_LOD_TRIANGLE_SHIFT = 16,
+	MESH_CACHE_LOD_ERROR_SHIFT = 24
+};
+
+// The class that keeps a deduplicated mesh in a binary file which is mapped to memory on the next runs
+class MeshCache
+{
+public:
+	static const uint32_t VERSION = 4;
+
+	MeshCache();
+
+	MeshCache(const MeshCache&) = delete;
+	MeshCache& operator=(const MeshCache&) = delete;
+
+	// 1. Function to map the cache file to memory, returns false if the file is missing or outdated
+	/// The caller checks that the stride of the saved vertex layout matches the current one
+	bool open(const std::string& cachePath, const std::string& sourcePath, uint32_t flags = 0);
+	// 2. Function to build the cache from the loaded mesh and to write it to the disk
+	/// The mesh stays available in memory even if the file can't be written, the empty cachePath doesn't write the file
+	void create(const std::string& cachePath, const std::string& sourcePath, const MeshCacheData& data);
+	// 3. Function to release the mapped file or the memory
+	void close();
+	// 4. Function to write the current size and write time of the source to the header of the cache file
+	/// It's used by AssetCooker when the source was touched but its content wasn't changed, so the cache stays valid
+	static bool restamp(const std::string& cachePath, const std::string& sourcePath);
+
+	bool isOpen() const { return header != nullptr; };
+
+	const MeshCacheHeader& getHeader() const { return *header; };
+	const void* vertexData() const { return fileData + header->vertexOffset; };
+	const void* indexData() const { return fileData + header->indexOffset; };
+	uint32_t vertexCount() const { return header->vertexCount; };
+	uint32_t indexCount() const { return header->indexCount; };
+	uint32_t indexSize() const { return header->indexSize; };
+	uint32_t vertexLayout() const { return header->vertexLayout; };
+	const MeshLod* lods() const { return reinterpret_cast<const MeshLod*>(fileData + header->lodOffset); };
+	uint32_t lodCount() const { return header->lodCount; };
+	const Meshlet* meshlets() const { return reinterpret_cast<const Meshlet*>(fileData + header->meshletOffset); };
+	uint32_t meshletCount() const { return header->meshletCount; };
+	uint64_t vertexDataSize() const { return static_cast<uint64_t>(header->vertexStride) * header->vertexCount; };
+	uint64_t indexDataSize() const { return static_cast<uint64_t>(header->indexSize) * header->indexCount; };
+
+	~MeshCache();
+
+private:
+	// Function to get the size and the write time of the source model
+	static bool sourceStamp(const std::string& sourcePath, uint64_t& size, int64_t& time);
+	// Function to verify that the header describes the complete and fresh mesh
+	bool validate(uint64_t fileSize, const std::string& sourcePath, uint32_t flags) const;
+
+	// Pointer to the start of the mapped file or the owned buffer
+	const char* fileData;
+	const MeshCacheHeader* header;
+
+	// Memory of the mesh when it was created in this run
+	std::vector<char> ownedData;
+
+	// Handles of the mapped file
+	void* mappedData;
+	uint64_t mappedSize;
+#ifdef _WIN32
+	void* fileHandle;
+	void* mappingHandle;
+#else
+	int fileDescriptor;
+#endif
+};
+
+#endif // MESHCACHE_H
@@ -0,0 +1,242 @@
+// MeshCooker.cpp
+#include "MeshCooker.h"
+#include "ObjParser.h"
+#include "VertexWelder.h"
+#include "MeshOptimizer.h"
+#include "MeshSimplifier.h"
+#include "MeshletBuilder.h"
+
+#include <iostream>
+#include <algorithm>
+#include <limits>
+
+MeshCooker::MeshCooker(ThreadPool& pool, const MeshCookSettings& settings) : pool(pool), settings(settings)
+{
+}
+
+
+
+void MeshCooker::cook(const std::string& modelPath, const std::string& cachePath, MeshCache& cache)
+{
+	// The model is loaded on the worker threads, so the parsed mesh is kept in the local arrays
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	tinyobj::attrib_t attrib;
+	std::vector<tinyobj::index_t> objIndices;
+
+	// Parsing the chunks of the OBJ file on all worker threads
+	ObjParser parser(pool);
+	parser.parse(modelPath, attrib, objIndices);
+
+	// The color and the normal are loaded only if the layout keeps them, otherwise they would split the welded vertices
+	bool hasColors = !attrib.colors.empty();
+	VertexLayout layout = chooseVertexLayout(hasColors, !attrib.normals.empty());
+	bool hasNormals = (layout == VERTEX_LAYOUT_COMPACT_NORMAL);
+
+	// Building the vertex of each corner, the blocks of corners are independent
+	std::vector<Vertex> corners(objIndices.size());
+	const size_t cornerBlockSize = 64 * 1024;
+	pool.parallelFor((corners.size() + cornerBlockSize - 1) / cornerBlockSize, [&](size_t block)
+	{
+		size_t end = std::min(corners.size(), (block + 1) * cornerBlockSize);
+		for (size_t i = block * cornerBlockSize; i < end; ++i)
+		{
+			const tinyobj::index_t& index = objIndices[i];
+			Vertex vertex{};
+
+			vertex.pos = {
+				attrib.vertices[3 * index.vertex_index + 0],
+				attrib.vertices[3 * index.vertex_index + 1],
+				attrib.vertices[3 * index.vertex_index + 2]
+			};
+
+			if (index.texcoord_index >= 0) {
+				vertex.texCoord = {
+					attrib.texcoords[2 * index.texcoord_index + 0],
+					1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
+				};
+			}
+
+			if (hasColors) {
+				vertex.color = {
+					attrib.colors[3 * index.vertex_index + 0],
+					attrib.colors[3 * index.vertex_index + 1],
+					attrib.colors[3 * index.vertex_index + 2]
+				};
+			}
+			else {
+				vertex.color = { 1.0f, 1.0f, 1.0f };
+			}
+
+			if (hasNormals && index.normal_index >= 0) {
+				vertex.normal = {
+					attrib.normals[3 * index.normal_index + 0],
+					attrib.normals[3 * index.normal_index + 1],
+					attrib.normals[3 * index.normal_index + 2]
+				};
+			}
+
+			// The zeros of both signs are the same vertex for the welder
+			VertexWelder::canonicalizeZeros(&vertex, sizeof(vertex));
+			corners[i] = vertex;
+		}
+	});
+	std::vector<tinyobj::index_t>().swap(objIndices);
+
+	// Merging the equal corners into the unique vertices
+	VertexWelder welder(pool);
+	welder.weld(corners, vertices, indices);
+	std::vector<Vertex>().swap(corners);
+
+	// Reordering the mesh for the GPU, the result is saved in the cache, so it's done once per model
+	if (settings.optimize)
+	{
+		MeshOptimizer optimizer;
+		MeshStatistics before = optimizer.analyzeVertexCache(indices.data(), indices.size(), static_cast<uint32_t>(vertices.size()));
+		optimizer.optimize(vertices, indices, offsetof(Vertex, pos));
+		MeshStatistics after = optimizer.analyzeVertexCache(indices.data(), indices.size(), static_cast<uint32_t>(vertices.size()));
+
+		if (settings.verbose)
+		{
+			std::cout << "--Mesh optimization: ACMR " << before.acmr << " -> " << after.acmr <<
+				", ATVR " << before.atvr << " -> " << after.atvr << std::endl;
+		}
+	}
+
+	// Calculating the bounds of the mesh for the cache header
+	glm::vec3 boundsMin(std::numeric_limits<float>::max());
+	glm::vec3 boundsMax(-std::numeric_limits<float>::max());
+	for (const auto& vertex : vertices)
+	{
+		boundsMin = glm::min(boundsMin, vertex.pos);
+		boundsMax = glm::max(boundsMax, vertex.pos);
+	}
+
+	std::vector<MeshLod> lods;
+	generateLods(glm::length(boundsMax - boundsMin), vertices, indices, lods);
+
+	// Splitting each level into meshlets, the draw calls skip the meshlets that can't be seen
+	std::vector<Meshlet> meshlets;
+	MeshletBuilder meshletBuilder(static_cast<uint32_t>(vertices.size()));
+	for (auto& lod : lods)
+	{
+		lod.firstMeshlet = static_cast<uint32_t>(meshlets.size());
+		meshletBuilder.build(indices.data(), lod.firstIndex, lod.indexCount, reinterpret_cast<const char*>(vertices.data()) + offsetof(Vertex, pos),
+								sizeof(Vertex), meshlets);
+		lod.meshletCount = static_cast<uint32_t>(meshlets.size()) - lod.firstMeshlet;
+	}
+
+	// Converting the vertices to the chosen layout, the compact layouts are quantized to the bounds
+	VertexBounds bounds{ boundsMin, boundsMax - boundsMin };
+	std::vector<char> vertexData = encodeVertices(layout, vertices, bounds);
+	uint32_t vertexStride = getVertexLayoutInfo(layout).stride;
+
+	// The 16-bit indices halve the index buffer when all vertices can be addressed by them
+	std::vector<uint16_t> shortIndices;
+	if (vertices.size() <= std::numeric_limits<uint16_t>::max())
+	{
+		shortIndices.assign(indices.begin(), indices.end());
+	}
+	const void* indexData = shortIndices.empty() ? static_cast<const void*>(indices.data()) : shortIndices.data();
+	uint32_t indexSize = shortIndices.empty() ? sizeof(uint32_t) : sizeof(uint16_t);
+
+	// Saving the deduplicated mesh, the next runs map this file instead of parsing the model
+	MeshCacheData meshData{};
+	meshData.vertices = vertexData.data();
+	meshData.vertexStride = vertexStride;
+	meshData.vertexCount = static_cast<uint32_t>(vertices.size());
+	meshData.vertexLayout = layout;
+	meshData.indices = indexData;
+	meshData.indexSize = indexSize;
+	meshData.indexCount = static_cast<uint32_t>(indices.size());
+	meshData.lods = lods.data();
+	meshData.lodCount = static_cast<uint32_t>(lods.size());
+	meshData.meshlets = meshlets.data();
+	meshData.meshletCount = static_cast<uint32_t>(meshlets.size());
+	for (int i = 0; i < 3; ++i)
+	{
+		meshData.boundsMin[i] = boundsMin[i];
+		meshData.boundsMax[i] = boundsMax[i];
+	}
+	meshData.flags = cacheFlags();
+	cache.create(cachePath, modelPath, meshData);
+
+	if (settings.verbose)
+	{
+		std::cout << "--Vertex layout: " << layout << " stride: " << vertexStride << " index size: " << indexSize << std::endl;
+		for (size_t i = 0; i < lods.size(); ++i)
+		{
+			std::cout << "--LOD " << i << ": triangles: " << lods[i].indexCount / 3 << " meshlets: " << lods[i].meshletCount <<
+				" error: " << lods[i].error << std::endl;
+		}
+	}
+}
+
+
+uint32_t MeshCooker::cacheFlags() const
+{
+	// Each LOD setting takes 8 bits, the larger values aren't meaningful and are clamped
+	return (settings.optimize ? static_cast<uint32_t>(MESH_CACHE_OPTIMIZED) : 0u) |
+			(settings.compactVertices ? static_cast<uint32_t>(MESH_CACHE_COMPACT_VERTICES) : 0u) |
+			(settings.packedNormals ? static_cast<uint32_t>(MESH_CACHE_PACKED_NORMALS) : 0u) |
+			(std::min(settings.maxLodCount, 255u) << MESH_CACHE_LOD_COUNT_SHIFT) |
+			(std::min(settings.lodTrianglePercent, 255u) << MESH_CACHE_LOD_TRIANGLE_SHIFT) |
+			(std::min(settings.lodErrorPermille, 255u) << MESH_CACHE_LOD_ERROR_SHIFT);
+}
+
+
+
+VertexLayout MeshCooker::chooseVertexLayout(bool hasColors, bool hasNormals) const
+{
+	// The compact layouts have no color stream, the colors of the model need the full precision layout
+	if (!settings.compactVertices || hasColors)
+	{
+		return VERTEX_LAYOUT_FULL;
+	}
+
+	VertexLayout layout = (settings.packedNormals && hasNormals) ? VERTEX_LAYOUT_COMPACT_NORMAL : VERTEX_LAYOUT_COMPACT;
+	if (layoutFilter && !layoutFilter(layout))
+	{
+		return VERTEX_LAYOUT_FULL;
+	}
+	return layout;
+}
+
+
+
+void MeshCooker::generateLods(float meshSize, const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<MeshLod>& lods)
+{
+	lods.clear();
+	lods.push_back({ 0, static_cast<uint32_t>(indices.size()), 0, 0, 0.0f, 0 });
+
+	MeshSimplifier simplifier(pool);
+	MeshOptimizer optimizer;
+	std::vector<uint32_t> lodIndices(indices);
+	std::vector<uint32_t> simplified;
+	float error = 0.0f;
+
+	// Each level is simplified from the previous one, so the errors of the steps are summed
+	while (lods.size() < settings.maxLodCount)
+	{
+		float stepError = simplifier.simplify(lodIndices, reinterpret_cast<const char*>(vertices.data()) + offsetof(Vertex, pos), sizeof(Vertex),
+												static_cast<uint32_t>(vertices.size()), lodIndices.size() / 3 * settings.lodTrianglePercent / 100 * 3,
+												meshSize * static_cast<float>(settings.lodErrorPermille) / 1000.0f, simplified);
+
+		// The level is kept only if it removes at least 10% of the triangles, the borders and the seams are never simplified
+		if (simplified.size() * 10 > lodIndices.size() * 9)
+		{
+			break;
+		}
+
+		if (settings.optimize)
+		{
+			std::vector<uint32_t> clusters;
+			optimizer.optimizeVertexCache(simplified, static_cast<uint32_t>(vertices.size()), clusters);
+		}
+
+		error += stepError;
+		lods.push_back({ static_cast<uint32_t>(indices.size()), static_cast<uint32_t>(simplified.size()), 0, 0, error, 0 });
+		indices.insert(indices.end(), simplified.begin(), simplified.end());
+		lodIndices.swap(simplified);
+	}
+}
@@ -0,0 +1,61 @@
+// MeshCooker.h
+
+#ifndef MESHCOOKER_H
+#define MESHCOOKER_H
+
+#include "ThreadPool.h"
+#include "MeshCache.h"
+#include "VertexLayouts.h"
+
+#include <functional>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// The processing steps of the mesh, the steps that change the result are saved in the flags of the cache
+struct MeshCookSettings
+{
+	// Reordering of the triangles and the vertices for the vertex cache, the overdraw and the vertex fetch
+	bool optimize;
+	// Quantization of the vertices to the compact layouts, the models with the vertex colors keep the full precision
+	bool compactVertices;
+	// Octahedral normals in the compact layout, they are used only when the model has the normals
+	bool packedNormals;
+	// The largest number of the levels of detail including the full mesh
+	uint32_t maxLodCount;
+	// The target of each level in percent of the triangles of the previous level
+	uint32_t lodTrianglePercent;
+	// The largest error of one simplification step in per mille of the size of the mesh
+	uint32_t lodErrorPermille;
+	// Printing of the statistics of the steps
+	bool verbose;
+};
+
+// The class that turns the OBJ model into the runtime mesh cache: welded, optimized, with the levels of detail and the meshlets
+/// It's used by the renderer when the cache is missing and by AssetCooker, which cooks all models before the run
+class MeshCooker
+{
+public:
+	MeshCooker(ThreadPool& pool, const MeshCookSettings& settings);
+
+	// 1. Function to process the model and to write the result to cachePath, the mesh stays available in the cache
+	void cook(const std::string& modelPath, const std::string& cachePath, MeshCache& cache);
+	// 2. Function to get the flags that the cache has to match to be used with these settings
+	/// The LOD settings take the upper bits, so the cache with the other levels of detail is rebuilt too
+	uint32_t cacheFlags() const;
+	// 3. Function to set the check of the compact layouts, the layout that fails it is replaced by VERTEX_LAYOUT_FULL
+	/// The renderer checks the formats of the device, the offline cooker accepts all layouts
+	void setLayoutFilter(std::function<bool(VertexLayout)> filter) { layoutFilter = std::move(filter); };
+
+private:
+	// Function to choose the most compact layout that keeps the attributes of the model
+	VertexLayout chooseVertexLayout(bool hasColors, bool hasNormals) const;
+	// Function to append the simplified levels to the index array, each level is a range of the indices
+	void generateLods(float meshSize, const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, std::vector<MeshLod>& lods);
+
+	ThreadPool& pool;
+	MeshCookSettings settings;
+	std::function<bool(VertexLayout)> layoutFilter;
+};
+
+#endif // MESHCOOKER_H
@@ -0,0 +1,357 @@
+// MeshOptimizer.cpp
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	// The position of the vertex in the array with the given stride
+	const float* positionOf(const char* positions, size_t positionStride, uint32_t vertex)
+	{
+		return reinterpret_cast<const float*>(positions + static_cast<size_t>(vertex) * positionStride);
+	}
+}
+
+
+
+MeshOptimizer::MeshOptimizer(uint32_t cacheSize)
+{
+	this->cacheSize = cacheSize;
+}
+
+
+
+void MeshOptimizer::optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount, std::vector<uint32_t>& clusters)
+{
+	clusters.clear();
+	size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0)
+	{
+		return;
+	}
+
+	// The triangles of each vertex are kept in one array, offsets points to the list of the vertex
+	std::vector<uint32_t> liveTriangles(vertexCount, 0);
+	for (size_t i = 0; i < triangleCount * 3; ++i)
+	{
+		++liveTriangles[indices[i]];
+	}
+
+	std::vector<uint32_t> offsets(vertexCount + 1, 0);
+	for (uint32_t vertex = 0; vertex < vertexCount; ++vertex)
+	{
+		offsets[vertex + 1] = offsets[vertex] + liveTriangles[vertex];
+	}
+
+	std::vector<uint32_t> adjacency(triangleCount * 3);
+	std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < triangleCount * 3; ++i)
+	{
+		adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+	}
+
+	std::vector<uint32_t> cacheTimes(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> deadEnd;
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> output;
+	output.reserve(triangleCount * 3);
+
+	uint32_t timestamp = cacheSize + 1;
+	uint32_t cursor = 0;
+	while (cursor < vertexCount && liveTriangles[cursor] == 0)
+	{
+		++cursor;
+	}
+	uint32_t fanning = cursor;
+	clusters.emplace_back(0);
+
+	while (fanning != NOT_USED)
+	{
+		// Emitting all remaining triangles around the fanning vertex
+		candidates.clear();
+		for (uint32_t k = offsets[fanning]; k < offsets[fanning + 1]; ++k)
+		{
+			uint32_t triangle = adjacency[k];
+			if (emitted[triangle])
+			{
+				continue;
+			}
+
+			for (uint32_t corner = 0; corner < 3; ++corner)
+			{
+				uint32_t vertex = indices[triangle * 3 + corner];
+				output.emplace_back(vertex);
+				deadEnd.emplace_back(vertex);
+				candidates.emplace_back(vertex);
+				--liveTriangles[vertex];
+
+				if (timestamp - cacheTimes[vertex] > cacheSize)
+				{
+					cacheTimes[vertex] = timestamp++;
+				}
+			}
+			emitted[triangle] = true;
+		}
+
+		fanning = getNextVertex(candidates, liveTriangles, cacheTimes, timestamp);
+		if (fanning != NOT_USED)
+		{
+			continue;
+		}
+
+		// The neighbours are finished, the recently used vertices are checked first, then the rest of the mesh
+		while (!deadEnd.empty())
+		{
+			uint32_t vertex = deadEnd.back();
+			deadEnd.pop_back();
+			if (liveTriangles[vertex] > 0)
+			{
+				fanning = vertex;
+				break;
+			}
+		}
+		while (fanning == NOT_USED && cursor < vertexCount)
+		{
+			if (liveTriangles[cursor] > 0)
+			{
+				fanning = cursor;
+			}
+			++cursor;
+		}
+
+		if (fanning != NOT_USED)
+		{
+			clusters.emplace_back(static_cast<uint32_t>(output.size() / 3));
+		}
+	}
+
+	indices.swap(output);
+}
+
+
+
+void MeshOptimizer::optimizeOverdraw(std::vector<uint32_t>& indices, const char* positions, size_t positionStride, uint32_t vertexCount,
+										const std::vector<uint32_t>& clusters, float threshold)
+{
+	uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+	if (triangleCount == 0 || clusters.empty())
+	{
+		return;
+	}
+
+	// The cache is cleared by moving the time forward, so all vertices become older than the cache size
+	std::vector<uint32_t> cacheTimes(vertexCount, 0);
+	uint32_t timestamp = cacheSize + 1;
+	auto simulateTriangle = [&](uint32_t triangle)
+	{
+		uint32_t misses = 0;
+		for (uint32_t corner = 0; corner < 3; ++corner)
+		{
+			uint32_t vertex = indices[triangle * 3 + corner];
+			if (timestamp - cacheTimes[vertex] > cacheSize)
+			{
+				cacheTimes[vertex] = timestamp++;
+				++misses;
+			}
+		}
+		return misses;
+	};
+
+	// 1. Splitting the clusters of Tipsify into the smaller parts which keep the cache efficiency
+	std::vector<uint32_t> parts;
+	for (size_t cluster = 0; cluster < clusters.size(); ++cluster)
+	{
+		uint32_t start = clusters[cluster];
+		uint32_t end = (cluster + 1 < clusters.size()) ? clusters[cluster + 1] : triangleCount;
+
+		timestamp += cacheSize + 1;
+		uint32_t clusterMisses = 0;
+		for (uint32_t triangle = start; triangle < end; ++triangle)
+		{
+			clusterMisses += simulateTriangle(triangle);
+		}
+		float clusterAcmr = static_cast<float>(clusterMisses) / static_cast<float>(end - start);
+
+		timestamp += cacheSize + 1;
+		parts.emplace_back(start);
+		uint32_t partStart = start;
+		uint32_t partMisses = 0;
+		for (uint32_t triangle = start; triangle < end; ++triangle)
+		{
+			partMisses += simulateTriangle(triangle);
+			if (triangle + 1 < end && static_cast<float>(partMisses) <= clusterAcmr * threshold * static_cast<float>(triangle + 1 - partStart))
+			{
+				parts.emplace_back(triangle + 1);
+				timestamp += cacheSize + 1;
+				partStart = triangle + 1;
+				partMisses = 0;
+			}
+		}
+	}
+	parts.emplace_back(triangleCount);
+
+	// 2. Calculating the centroid and the average normal of each part weighted by the triangle area
+	size_t partCount = parts.size() - 1;
+	std::vector<float> partCentroids(partCount * 3, 0.0f);
+	std::vector<float> partNormals(partCount * 3, 0.0f);
+	float meshCentroid[3] = { 0.0f, 0.0f, 0.0f };
+	float meshArea = 0.0f;
+
+	for (size_t part = 0; part < partCount; ++part)
+	{
+		float partArea = 0.0f;
+		for (uint32_t triangle = parts[part]; triangle < parts[part + 1]; ++triangle)
+		{
+			const float* a = positionOf(positions, positionStride, indices[triangle * 3 + 0]);
+			const float* b = positionOf(positions, positionStride, indices[triangle * 3 + 1]);
+			const float* c = positionOf(positions, positionStride, indices[triangle * 3 + 2]);
+
+			float edge1[3] = { b[0] - a[0], b[1] - a[1], b[2] - a[2] };
+			float edge2[3] = { c[0] - a[0], c[1] - a[1], c[2] - a[2] };
+			// The length of the cross product is the doubled area of the triangle
+			float normal[3] = {
+				edge1[1] * edge2[2] - edge1[2] * edge2[1],
+				edge1[2] * edge2[0] - edge1[0] * edge2[2],
+				edge1[0] * edge2[1] - edge1[1] * edge2[0]
+			};
+			float area = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				float centroid = (a[axis] + b[axis] + c[axis]) / 3.0f;
+				partCentroids[part * 3 + axis] += centroid * area;
+				meshCentroid[axis] += centroid * area;
+				partNormals[part * 3 + axis] += normal[axis];
+			}
+			partArea += area;
+		}
+
+		for (int axis = 0; axis < 3; ++axis)
+		{
+			partCentroids[part * 3 + axis] = (partArea > 0.0f) ? partCentroids[part * 3 + axis] / partArea : 0.0f;
+		}
+		meshArea += partArea;
+	}
+
+	for (int axis = 0; axis < 3; ++axis)
+	{
+		meshCentroid[axis] = (meshArea > 0.0f) ? meshCentroid[axis] / meshArea : 0.0f;
+	}
+
+	// 3. Sorting the parts, the ones that face away from the center of the mesh are on the outside and go first
+	std::vector<float> sortKeys(partCount, 0.0f);
+	for (size_t part = 0; part < partCount; ++part)
+	{
+		const float* normal = &partNormals[part * 3];
+		float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		if (length > 0.0f)
+		{
+			for (int axis = 0; axis < 3; ++axis)
+			{
+				sortKeys[part] += (partCentroids[part * 3 + axis] - meshCentroid[axis]) * normal[axis] / length;
+			}
+		}
+	}
+
+	std::vector<uint32_t> order(partCount);
+	for (size_t part = 0; part < partCount; ++part)
+	{
+		order[part] = static_cast<uint32_t>(part);
+	}
+	std::stable_sort(order.begin(), order.end(), [&sortKeys](uint32_t left, uint32_t right)
+	{
+		return sortKeys[left] > sortKeys[right];
+	});
+
+	std::vector<uint32_t> output;
+	output.reserve(indices.size());
+	for (uint32_t part : order)
+	{
+		output.insert(output.end(), indices.begin() + parts[part] * 3, indices.begin() + parts[part + 1] * 3);
+	}
+	indices.swap(output);
+}
+
+
+
+uint32_t MeshOptimizer::optimizeVertexFetch(std::vector<uint32_t>& indices, uint32_t vertexCount, std::vector<uint32_t>& remap)
+{
+	remap.assign(vertexCount, NOT_USED);
+	uint32_t nextVertex = 0;
+	for (auto& index : indices)
+	{
+		if (remap[index] == NOT_USED)
+		{
+			remap[index] = nextVertex++;
+		}
+		index = remap[index];
+	}
+	return nextVertex;
+}
+
+
+
+MeshStatistics MeshOptimizer::analyzeVertexCache(const uint32_t* indices, size_t indexCount, uint32_t vertexCount) const
+{
+	MeshStatistics statistics{};
+	std::vector<uint32_t> cacheTimes(vertexCount, 0);
+	uint32_t timestamp = cacheSize + 1;
+	uint32_t misses = 0;
+	uint32_t usedVertices = 0;
+
+	for (size_t i = 0; i < indexCount; ++i)
+	{
+		uint32_t vertex = indices[i];
+		if (cacheTimes[vertex] == 0)
+		{
+			++usedVertices;
+		}
+		if (timestamp - cacheTimes[vertex] > cacheSize)
+		{
+			cacheTimes[vertex] = timestamp++;
+			++misses;
+		}
+	}
+
+	if (indexCount >= 3)
+	{
+		statistics.acmr = static_cast<float>(misses) / static_cast<float>(indexCount / 3);
+	}
+	if (usedVertices > 0)
+	{
+		statistics.atvr = static_cast<float>(misses) / static_cast<float>(usedVertices);
+	}
+	return statistics;
+}
+
+
+
+uint32_t MeshOptimizer::getNextVertex(const std::vector<uint32_t>& candidates, const std::vector<uint32_t>& liveTriangles,
+										const std::vector<uint32_t>& cacheTimes, uint32_t timestamp) const
+{
+	// The vertex stays in the cache if all its triangles are emitted before it's pushed out, older vertices are preferred
+	uint32_t bestVertex = NOT_USED;
+	int64_t bestPriority = -1;
+	for (uint32_t vertex : candidates)
+	{
+		if (liveTriangles[vertex] == 0)
+		{
+			continue;
+		}
+
+		int64_t priority = 0;
+		int64_t age = static_cast<int64_t>(timestamp) - cacheTimes[vertex];
+		if (age + 2 * static_cast<int64_t>(liveTriangles[vertex]) <= cacheSize)
+		{
+			priority = age;
+		}
+		if (priority > bestPriority)
+		{
+			bestPriority = priority;
+			bestVertex = vertex;
+		}
+	}
+	return bestVertex;
+}
@@ -0,0 +1,78 @@
+// MeshOptimizer.h
+
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// The efficiency of the post-transform vertex cache for the index buffer
+struct MeshStatistics
+{
+	// Average cache miss ratio, the number of vertex shader invocations per triangle (0.5 is the best, 3.0 is the worst)
+	float acmr;
+	// Average transformed vertex ratio, the number of vertex shader invocations per vertex (1.0 is the best)
+	float atvr;
+};
+
+// The class that reorders the triangles and the vertices of the mesh for the GPU
+/// 1. The triangles are ordered for the vertex cache with the Tipsify algorithm (Sander, Nehab, Barczak 2007)
+/// 2. The clusters of triangles are sorted so that the outer surfaces are drawn first and hide the inner ones
+/// 3. The vertices are renumbered in order of their first use, so the vertex fetch reads the buffer linearly
+class MeshOptimizer
+{
+public:
+	// The cache is modeled as FIFO, 16 entries fit the most of the desktop GPUs
+	explicit MeshOptimizer(uint32_t cacheSize = 16);
+
+	// 1. Function to run all steps of the optimization, the vertices are reordered together with the indices
+	template<typename VertexType>
+	void optimize(std::vector<VertexType>& vertices, std::vector<uint32_t>& indices, size_t positionOffset)
+	{
+		std::vector<uint32_t> clusters;
+		optimizeVertexCache(indices, static_cast<uint32_t>(vertices.size()), clusters);
+		optimizeOverdraw(indices, reinterpret_cast<const char*>(vertices.data()) + positionOffset, sizeof(VertexType),
+							static_cast<uint32_t>(vertices.size()), clusters);
+
+		std::vector<uint32_t> remap;
+		uint32_t vertexCount = optimizeVertexFetch(indices, static_cast<uint32_t>(vertices.size()), remap);
+
+		std::vector<VertexType> reordered(vertexCount);
+		for (size_t i = 0; i < vertices.size(); ++i)
+		{
+			if (remap[i] != NOT_USED)
+			{
+				reordered[remap[i]] = vertices[i];
+			}
+		}
+		vertices.swap(reordered);
+	}
+
+	// 2. Function to reorder the triangles for the vertex cache
+	/// clusters gets the first triangle of each cluster, the new cluster starts where the algorithm had to jump to the unconnected part
+	void optimizeVertexCache(std::vector<uint32_t>& indices, uint32_t vertexCount, std::vector<uint32_t>& clusters);
+
+	// 3. Function to sort the clusters of triangles from the outer to the inner ones
+	/// The large clusters are split while the cache efficiency of the parts is not worse than threshold * efficiency of the cluster
+	void optimizeOverdraw(std::vector<uint32_t>& indices, const char* positions, size_t positionStride, uint32_t vertexCount,
+							const std::vector<uint32_t>& clusters, float threshold = 1.05f);
+
+	// 4. Function to renumber the vertices in order of their first use, returns the number of used vertices
+	/// remap gets the new number of each old vertex or NOT_USED for the vertices without triangles
+	uint32_t optimizeVertexFetch(std::vector<uint32_t>& indices, uint32_t vertexCount, std::vector<uint32_t>& remap);
+
+	// 5. Function to simulate the vertex cache on the index buffer
+	MeshStatistics analyzeVertexCache(const uint32_t* indices, size_t indexCount, uint32_t vertexCount) const;
+
+	static const uint32_t NOT_USED = 0xffffffffu;
+
+private:
+	// Function to select the next fanning vertex of Tipsify from the vertices of the last triangles
+	uint32_t getNextVertex(const std::vector<uint32_t>& candidates, const std::vector<uint32_t>& liveTriangles,
+							const std::vector<uint32_t>& cacheTimes, uint32_t timestamp) const;
+
+	uint32_t cacheSize;
+};
+
+#endif // MESHOPTIMIZER_H
@@ -0,0 +1,360 @@
+// MeshSimplifier.cpp
+#include "MeshSimplifier.h"
+#include "VertexWelder.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace
+{
+	const float* positionOf(const char* positions, size_t positionStride, uint32_t vertex)
+	{
+		return reinterpret_cast<const float*>(positions + static_cast<size_t>(vertex) * positionStride);
+	}
+
+	void triangleNormal(const float* p0, const float* p1, const float* p2, double normal[3])
+	{
+		double edge1[3] = { p1[0] - p0[0], p1[1] - p0[1], p1[2] - p0[2] };
+		double edge2[3] = { p2[0] - p0[0], p2[1] - p0[1], p2[2] - p0[2] };
+		normal[0] = edge1[1] * edge2[2] - edge1[2] * edge2[1];
+		normal[1] = edge1[2] * edge2[0] - edge1[0] * edge2[2];
+		normal[2] = edge1[0] * edge2[1] - edge1[1] * edge2[0];
+	}
+
+	uint64_t edgeKey(uint32_t a, uint32_t b)
+	{
+		return (a < b) ? (static_cast<uint64_t>(a) << 32 | b) : (static_cast<uint64_t>(b) << 32 | a);
+	}
+}
+
+
+
+MeshSimplifier::MeshSimplifier(ThreadPool& pool) : pool(pool)
+{
+}
+
+
+
+float MeshSimplifier::simplify(const std::vector<uint32_t>& indices, const char* positions, size_t positionStride, uint32_t vertexCount,
+								size_t targetIndexCount, float targetError, std::vector<uint32_t>& result)
+{
+	result = indices;
+	if (result.size() <= targetIndexCount)
+	{
+		return 0.0f;
+	}
+
+	// The vertices with the same position and different attributes get the same position id
+	std::vector<float> packedPositions(static_cast<size_t>(vertexCount) * 3);
+	for (uint32_t vertex = 0; vertex < vertexCount; ++vertex)
+	{
+		memcpy(&packedPositions[vertex * 3], positionOf(positions, positionStride, vertex), sizeof(float) * 3);
+	}
+	VertexWelder::canonicalizeZeros(packedPositions.data(), packedPositions.size() * sizeof(float));
+	std::vector<uint32_t> positionIds;
+	std::vector<uint32_t> firstVertices;
+	VertexWelder welder(pool);
+	welder.weld(packedPositions.data(), sizeof(float) * 3, vertexCount, positionIds, firstVertices);
+
+	std::vector<VertexKind> kinds;
+	classifyVertices(result, positionIds, kinds);
+
+	std::vector<Quadric> quadrics(vertexCount, Quadric{});
+	for (size_t i = 0; i + 2 < result.size(); i += 3)
+	{
+		Quadric triangle{};
+		addTriangle(triangle, positionOf(positions, positionStride, result[i + 0]),
+						positionOf(positions, positionStride, result[i + 1]),
+						positionOf(positions, positionStride, result[i + 2]));
+		for (int corner = 0; corner < 3; ++corner)
+		{
+			addQuadric(quadrics[result[i + corner]], triangle);
+		}
+	}
+
+	double errorLimit = static_cast<double>(targetError) * targetError;
+	double maxError = 0.0;
+	std::vector<uint32_t> remap(vertexCount);
+	std::vector<bool> locked(vertexCount);
+	std::vector<uint32_t> offsets(vertexCount + 1);
+	std::vector<uint32_t> adjacency;
+	std::vector<Collapse> collapses;
+
+	// Each pass collapses the cheapest edges that don't touch each other, then the index buffer is rebuilt
+	while (result.size() > targetIndexCount)
+	{
+		size_t triangleCount = result.size() / 3;
+
+		// The triangles around each vertex for the check of the turned over triangles
+		std::fill(offsets.begin(), offsets.end(), 0);
+		for (uint32_t index : result)
+		{
+			++offsets[index + 1];
+		}
+		for (uint32_t vertex = 0; vertex < vertexCount; ++vertex)
+		{
+			offsets[vertex + 1] += offsets[vertex];
+		}
+		adjacency.resize(result.size());
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < result.size(); ++i)
+		{
+			adjacency[fill[result[i]]++] = static_cast<uint32_t>(i / 3);
+		}
+
+		collapses.clear();
+		for (size_t triangle = 0; triangle < triangleCount; ++triangle)
+		{
+			for (int edge = 0; edge < 3; ++edge)
+			{
+				uint32_t a = result[triangle * 3 + edge];
+				uint32_t b = result[triangle * 3 + (edge + 1) % 3];
+				const uint32_t ends[2][2] = { { a, b }, { b, a } };
+				for (const auto& end : ends)
+				{
+					if (kinds[end[0]] != VERTEX_INTERIOR)
+					{
+						continue;
+					}
+					Quadric quadric = quadrics[end[0]];
+					addQuadric(quadric, quadrics[end[1]]);
+					float cost = static_cast<float>(evaluate(quadric, positionOf(positions, positionStride, end[1])));
+					collapses.push_back({ cost, end[0], end[1] });
+				}
+			}
+		}
+
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& left, const Collapse& right)
+		{
+			if (left.cost != right.cost)
+			{
+				return left.cost < right.cost;
+			}
+			return left.from < right.from || (left.from == right.from && left.to < right.to);
+		});
+
+		for (uint32_t vertex = 0; vertex < vertexCount; ++vertex)
+		{
+			remap[vertex] = vertex;
+		}
+		std::fill(locked.begin(), locked.end(), false);
+
+		size_t collapseCount = 0;
+		for (const auto& collapse : collapses)
+		{
+			if (collapse.cost > errorLimit || triangleCount * 3 <= targetIndexCount)
+			{
+				break;
+			}
+			if (locked[collapse.from] || locked[collapse.to] ||
+				!isCollapseValid(result, offsets, adjacency, positions, positionStride, collapse.from, collapse.to))
+			{
+				continue;
+			}
+
+			// The neighbours are locked, so the adjacency stays valid for the other collapses of this pass
+			for (uint32_t k = offsets[collapse.from]; k < offsets[collapse.from + 1]; ++k)
+			{
+				const uint32_t* triangle = &result[adjacency[k] * 3];
+				if (triangle[0] == collapse.to || triangle[1] == collapse.to || triangle[2] == collapse.to)
+				{
+					--triangleCount;
+				}
+				locked[triangle[0]] = true;
+				locked[triangle[1]] = true;
+				locked[triangle[2]] = true;
+			}
+
+			remap[collapse.from] = collapse.to;
+			addQuadric(quadrics[collapse.to], quadrics[collapse.from]);
+			maxError = std::max(maxError, static_cast<double>(collapse.cost));
+			++collapseCount;
+		}
+
+		if (collapseCount == 0)
+		{
+			break;
+		}
+
+		// Removing the triangles that lost their area in the collapses
+		size_t writeIndex = 0;
+		for (size_t i = 0; i + 2 < result.size(); i += 3)
+		{
+			uint32_t a = remap[result[i + 0]];
+			uint32_t b = remap[result[i + 1]];
+			uint32_t c = remap[result[i + 2]];
+			if (a != b && b != c && a != c)
+			{
+				result[writeIndex++] = a;
+				result[writeIndex++] = b;
+				result[writeIndex++] = c;
+			}
+		}
+		result.resize(writeIndex);
+	}
+
+	return static_cast<float>(std::sqrt(maxError));
+}
+
+
+
+void MeshSimplifier::classifyVertices(const std::vector<uint32_t>& indices, const std::vector<uint32_t>& positionIds, std::vector<VertexKind>& kinds)
+{
+	kinds.assign(positionIds.size(), VERTEX_INTERIOR);
+
+	// The position shared by several vertices is a seam of the texture coordinates or the normals
+	std::vector<uint32_t> positionUses(positionIds.size(), 0);
+	for (uint32_t positionId : positionIds)
+	{
+		++positionUses[positionId];
+	}
+	for (size_t vertex = 0; vertex < positionIds.size(); ++vertex)
+	{
+		if (positionUses[positionIds[vertex]] > 1)
+		{
+			kinds[vertex] = VERTEX_SEAM;
+		}
+	}
+
+	// The edge of the positions that doesn't have exactly two triangles is a border or a non-manifold edge
+	std::vector<uint64_t> edges;
+	edges.reserve(indices.size());
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		for (int edge = 0; edge < 3; ++edge)
+		{
+			edges.emplace_back(edgeKey(positionIds[indices[i + edge]], positionIds[indices[i + (edge + 1) % 3]]));
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3)
+	{
+		for (int edge = 0; edge < 3; ++edge)
+		{
+			uint32_t a = indices[i + edge];
+			uint32_t b = indices[i + (edge + 1) % 3];
+			auto range = std::equal_range(edges.begin(), edges.end(), edgeKey(positionIds[a], positionIds[b]));
+			if (range.second - range.first != 2)
+			{
+				if (kinds[a] == VERTEX_INTERIOR)
+				{
+					kinds[a] = VERTEX_BORDER;
+				}
+				if (kinds[b] == VERTEX_INTERIOR)
+				{
+					kinds[b] = VERTEX_BORDER;
+				}
+			}
+		}
+	}
+}
+
+
+
+bool MeshSimplifier::isCollapseValid(const std::vector<uint32_t>& indices, const std::vector<uint32_t>& offsets, const std::vector<uint32_t>& adjacency,
+										const char* positions, size_t positionStride, uint32_t from, uint32_t to) const
+{
+	const float* target = positionOf(positions, positionStride, to);
+	for (uint32_t k = offsets[from]; k < offsets[from + 1]; ++k)
+	{
+		const uint32_t* triangle = &indices[adjacency[k] * 3];
+		// The triangles on the collapsed edge disappear
+		if (triangle[0] == to || triangle[1] == to || triangle[2] == to)
+		{
+			continue;
+		}
+
+		const float* before[3];
+		const float* after[3];
+		for (int corner = 0; corner < 3; ++corner)
+		{
+			before[corner] = positionOf(positions, positionStride, triangle[corner]);
+			after[corner] = (triangle[corner] == from) ? target : before[corner];
+		}
+
+		double normalBefore[3];
+		double normalAfter[3];
+		triangleNormal(before[0], before[1], before[2], normalBefore);
+		triangleNormal(after[0], after[1], after[2], normalAfter);
+
+		double dot = normalBefore[0] * normalAfter[0] + normalBefore[1] * normalAfter[1] + normalBefore[2] * normalAfter[2];
+		double lengthBefore = std::sqrt(normalBefore[0] * normalBefore[0] + normalBefore[1] * normalBefore[1] + normalBefore[2] * normalBefore[2]);
+		double lengthAfter = std::sqrt(normalAfter[0] * normalAfter[0] + normalAfter[1] * normalAfter[1] + normalAfter[2] * normalAfter[2]);
+		// The triangle must not turn by more than ~75 degrees or collapse into a line
+		if (lengthAfter == 0.0 || dot < 0.25 * lengthBefore * lengthAfter)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+
+void MeshSimplifier::addTriangle(Quadric& quadric, const float* p0, const float* p1, const float* p2)
+{
+	double normal[3];
+	triangleNormal(p0, p1, p2, normal);
+	double length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+	if (length == 0.0)
+	{
+		return;
+	}
+
+	double a = normal[0] / length;
+	double b = normal[1] / length;
+	double c = normal[2] / length;
+	double d = -(a * p0[0] + b * p0[1] + c * p0[2]);
+	// The length of the cross product is the doubled area
+	double weight = length * 0.5;
+
+	quadric.a00 += weight * a * a;
+	quadric.a01 += weight * a * b;
+	quadric.a02 += weight * a * c;
+	quadric.a03 += weight * a * d;
+	quadric.a11 += weight * b * b;
+	quadric.a12 += weight * b * c;
+	quadric.a13 += weight * b * d;
+	quadric.a22 += weight * c * c;
+	quadric.a23 += weight * c * d;
+	quadric.a33 += weight * d * d;
+	quadric.weight += weight;
+}
+
+
+
+void MeshSimplifier::addQuadric(Quadric& quadric, const Quadric& other)
+{
+	quadric.a00 += other.a00;
+	quadric.a01 += other.a01;
+	quadric.a02 += other.a02;
+	quadric.a03 += other.a03;
+	quadric.a11 += other.a11;
+	quadric.a12 += other.a12;
+	quadric.a13 += other.a13;
+	quadric.a22 += other.a22;
+	quadric.a23 += other.a23;
+	quadric.a33 += other.a33;
+	quadric.weight += other.weight;
+}
+
+
+
+double MeshSimplifier::evaluate(const Quadric& quadric, const float* point)
+{
+	if (quadric.weight <= 0.0)
+	{
+		return 0.0;
+	}
+
+	double x = point[0];
+	double y = point[1];
+	double z = point[2];
+	double error = quadric.a00 * x * x + 2.0 * quadric.a01 * x * y + 2.0 * quadric.a02 * x * z + 2.0 * quadric.a03 * x +
+					quadric.a11 * y * y + 2.0 * quadric.a12 * y * z + 2.0 * quadric.a13 * y +
+					quadric.a22 * z * z + 2.0 * quadric.a23 * z +
+					quadric.a33;
+	return std::max(error / quadric.weight, 0.0);
+}
@@ -0,0 +1,66 @@
+// MeshSimplifier.h
+
+#ifndef MESHSIMPLIFIER_H
+#define MESHSIMPLIFIER_H
+
+#include "ThreadPool.h"
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// The class that reduces the number of triangles by the edge collapses with the quadric error metric (Garland, Heckbert 1997)
+/// The vertex is moved onto the other end of the edge, so the simplified index buffer uses the same vertex buffer
+/// The vertices on the borders of the mesh and on the seams of the attributes are not moved
+class MeshSimplifier
+{
+public:
+	explicit MeshSimplifier(ThreadPool& pool);
+
+	// 1. Function to simplify the triangles until targetIndexCount is reached or the next collapse is more than targetError
+	/// Returns the geometric error of the result in the units of the positions
+	float simplify(const std::vector<uint32_t>& indices, const char* positions, size_t positionStride, uint32_t vertexCount,
+					size_t targetIndexCount, float targetError, std::vector<uint32_t>& result);
+
+private:
+	// The symmetric 4x4 matrix of the squared distances to the planes, weighted by the area of the triangles
+	struct Quadric
+	{
+		double a00, a01, a02, a03;
+		double a11, a12, a13;
+		double a22, a23;
+		double a33;
+		double weight;
+	};
+
+	// The types of the vertices, only the interior vertices are collapsed
+	enum VertexKind : uint8_t
+	{
+		VERTEX_INTERIOR,
+		VERTEX_BORDER,
+		VERTEX_SEAM
+	};
+
+	// The collapse of the vertex "from" onto the vertex "to"
+	struct Collapse
+	{
+		float cost;
+		uint32_t from;
+		uint32_t to;
+	};
+
+	// Function to classify the vertices by the edges of the triangles which share their positions
+	void classifyVertices(const std::vector<uint32_t>& indices, const std::vector<uint32_t>& positionIds, std::vector<VertexKind>& kinds);
+	// Function to verify that no triangle around the vertex turns over when the vertex is moved
+	bool isCollapseValid(const std::vector<uint32_t>& indices, const std::vector<uint32_t>& offsets, const std::vector<uint32_t>& adjacency,
+							const char* positions, size_t positionStride, uint32_t from, uint32_t to) const;
+
+	static void addTriangle(Quadric& quadric, const float* p0, const float* p1, const float* p2);
+	static void addQuadric(Quadric& quadric, const Quadric& other);
+	// The mean squared distance from the point to the planes of the quadric
+	static double evaluate(const Quadric& quadric, const float* point);
+
+	ThreadPool& pool;
+};
+
+#endif // MESHSIMPLIFIER_H
@@ -0,0 +1,233 @@
+// MeshletBuilder.cpp
+#include "MeshletBuilder.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace
+{
+	glm::vec3 positionOf(const char* positions, size_t positionStride, uint32_t vertex)
+	{
+		const float* position = reinterpret_cast<const float*>(positions + static_cast<size_t>(vertex) * positionStride);
+		return glm::vec3(position[0], position[1], position[2]);
+	}
+}
+
+
+
+MeshletBuilder::MeshletBuilder(uint32_t vertexCount)
+{
+	vertexMeshlet.assign(vertexCount, 0);
+	meshletId = 0;
+}
+
+
+
+void MeshletBuilder::build(const uint32_t* indices, uint32_t firstIndex, uint32_t indexCount, const char* positions, size_t positionStride,
+							std::vector<Meshlet>& meshlets)
+{
+	uint32_t endIndex = firstIndex + indexCount;
+	uint32_t meshletStart = firstIndex;
+	uint32_t vertexCount = 0;
+	uint32_t triangleCount = 0;
+	++meshletId;
+
+	for (uint32_t i = firstIndex; i + 2 < endIndex; i += 3)
+	{
+		const uint32_t* triangle = &indices[i];
+		auto countNewVertices = [&]()
+		{
+			uint32_t newVertices = 0;
+			for (int corner = 0; corner < 3; ++corner)
+			{
+				bool repeated = (corner > 0 && triangle[corner] == triangle[0]) || (corner > 1 && triangle[corner] == triangle[1]);
+				if (!repeated && vertexMeshlet[triangle[corner]] != meshletId)
+				{
+					++newVertices;
+				}
+			}
+			return newVertices;
+		};
+
+		uint32_t newVertices = countNewVertices();
+		if (vertexCount + newVertices > MAX_VERTICES || triangleCount + 1 > MAX_TRIANGLES)
+		{
+			Meshlet meshlet{};
+			meshlet.firstIndex = meshletStart;
+			meshlet.indexCount = i - meshletStart;
+			computeBounds(indices + meshletStart, meshlet.indexCount, positions, positionStride, meshlet);
+			meshlets.emplace_back(meshlet);
+
+			++meshletId;
+			meshletStart = i;
+			vertexCount = 0;
+			triangleCount = 0;
+			newVertices = countNewVertices();
+		}
+
+		for (int corner = 0; corner < 3; ++corner)
+		{
+			vertexMeshlet[triangle[corner]] = meshletId;
+		}
+		vertexCount += newVertices;
+		++triangleCount;
+	}
+
+	if (triangleCount > 0)
+	{
+		Meshlet meshlet{};
+		meshlet.firstIndex = meshletStart;
+		meshlet.indexCount = endIndex - meshletStart;
+		computeBounds(indices + meshletStart, meshlet.indexCount, positions, positionStride, meshlet);
+		meshlets.emplace_back(meshlet);
+	}
+}
+
+
+
+void MeshletBuilder::extractFrustum(const glm::mat4& matrix, glm::vec4 planes[6])
+{
+	// The rows of the matrix, glm keeps the columns
+	glm::vec4 rows[4];
+	for (int row = 0; row < 4; ++row)
+	{
+		rows[row] = glm::vec4(matrix[0][row], matrix[1][row], matrix[2][row], matrix[3][row]);
+	}
+
+	// Left, right, bottom, top, near and far planes (Gribb, Hartmann), the depth of the Vulkan projection is in [0, 1], so the near plane is z >= 0
+	planes[0] = rows[3] + rows[0];
+	planes[1] = rows[3] - rows[0];
+	planes[2] = rows[3] + rows[1];
+	planes[3] = rows[3] - rows[1];
+	planes[4] = rows[2];
+	planes[5] = rows[3] - rows[2];
+
+	for (int i = 0; i < 6; ++i)
+	{
+		float length = glm::length(glm::vec3(planes[i]));
+		if (length > 0.0f)
+		{
+			planes[i] = planes[i] / length;
+		}
+	}
+}
+
+
+
+bool MeshletBuilder::isVisible(const Meshlet& meshlet, const glm::vec4 planes[6], const glm::vec3& cameraPosition)
+{
+	glm::vec3 center(meshlet.center[0], meshlet.center[1], meshlet.center[2]);
+	if (!isSphereVisible(center, meshlet.radius, planes))
+	{
+		return false;
+	}
+
+	// All triangles face away when the camera is behind the cone of the normals, the sphere makes the test conservative
+	glm::vec3 coneAxis(meshlet.coneAxis[0], meshlet.coneAxis[1], meshlet.coneAxis[2]);
+	glm::vec3 direction = center - cameraPosition;
+	if (glm::dot(direction, coneAxis) >= meshlet.coneCutoff * glm::length(direction) + meshlet.radius)
+	{
+		return false;
+	}
+	return true;
+}
+
+
+
+bool MeshletBuilder::isSphereVisible(const glm::vec3& center, float radius, const glm::vec4 planes[6])
+{
+	for (int i = 0; i < 6; ++i)
+	{
+		if (glm::dot(glm::vec3(planes[i]), center) + planes[i].w < -radius)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+
+void MeshletBuilder::computeBounds(const uint32_t* indices, uint32_t indexCount, const char* positions, size_t positionStride, Meshlet& meshlet)
+{
+	// The bounding sphere by Ritter: the sphere on the two distant points is grown to include the rest
+	glm::vec3 first = positionOf(positions, positionStride, indices[0]);
+	glm::vec3 farthest = first;
+	float farthestDistance = 0.0f;
+	for (uint32_t i = 0; i < indexCount; ++i)
+	{
+		glm::vec3 point = positionOf(positions, positionStride, indices[i]);
+		float distance = glm::length(point - first);
+		if (distance > farthestDistance)
+		{
+			farthestDistance = distance;
+			farthest = point;
+		}
+	}
+
+	glm::vec3 opposite = farthest;
+	farthestDistance = 0.0f;
+	for (uint32_t i = 0; i < indexCount; ++i)
+	{
+		glm::vec3 point = positionOf(positions, positionStride, indices[i]);
+		float distance = glm::length(point - farthest);
+		if (distance > farthestDistance)
+		{
+			farthestDistance = distance;
+			opposite = point;
+		}
+	}
+
+	glm::vec3 center = (farthest + opposite) * 0.5f;
+	float radius = farthestDistance * 0.5f;
+	for (uint32_t i = 0; i < indexCount; ++i)
+	{
+		glm::vec3 point = positionOf(positions, positionStride, indices[i]);
+		float distance = glm::length(point - center);
+		if (distance > radius)
+		{
+			float newRadius = (radius + distance) * 0.5f;
+			center = center + (point - center) * ((newRadius - radius) / distance);
+			radius = newRadius;
+		}
+	}
+
+	// The cone of the normals: the axis is the average normal, the angle covers the most deviating triangle
+	std::vector<glm::vec3> normals;
+	normals.reserve(indexCount / 3);
+	glm::vec3 axis(0.0f);
+	for (uint32_t i = 0; i + 2 < indexCount; i += 3)
+	{
+		glm::vec3 p0 = positionOf(positions, positionStride, indices[i + 0]);
+		glm::vec3 p1 = positionOf(positions, positionStride, indices[i + 1]);
+		glm::vec3 p2 = positionOf(positions, positionStride, indices[i + 2]);
+		glm::vec3 normal = glm::cross(p1 - p0, p2 - p0);
+		float length = glm::length(normal);
+		if (length > 0.0f)
+		{
+			normals.emplace_back(normal / length);
+			axis = axis + normal / length;
+		}
+	}
+
+	float axisLength = glm::length(axis);
+	float minDot = 1.0f;
+	if (axisLength > 0.0f)
+	{
+		axis = axis / axisLength;
+		for (const auto& normal : normals)
+		{
+			minDot = std::min(minDot, glm::dot(axis, normal));
+		}
+	}
+
+	meshlet.center[0] = center.x;
+	meshlet.center[1] = center.y;
+	meshlet.center[2] = center.z;
+	meshlet.radius = radius;
+	meshlet.coneAxis[0] = axis.x;
+	meshlet.coneAxis[1] = axis.y;
+	meshlet.coneAxis[2] = axis.z;
+	// The cone wider than the half space can't be culled
+	meshlet.coneCutoff = (axisLength > 0.0f && minDot > 0.0f) ? std::sqrt(1.0f - minDot * minDot) : 1.0f;
+}
@@ -0,0 +1,58 @@
+// MeshletBuilder.h
+
+#ifndef MESHLETBUILDER_H
+#define MESHLETBUILDER_H
+
+#include <glm.hpp>
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// The small cluster of triangles, it's a range of the index buffer with the bounds for the culling
+struct Meshlet
+{
+	uint32_t firstIndex;
+	uint32_t indexCount;
+	// Bounding sphere in the space of the model
+	float center[3];
+	float radius;
+	// The cone of the triangle normals, the cutoff is the sine of the cone angle or 1 if the cone can't be culled
+	float coneAxis[3];
+	float coneCutoff;
+};
+
+// The class that splits the index ranges into meshlets and culls them on the CPU before the draw calls
+/// The triangles keep the order of the vertex cache optimization, the meshlet is closed when it reaches the vertex or the triangle limit
+class MeshletBuilder
+{
+public:
+	// The limits that fit the mesh shaders of the most GPUs
+	static const uint32_t MAX_VERTICES = 64;
+	static const uint32_t MAX_TRIANGLES = 124;
+
+	explicit MeshletBuilder(uint32_t vertexCount);
+
+	// 1. Function to split the indices [firstIndex, firstIndex + indexCount) into meshlets, they are appended to the array
+	void build(const uint32_t* indices, uint32_t firstIndex, uint32_t indexCount, const char* positions, size_t positionStride,
+				std::vector<Meshlet>& meshlets);
+
+	// 2. Function to get the planes of the view frustum from the matrix projection * view * model
+	/// The planes are normalized and point inside, so the space of the planes is the space of the model
+	static void extractFrustum(const glm::mat4& matrix, glm::vec4 planes[6]);
+
+	// 3. Function to check that the meshlet is in the frustum and has at least one triangle facing the camera
+	static bool isVisible(const Meshlet& meshlet, const glm::vec4 planes[6], const glm::vec3& cameraPosition);
+	// 4. Function to check that the sphere is at least partly in the frustum
+	static bool isSphereVisible(const glm::vec3& center, float radius, const glm::vec4 planes[6]);
+
+private:
+	// Function to calculate the bounding sphere and the normal cone of the triangles
+	void computeBounds(const uint32_t* indices, uint32_t indexCount, const char* positions, size_t positionStride, Meshlet& meshlet);
+
+	// The meshlet that uses the vertex, it's used to count the unique vertices of the current meshlet
+	std::vector<uint32_t> vertexMeshlet;
+	uint32_t meshletId;
+};
+
+#endif // MESHLETBUILDER_H
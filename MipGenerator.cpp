@@ -0,0 +1,186 @@
+// MipGenerator.cpp
+#include "MipGenerator.h"
+
+#include <algorithm>
+#include <cmath>
+
+#if defined(_M_X64) || defined(_M_AMD64) || defined(__SSE2__)
+#include <emmintrin.h>
+#define MIP_GENERATOR_SSE2
+#endif
+
+namespace
+{
+	// The number of rows of one task, smaller tasks don't pay off their cost
+	const size_t ROWS_PER_TASK = 16;
+	// The size of the table of the linear to sRGB conversion, 12 bits keep the error of the dark colors below one step
+	const uint32_t LINEAR_TABLE_SIZE = 4096;
+
+	// The tables of the sRGB transfer function, they are built on the first use
+	struct SrgbTables
+	{
+		float toLinear[256];
+		uint8_t fromLinear[LINEAR_TABLE_SIZE];
+
+		SrgbTables()
+		{
+			for (uint32_t i = 0; i < 256; ++i)
+			{
+				float c = i / 255.0f;
+				toLinear[i] = (c <= 0.04045f) ? c / 12.92f : std::pow((c + 0.055f) / 1.055f, 2.4f);
+			}
+			for (uint32_t i = 0; i < LINEAR_TABLE_SIZE; ++i)
+			{
+				float l = i / static_cast<float>(LINEAR_TABLE_SIZE - 1);
+				float c = (l <= 0.0031308f) ? l * 12.92f : 1.055f * std::pow(l, 1.0f / 2.4f) - 0.055f;
+				fromLinear[i] = static_cast<uint8_t>(std::clamp(c * 255.0f + 0.5f, 0.0f, 255.0f));
+			}
+		}
+	};
+
+	const SrgbTables& srgbTables()
+	{
+		static const SrgbTables tables;
+		return tables;
+	}
+
+	// Function to run body(first, end) over the rows in the blocks of ROWS_PER_TASK
+	void forEachRowBlock(ThreadPool& pool, uint32_t rowCount, const std::function<void(uint32_t, uint32_t)>& body)
+	{
+		size_t blockCount = (rowCount + ROWS_PER_TASK - 1) / ROWS_PER_TASK;
+		pool.parallelFor(blockCount, [&](size_t block)
+		{
+			uint32_t first = static_cast<uint32_t>(block * ROWS_PER_TASK);
+			uint32_t end = std::min(rowCount, static_cast<uint32_t>(first + ROWS_PER_TASK));
+			body(first, end);
+		});
+	}
+}
+
+MipGenerator::MipGenerator(ThreadPool& pool) : pool(pool)
+{
+}
+
+
+
+uint32_t MipGenerator::levelCount(uint32_t width, uint32_t height)
+{
+	uint32_t levels = 1;
+	for (uint32_t size = std::max(width, height); size > 1; size >>= 1)
+	{
+		++levels;
+	}
+	return levels;
+}
+
+
+
+void MipGenerator::generate(const unsigned char* pixels, uint32_t width, uint32_t height, bool srgb,
+							std::vector<unsigned char>& chain, std::vector<MipLevel>& levels)
+{
+	chain.assign(pixels, pixels + static_cast<size_t>(width) * height * 4);
+	generateInPlace(chain, width, height, srgb, levels);
+}
+
+
+
+void MipGenerator::generateInPlace(std::vector<unsigned char>& chain, uint32_t width, uint32_t height, bool srgb, std::vector<MipLevel>& levels)
+{
+	// The offsets of the levels, the RGBA8 texel keeps them aligned to 4 bytes for vkCmdCopyBufferToImage
+	levels.clear();
+	uint64_t chainSize = 0;
+	uint32_t count = levelCount(width, height);
+	for (uint32_t w = width, h = height, i = 0; i < count; ++i)
+	{
+		levels.push_back(MipLevel{ chainSize, w, h });
+		chainSize += static_cast<uint64_t>(w) * h * 4;
+		w = std::max(w / 2, 1u);
+		h = std::max(h / 2, 1u);
+	}
+	// The resize keeps the first level at the start of the chain
+	chain.resize(static_cast<size_t>(chainSize));
+
+	// The previous level stays in floats, so each level is filtered from the exact values
+	std::vector<float> previous(static_cast<size_t>(width) * height * 4);
+	std::vector<float> current;
+	decode(chain.data(), static_cast<size_t>(width) * height, srgb, previous.data());
+
+	for (size_t i = 1; i < levels.size(); ++i)
+	{
+		const MipLevel& source = levels[i - 1];
+		const MipLevel& level = levels[i];
+		current.resize(static_cast<size_t>(level.width) * level.height * 4);
+
+		downsample(previous.data(), source.width, source.height, current.data(), level.width, level.height);
+		encode(current.data(), static_cast<size_t>(level.width) * level.height, srgb, chain.data() + level.offset);
+		previous.swap(current);
+	}
+}
+
+
+
+void MipGenerator::downsample(const float* source, uint32_t sourceWidth, uint32_t sourceHeight, float* destination, uint32_t width, uint32_t height)
+{
+	forEachRowBlock(pool, height, [&](uint32_t firstRow, uint32_t endRow)
+	{
+		for (uint32_t y = firstRow; y < endRow; ++y)
+		{
+			// The second row and column are clamped to the edge when the source side is odd or 1
+			const float* row0 = source + static_cast<size_t>(std::min(2 * y, sourceHeight - 1)) * sourceWidth * 4;
+			const float* row1 = source + static_cast<size_t>(std::min(2 * y + 1, sourceHeight - 1)) * sourceWidth * 4;
+			float* output = destination + static_cast<size_t>(y) * width * 4;
+
+			for (uint32_t x = 0; x < width; ++x)
+			{
+				size_t x0 = static_cast<size_t>(std::min(2 * x, sourceWidth - 1)) * 4;
+				size_t x1 = static_cast<size_t>(std::min(2 * x + 1, sourceWidth - 1)) * 4;
+#ifdef MIP_GENERATOR_SSE2
+				// The four channels of the texel are one SSE register
+				__m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(row0 + x0), _mm_loadu_ps(row0 + x1)),
+										_mm_add_ps(_mm_loadu_ps(row1 + x0), _mm_loadu_ps(row1 + x1)));
+				_mm_storeu_ps(output + 4 * x, _mm_mul_ps(sum, _mm_set1_ps(0.25f)));
+#else
+				for (int c = 0; c < 4; ++c)
+				{
+					output[4 * x + c] = (row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c]) * 0.25f;
+				}
+#endif
+			}
+		}
+	});
+}
+
+
+
+void MipGenerator::decode(const unsigned char* pixels, size_t pixelCount, bool srgb, float* result)
+{
+	const SrgbTables& tables = srgbTables();
+	for (size_t i = 0; i < pixelCount; ++i)
+	{
+		const unsigned char* texel = pixels + 4 * i;
+		for (int c = 0; c < 3; ++c)
+		{
+			result[4 * i + c] = srgb ? tables.toLinear[texel[c]] : texel[c] / 255.0f;
+		}
+		// The alpha is linear in both formats
+		result[4 * i + 3] = texel[3] / 255.0f;
+	}
+}
+
+
+
+void MipGenerator::encode(const float* linear, size_t pixelCount, bool srgb, unsigned char* result)
+{
+	const SrgbTables& tables = srgbTables();
+	for (size_t i = 0; i < pixelCount; ++i)
+	{
+		const float* texel = linear + 4 * i;
+		for (int c = 0; c < 3; ++c)
+		{
+			result[4 * i + c] = srgb ?
+				tables.fromLinear[static_cast<uint32_t>(std::clamp(texel[c], 0.0f, 1.0f) * (LINEAR_TABLE_SIZE - 1) + 0.5f)] :
+				static_cast<unsigned char>(std::clamp(texel[c], 0.0f, 1.0f) * 255.0f + 0.5f);
+		}
+		result[4 * i + 3] = static_cast<unsigned char>(std::clamp(texel[3], 0.0f, 1.0f) * 255.0f + 0.5f);
+	}
+}
@@ -0,0 +1,46 @@
+// MipGenerator.h
+
+#ifndef MIPGENERATOR_H
+#define MIPGENERATOR_H
+
+#include "ThreadPool.h"
+
+#include <vector>
+#include <cstdint>
+
+// The level of the mip chain in the buffer of all levels
+struct MipLevel
+{
+	uint64_t offset;
+	uint32_t width;
+	uint32_t height;
+};
+
+// The class that builds the mip chain of the RGBA8 image on the CPU, it's used when the GPU can't blit the format with the linear filter
+/// Each level is the 2x2 box filter of the previous one, the odd edge repeats the last texel
+/// The levels are filtered in linear floats, so the sRGB colors are averaged in the linear space and aren't rounded on each level
+class MipGenerator
+{
+public:
+	explicit MipGenerator(ThreadPool& pool);
+
+	// 1. Function to get the number of levels down to 1x1
+	static uint32_t levelCount(uint32_t width, uint32_t height);
+	// 2. Function to write all levels one after another to the chain, the first level is the copy of the pixels
+	void generate(const unsigned char* pixels, uint32_t width, uint32_t height, bool srgb,
+					std::vector<unsigned char>& chain, std::vector<MipLevel>& levels);
+	// 3. Function to add the levels after the first one that is already in the chain, so the image can be decoded straight into it
+	void generateInPlace(std::vector<unsigned char>& chain, uint32_t width, uint32_t height, bool srgb, std::vector<MipLevel>& levels);
+
+private:
+	// Function to halve the linear image, the rows of the destination are filtered in parallel
+	void downsample(const float* source, uint32_t sourceWidth, uint32_t sourceHeight, float* destination, uint32_t width, uint32_t height);
+	// Function to convert the RGBA8 pixels to the linear floats
+	void decode(const unsigned char* pixels, size_t pixelCount, bool srgb, float* result);
+	// Function to convert the linear floats back to RGBA8
+	void encode(const float* linear, size_t pixelCount, bool srgb, unsigned char* result);
+
+	ThreadPool& pool;
+};
+
+#endif // MIPGENERATOR_H
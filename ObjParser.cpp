@@ -0,0 +1,443 @@
+// ObjParser.cpp
+#include "ObjParser.h"
+
+#include <fstream>
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <cstring>
+
+namespace
+{
+	// The encoding of the face indices inside the chunk
+	/// absolute index: the zero based index >= 0
+	/// relative index: (position from the chunk start) - RELATIVE_INDEX_BIAS, resolved after the chunk bases are known
+	/// missing index: MISSING_INDEX
+	const int64_t MISSING_INDEX = std::numeric_limits<int64_t>::min();
+	const int64_t RELATIVE_INDEX_BIAS = int64_t(1) << 32;
+
+	// The minimal size of one chunk, smaller chunks don't pay off the cost of the task
+	const size_t MIN_CHUNK_SIZE = 256 * 1024;
+	// The number of chunks for each thread, it smooths out the different density of the faces in the file
+	const size_t CHUNKS_PER_THREAD = 4;
+
+	bool isSpace(char c)
+	{
+		return c == ' ' || c == '\t';
+	}
+
+	const char* skipSpaces(const char* p, const char* end)
+	{
+		while (p < end && isSpace(*p))
+		{
+			++p;
+		}
+		return p;
+	}
+
+	const char* skipLine(const char* p, const char* end)
+	{
+		const char* lineEnd = static_cast<const char*>(memchr(p, '\n', static_cast<size_t>(end - p)));
+		return lineEnd ? lineEnd + 1 : end;
+	}
+
+	bool isLineEnd(const char* p, const char* end)
+	{
+		return p >= end || *p == '\n' || *p == '\r' || *p == '#';
+	}
+
+	const char* parseInt(const char* p, const char* end, int64_t& value)
+	{
+		bool negative = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negative = *p == '-';
+			++p;
+		}
+
+		const char* digits = p;
+		int64_t result = 0;
+		while (p < end && *p >= '0' && *p <= '9')
+		{
+			result = result * 10 + (*p - '0');
+			++p;
+		}
+		if (p == digits)
+		{
+			throw std::runtime_error("ERROR::ObjParser::parseInt()::Expected an index in the face record");
+		}
+
+		value = negative ? -result : result;
+		return p;
+	}
+}
+
+
+
+ObjParser::ObjParser(ThreadPool& pool) : pool(pool)
+{
+}
+
+
+
+void ObjParser::parse(const std::string& fileName, tinyobj::attrib_t& attrib, std::vector<tinyobj::index_t>& indices)
+{
+	std::ifstream file(fileName, std::ios::ate | std::ios::binary);
+	if (!file.is_open())
+	{
+		throw std::runtime_error("ERROR::ObjParser::parse()::Failed to open file " + fileName);
+	}
+
+	size_t fileSize = static_cast<size_t>(file.tellg());
+	std::vector<char> buffer(fileSize);
+
+	file.seekg(0);
+	file.read(buffer.data(), static_cast<std::streamsize>(fileSize));
+	file.close();
+
+	parse(buffer.data(), buffer.size(), attrib, indices);
+}
+
+
+
+void ObjParser::parse(const char* text, size_t size, tinyobj::attrib_t& attrib, std::vector<tinyobj::index_t>& indices)
+{
+	const char* end = text + size;
+
+	// Splitting the text into chunks that start at the beginning of a line
+	size_t chunkCount = std::max<size_t>(1, std::min<size_t>((pool.size() + 1) * CHUNKS_PER_THREAD, size / MIN_CHUNK_SIZE));
+	std::vector<Chunk> chunks;
+	chunks.reserve(chunkCount);
+
+	const char* chunkBegin = text;
+	for (size_t i = 1; i <= chunkCount && chunkBegin < end; ++i)
+	{
+		const char* chunkEnd = (i == chunkCount) ? end : skipLine(std::max(chunkBegin, text + size / chunkCount * i), end);
+
+		Chunk chunk{};
+		chunk.begin = chunkBegin;
+		chunk.end = chunkEnd;
+		chunks.emplace_back(std::move(chunk));
+
+		chunkBegin = chunkEnd;
+	}
+
+	// Parsing the records of all chunks in parallel
+	pool.parallelFor(chunks.size(), [&chunks](size_t i) { parseChunk(chunks[i]); });
+
+	// Calculating the position of each chunk in the merged arrays
+	size_t vertexCount = 0, normalCount = 0, texcoordCount = 0, cornerCount = 0;
+	bool hasColors = false;
+	for (auto& chunk : chunks)
+	{
+		hasColors = hasColors || !chunk.colors.empty();
+		chunk.vertexBase = vertexCount;
+		chunk.normalBase = normalCount;
+		chunk.texcoordBase = texcoordCount;
+		chunk.cornerBase = cornerCount;
+
+		vertexCount += chunk.vertices.size() / 3;
+		normalCount += chunk.normals.size() / 3;
+		texcoordCount += chunk.texcoords.size() / 2;
+		cornerCount += chunk.corners.size() / 3;
+	}
+
+	attrib.vertices.resize(vertexCount * 3);
+	attrib.normals.resize(normalCount * 3);
+	attrib.texcoords.resize(texcoordCount * 2);
+	// The vertices without the color are white like in tinyobj
+	attrib.colors.assign(hasColors ? vertexCount * 3 : 0, 1.0f);
+	indices.resize(cornerCount);
+
+	// Merging the chunks, each chunk writes its own range of the arrays
+	pool.parallelFor(chunks.size(), [&](size_t i)
+	{
+		const Chunk& chunk = chunks[i];
+		std::copy(chunk.vertices.begin(), chunk.vertices.end(), attrib.vertices.begin() + chunk.vertexBase * 3);
+		std::copy(chunk.normals.begin(), chunk.normals.end(), attrib.normals.begin() + chunk.normalBase * 3);
+		std::copy(chunk.texcoords.begin(), chunk.texcoords.end(), attrib.texcoords.begin() + chunk.texcoordBase * 2);
+		std::copy(chunk.colors.begin(), chunk.colors.end(), attrib.colors.begin() + chunk.vertexBase * 3);
+
+		for (size_t c = 0; c < chunk.corners.size() / 3; ++c)
+		{
+			tinyobj::index_t& index = indices[chunk.cornerBase + c];
+			index.vertex_index = resolveIndex(chunk.corners[c * 3 + 0], chunk.vertexBase, vertexCount);
+			index.texcoord_index = resolveIndex(chunk.corners[c * 3 + 1], chunk.texcoordBase, texcoordCount);
+			index.normal_index = resolveIndex(chunk.corners[c * 3 + 2], chunk.normalBase, normalCount);
+		}
+	});
+}
+
+
+
+const char* ObjParser::parseFloat(const char* begin, const char* end, float& value)
+{
+	// Powers of ten that are exactly represented by the double
+	static const double POWERS_OF_TEN[] = { 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+											1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22 };
+
+	const char* p = begin;
+	bool negative = false;
+	if (p < end && (*p == '-' || *p == '+'))
+	{
+		negative = *p == '-';
+		++p;
+	}
+
+	// Collecting up to 19 significant digits in the integer, the rest only moves the decimal point
+	uint64_t mantissa = 0;
+	int exponent = 0;
+	int digitCount = 0;
+	bool hasDigits = false;
+
+	while (p < end && *p >= '0' && *p <= '9')
+	{
+		if (digitCount < 19)
+		{
+			mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+			if (mantissa != 0)
+			{
+				++digitCount;
+			}
+		}
+		else
+		{
+			++exponent;
+		}
+		hasDigits = true;
+		++p;
+	}
+
+	if (p < end && *p == '.')
+	{
+		++p;
+		while (p < end && *p >= '0' && *p <= '9')
+		{
+			if (digitCount < 19)
+			{
+				mantissa = mantissa * 10 + static_cast<uint64_t>(*p - '0');
+				if (mantissa != 0)
+				{
+					++digitCount;
+				}
+				--exponent;
+			}
+			hasDigits = true;
+			++p;
+		}
+	}
+
+	if (!hasDigits)
+	{
+		throw std::runtime_error("ERROR::ObjParser::parseFloat()::Expected a number");
+	}
+
+	if (p < end && (*p == 'e' || *p == 'E'))
+	{
+		const char* exponentStart = p;
+		++p;
+		bool negativeExponent = false;
+		if (p < end && (*p == '-' || *p == '+'))
+		{
+			negativeExponent = *p == '-';
+			++p;
+		}
+
+		if (p < end && *p >= '0' && *p <= '9')
+		{
+			int explicitExponent = 0;
+			while (p < end && *p >= '0' && *p <= '9')
+			{
+				if (explicitExponent < 10000)
+				{
+					explicitExponent = explicitExponent * 10 + (*p - '0');
+				}
+				++p;
+			}
+			exponent += negativeExponent ? -explicitExponent : explicitExponent;
+		}
+		else
+		{
+			// The 'e' without digits isn't the part of the number
+			p = exponentStart;
+		}
+	}
+
+	double result = static_cast<double>(mantissa);
+	if (exponent < 0)
+	{
+		result = (-exponent <= 22) ? result / POWERS_OF_TEN[-exponent] : result * std::pow(10.0, exponent);
+	}
+	else if (exponent > 0)
+	{
+		result = (exponent <= 22) ? result * POWERS_OF_TEN[exponent] : result * std::pow(10.0, exponent);
+	}
+
+	value = static_cast<float>(negative ? -result : result);
+	return p;
+}
+
+
+
+void ObjParser::parseChunk(Chunk& chunk)
+{
+	// The approximate number of records for the first allocation, about 32 bytes per line
+	size_t expectedLines = static_cast<size_t>(chunk.end - chunk.begin) / 32;
+	chunk.vertices.reserve(expectedLines * 3 / 2);
+	chunk.corners.reserve(expectedLines * 3);
+
+	// Corners of the current polygon before the triangulation
+	std::vector<int64_t> polygon;
+
+	const char* p = chunk.begin;
+	while (p < chunk.end)
+	{
+		p = skipSpaces(p, chunk.end);
+		if (p + 1 >= chunk.end)
+		{
+			break;
+		}
+
+		if (p[0] == 'v' && isSpace(p[1]))
+		{
+			float values[6];
+			p = parseFloats(p + 2, chunk.end, values, 3);
+
+			// Three more values are the color, one value is the w component
+			int extraCount = 0;
+			while (extraCount < 3 && !isLineEnd(skipSpaces(p, chunk.end), chunk.end))
+			{
+				p = parseFloat(skipSpaces(p, chunk.end), chunk.end, values[3 + extraCount]);
+				++extraCount;
+			}
+
+			if (extraCount == 3 && chunk.colors.empty())
+			{
+				chunk.colors.assign(chunk.vertices.size(), 1.0f);
+			}
+			if (!chunk.colors.empty())
+			{
+				const float white[3] = { 1.0f, 1.0f, 1.0f };
+				const float* color = (extraCount == 3) ? values + 3 : white;
+				chunk.colors.insert(chunk.colors.end(), color, color + 3);
+			}
+			chunk.vertices.insert(chunk.vertices.end(), values, values + 3);
+		}
+		else if (p[0] == 'v' && p[1] == 't' && p + 2 < chunk.end && isSpace(p[2]))
+		{
+			float values[2];
+			p = parseFloats(p + 3, chunk.end, values, 2);
+			chunk.texcoords.insert(chunk.texcoords.end(), values, values + 2);
+		}
+		else if (p[0] == 'v' && p[1] == 'n' && p + 2 < chunk.end && isSpace(p[2]))
+		{
+			float values[3];
+			p = parseFloats(p + 3, chunk.end, values, 3);
+			chunk.normals.insert(chunk.normals.end(), values, values + 3);
+		}
+		else if (p[0] == 'f' && isSpace(p[1]))
+		{
+			polygon.clear();
+			p = skipSpaces(p + 2, chunk.end);
+			while (!isLineEnd(p, chunk.end))
+			{
+				int64_t corner[3];
+				p = parseCorner(p, chunk.end, chunk, corner);
+				polygon.insert(polygon.end(), corner, corner + 3);
+				p = skipSpaces(p, chunk.end);
+			}
+
+			// Triangulating the polygon as a fan around the first corner
+			size_t cornerCount = polygon.size() / 3;
+			for (size_t i = 1; i + 1 < cornerCount; ++i)
+			{
+				chunk.corners.insert(chunk.corners.end(), polygon.begin(), polygon.begin() + 3);
+				chunk.corners.insert(chunk.corners.end(), polygon.begin() + i * 3, polygon.begin() + i * 3 + 6);
+			}
+		}
+
+		// The rest of the record (names, comments) is skipped
+		p = skipLine(p, chunk.end);
+	}
+}
+
+
+
+const char* ObjParser::parseFloats(const char* p, const char* end, float* values, int count)
+{
+	for (int i = 0; i < count; ++i)
+	{
+		p = skipSpaces(p, end);
+		// The optional components (vt with one value) are filled with 0
+		if (isLineEnd(p, end) && i > 0)
+		{
+			values[i] = 0.0f;
+			continue;
+		}
+		p = parseFloat(p, end, values[i]);
+	}
+	return p;
+}
+
+
+
+const char* ObjParser::parseCorner(const char* p, const char* end, const Chunk& chunk, int64_t corner[3])
+{
+	// The number of records parsed in this chunk, the relative indices count back from them
+	const int64_t localCounts[3] = { static_cast<int64_t>(chunk.vertices.size() / 3),
+										static_cast<int64_t>(chunk.texcoords.size() / 2),
+										static_cast<int64_t>(chunk.normals.size() / 3) };
+
+	for (int i = 0; i < 3; ++i)
+	{
+		corner[i] = MISSING_INDEX;
+
+		if (i > 0)
+		{
+			if (p >= end || *p != '/')
+			{
+				continue;
+			}
+			++p;
+			// The texcoord index is empty in the "v//vn" form
+			if (p < end && *p == '/')
+			{
+				continue;
+			}
+		}
+
+		int64_t value;
+		p = parseInt(p, end, value);
+		if (value > 0)
+		{
+			corner[i] = value - 1;
+		}
+		else if (value < 0)
+		{
+			corner[i] = localCounts[i] + value - RELATIVE_INDEX_BIAS;
+		}
+		else
+		{
+			throw std::runtime_error("ERROR::ObjParser::parseCorner()::Index 0 is not allowed in the face record");
+		}
+	}
+	return p;
+}
+
+
+
+int ObjParser::resolveIndex(int64_t encoded, size_t base, size_t count)
+{
+	if (encoded == MISSING_INDEX)
+	{
+		return -1;
+	}
+
+	int64_t index = (encoded >= 0) ? encoded : static_cast<int64_t>(base) + encoded + RELATIVE_INDEX_BIAS;
+	if (index < 0 || index >= static_cast<int64_t>(count))
+	{
+		throw std::runtime_error("ERROR::ObjParser::resolveIndex()::Face index is out of range");
+	}
+	return static_cast<int>(index);
+}
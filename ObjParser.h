@@ -0,0 +1,66 @@
+// ObjParser.h
+
+#ifndef OBJPARSER_H
+#define OBJPARSER_H
+
+#include "ThreadPool.h"
+
+#include <tiny_obj_loader.h>
+
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// The parser of Wavefront OBJ files that splits the file into line-aligned chunks and parses them in parallel
+/// Only the geometry records v/vt/vn/f are read, the polygons are triangulated as a fan
+/// The vertex colors "v x y z r g b" go to attrib.colors, it stays empty when the file has no colors
+class ObjParser
+{
+public:
+	explicit ObjParser(ThreadPool& pool);
+
+	// 1. Function to parse the file into the same arrays which tinyobj::LoadObj fills
+	/// The indices of all shapes are placed in one array, the missing texcoord or normal index is -1
+	void parse(const std::string& fileName, tinyobj::attrib_t& attrib, std::vector<tinyobj::index_t>& indices);
+	// 2. Function to parse the text that is already in memory
+	void parse(const char* text, size_t size, tinyobj::attrib_t& attrib, std::vector<tinyobj::index_t>& indices);
+
+	// 3. Function to read a float number, returns the pointer to the first character after the number
+	/// It's faster than strtof because it doesn't depend on the locale and on the null terminated string
+	static const char* parseFloat(const char* begin, const char* end, float& value);
+
+private:
+	// The result of parsing one chunk of the file
+	struct Chunk
+	{
+		const char* begin;
+		const char* end;
+
+		std::vector<float> vertices;
+		std::vector<float> normals;
+		std::vector<float> texcoords;
+		// Empty until the first vertex with the color, then it has the color of each vertex of the chunk
+		std::vector<float> colors;
+		// Three encoded indices (vertex, texcoord, normal) for each corner of the triangles
+		std::vector<int64_t> corners;
+
+		// Position of the chunk data in the merged arrays
+		size_t vertexBase;
+		size_t normalBase;
+		size_t texcoordBase;
+		size_t cornerBase;
+	};
+
+	// Function to parse the records of one chunk
+	static void parseChunk(Chunk& chunk);
+	// Function to parse the vertex record of N floats
+	static const char* parseFloats(const char* p, const char* end, float* values, int count);
+	// Function to parse one corner of the face "v", "v/vt", "v//vn" or "v/vt/vn"
+	static const char* parseCorner(const char* p, const char* end, const Chunk& chunk, int64_t corner[3]);
+	// Function to turn the encoded index of the chunk into the index of the merged array
+	static int resolveIndex(int64_t encoded, size_t base, size_t count);
+
+	ThreadPool& pool;
+};
+
+#endif // OBJPARSER_H
@@ -18,12 +18,20 @@ VkResult createDebugUtilsMessengerEXT(VkInstance instance,
 
 
 
-Screen::Screen()
+Screen::Screen(bool serialStartup, uint32_t framesInFlight) : assetLoader(threadPool)
 {
+	this->serialStartup = serialStartup;
+	if (framesInFlight == 0 || framesInFlight > MAX_FRAMES_IN_FLIGHT)
+	{
+		throw std::runtime_error("ERROR::Screen::Screen()::The number of the frames in flight must be from 1 to " + std::to_string(MAX_FRAMES_IN_FLIGHT));
+	}
+	this->framesInFlight = framesInFlight;
 	// Initialization of SDL2 library
 	initSDL();
 	// Set SDL_Window with Vulkan API support
 	set_window(1280, 1024);
+	// The budget of the texture streaming is set before the textures are loaded
+	textureStreamer.configure(TEXTURE_STREAMING_BUDGET, TEXTURE_STREAMING_UPLOAD_SIZE, TEXTURE_STREAMING_TAIL_SIZE);
 	// Initialization of Vulkan library
 	initVulkanLib();
 	currentFrame = 0;
@@ -64,54 +72,106 @@ void Screen::set_window(int width, int height)
 
 void Screen::initVulkanLib()
 {
+	// The stages that use the window, the instance or the queues of the device stay on the calling thread (the last argument)
+	/// The others start on the thread pool as soon as the stages they depend on are finished
+	TaskGraph& graph = startupGraph;
+	graph.clear();
 	// Creation the Vulkan instance that initialize the library
-	createInstance();
+	uint32_t instanceStage = graph.add("createInstance", [this]() { createInstance(); }, {}, true);
 	// Creation the Debug messenger to catch Vulkan's mistakes, the interface is provided by Vulkan SDK
-	setupDebugMessenger();
+	uint32_t debugMessengerStage = graph.add("setupDebugMessenger", [this]() { setupDebugMessenger(); }, { instanceStage }, true);
 	// Creation the surface to use it for prerender operations
-	createSurface();
+	uint32_t surfaceStage = graph.add("createSurface", [this]() { createSurface(); }, { instanceStage }, true);
 	// Picking a physical device that will be used for calculation of graphic
-	pickPhysicalDevise();
+	uint32_t physicalDeviceStage = graph.add("pickPhysicalDevise", [this]() { pickPhysicalDevise(); }, { debugMessengerStage, surfaceStage }, true);
+	// Starting the loading of the assets, they are read on the worker threads while the rest of Vulkan is created
+	graph.add("startAssetLoading", [this]() { startAssetLoading(); }, { physicalDeviceStage }, true);
 	// Create a Vulkan logical device that 
-	createLogicalDevice();
+	uint32_t logicalDeviceStage = graph.add("createLogicalDevice", [this]() { createLogicalDevice(); }, { physicalDeviceStage }, true);
 	// Creation the Swap Chain
-	createSwapChain();
+	uint32_t swapChainStage = graph.add("createSwapChain", [this]() { createSwapChain(); }, { logicalDeviceStage }, true);
 	// Creation the ImageViews
-	createImageViews();
+	uint32_t imageViewsStage = graph.add("createImageViews", [this]() { createImageViews(); }, { swapChainStage });
 	// Creation the Render Pass
-	createRenderPass();
+	uint32_t renderPassStage = graph.add("createRenderPass", [this]() { createRenderPass(); }, { swapChainStage });
 	// Creation of the Descriptors
-	createDescriptorSetLayout();
-	// Creation the Vulkan Graphics Pipeline
-	createGraphicsPipeline();
+	uint32_t descriptorSetLayoutStage = graph.add("createDescriptorSetLayout", [this]() { createDescriptorSetLayout(); }, { logicalDeviceStage });
+	// Filling the scene with the placeholders, the 3D models replace them when they are loaded
+	uint32_t sceneStage = graph.add("loadScene", [this]() { loadScene(); }, { physicalDeviceStage });
+	// Creation the Vulkan Graphics Pipeline, the shader files are read and the pipelines are compiled while the buffers and the textures are created
+	uint32_t graphicsPipelineStage = graph.add("createGraphicsPipeline", [this]() { createGraphicsPipeline(); }, { renderPassStage, descriptorSetLayoutStage });
 	// Creation the Command Pool
-	createCommandPool();
+	uint32_t commandPoolStage = graph.add("createCommandPool", [this]() { createCommandPool(); }, { logicalDeviceStage });
+	// Creation of the persistently mapped staging memory of all uploads
+	uint32_t stagingRingStage = graph.add("createStagingRing", [this]() { createStagingRing(); }, { logicalDeviceStage });
 	// Creation of the Depth resources
-	createDepthResources();
+	uint32_t depthResourcesStage = graph.add("createDepthResources", [this]() { createDepthResources(); }, { swapChainStage });
 	// Creation the Framebuffers
-	createFramebuffers();
-	// Creation of the Texture Image
-	createTextureImage();
-	// Creation of the Texture Image View
-	createTextureImageView();
+	uint32_t framebuffersStage = graph.add("createFramebuffers", [this]() { createFramebuffers(); }, { imageViewsStage, renderPassStage, depthResourcesStage });
 	// Creation of the Texture Sampler
-	createTextureSampler();
-	// Loading 3D models
-	loadModel();
+	uint32_t textureSamplerStage = graph.add("createTextureSampler", [this]() { createTextureSampler(); }, { logicalDeviceStage });
 	// Creation the Vertex Buffer
-	createVertexBuffer();
+	uint32_t vertexBufferStage = graph.add("createVertexBuffer", [this]() { createVertexBuffer(); }, { logicalDeviceStage, sceneStage });
 	// Creation of the Index Buffer
-	createIndexBuffer();
+	uint32_t indexBufferStage = graph.add("createIndexBuffer", [this]() { createIndexBuffer(); }, { logicalDeviceStage, sceneStage });
+	// The startup uploads are collected by one batch and submitted together after the scene is copied
+	/// The placeholder Texture is the element 0 of the bindless array that is sampled until the objects get their textures
+	uint32_t uploadsStage = graph.add("uploadScene", [this]()
+		{
+			beginUploadBatch();
+			TextureData placeholder{};
+			placeholder.pixels = { 255, 255, 255, 255 };
+			placeholder.width = 1;
+			placeholder.height = 1;
+			addTexture(placeholder);
+			uploadScene();
+			endUploadBatch();
+		}, { commandPoolStage, stagingRingStage, vertexBufferStage, indexBufferStage }, true);
 	// Creation of the Uniform buffers
-	createUniformBuffers();
+	uint32_t uniformBuffersStage = graph.add("createUniformBuffers", [this]() { createUniformBuffers(); }, { logicalDeviceStage });
+	// Creation of the object and indirect draw buffers
+	uint32_t sceneBuffersStage = graph.add("createSceneBuffers", [this]() { createSceneBuffers(); }, { logicalDeviceStage, sceneStage });
 	// Creation of the Descriptor pool
-	createDescriptorPool();
+	uint32_t descriptorPoolStage = graph.add("createDescriptorPool", [this]() { createDescriptorPool(); }, { logicalDeviceStage });
 	// Creation of the Descriptor Sets
-	createDescriptorSets();
+	uint32_t descriptorSetsStage = graph.add("createDescriptorSets", [this]() { createDescriptorSets(); },
+		{ descriptorPoolStage, descriptorSetLayoutStage, uniformBuffersStage, sceneBuffersStage, textureSamplerStage, uploadsStage });
 	// Creation the Command Buffer
-	createCommandBuffer();
-	// Creation Semaphores and Fences
-	createSyncObjects();
+	/// The cached command buffers are allocated for each image of the Swap Chain
+	uint32_t commandBuffersStage = graph.add("createCommandBuffer", [this]() { createCommandBuffer(); }, { commandPoolStage, swapChainStage });
+	// Creation Semaphores and the frame timeline
+	uint32_t syncObjectsStage = graph.add("createSyncObjects", [this]() { createSyncObjects(); }, { logicalDeviceStage });
+	// Printing the usage of the video memory after the initialization
+	graph.add("printMemoryStats", [this]() { printMemoryStats(); },
+		{ graphicsPipelineStage, framebuffersStage, descriptorSetsStage, commandBuffersStage, syncObjectsStage }, true);
+
+	if (serialStartup)
+	{
+		graph.runSerial();
+	}
+	else
+	{
+		graph.run(threadPool);
+	}
+	printStartupStats();
+}
+
+
+
+void Screen::printStartupStats()
+{
+	if (!enableValidationLayers)
+	{
+		return;
+	}
+
+	std::vector<uint32_t> path;
+	double critical = startupGraph.criticalPath(path);
+	std::cout << "--Startup: " << startupGraph.wallTime() << " ms, stages: " << startupGraph.totalTime() << " ms, critical path: " << critical << " ms" << std::endl;
+	for (uint32_t task : path)
+	{
+		std::cout << "---" << startupGraph.name(task) << ": " << startupGraph.timing(task).duration << " ms" << std::endl;
+	}
 }
 
 
@@ -438,7 +498,9 @@ bool Screen::isDeviceSuitable(VkPhysicalDevice device)
 		indices.isComplete() && //
 		extensionsSupported && // It's true when the Physical Device supports all necessary extensions for the SwapChain
 		swapChainAdequate &&
-		supportedFeatures.samplerAnisotropy; // It's true when formats and presentModes of the Physical Devices aren't empty
+		supportedFeatures.samplerAnisotropy && // It's true when formats and presentModes of the Physical Devices aren't empty
+		bindlessTextureLimit(device) > 0 && // The textures are sampled from the bindless array
+		supportsTimelineSemaphore(device); // The frames wait for the uploads of the transfer queue by the timeline semaphore
 }
 
 
@@ -453,11 +515,13 @@ QueueFamilyIndices Screen::findQueueFamilies(VkPhysicalDevice device)
 	vkGetPhysicalDeviceQueueFamilyProperties(device, &queueFamilyCount, queueFamilies.data());
 
 	// Checking the support of certain Family commands
+	/// All families are checked, the transfer family with the fewest other commands is the copy engine that works in parallel with the graphics queue
 	int i = 0;
+	int transferRank = -1;
 	for (const auto& queueFamily : queueFamilies)
 	{
 		// Finding the support of the Family command for graphics
-		if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) // VkQueueFlagBits
+		if (queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT && !indices.graphicsFamily.has_value()) // VkQueueFlagBits
 		{
 			indices.graphicsFamily = i;
 		}
@@ -465,25 +529,32 @@ QueueFamilyIndices Screen::findQueueFamilies(VkPhysicalDevice device)
 		// Finding the support of the Family command for present
 		VkBool32 presentSupport = false;
 		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface, &presentSupport);
-		if (presentSupport)
+		if (presentSupport && !indices.presentFamily.has_value())
 		{
 			indices.presentFamily = i;
 		}
 
 		// Finding the support of the Transport commands for GPU
+		/// The family without the graphics and the compute commands is ranked first, the family without the graphics commands is next
 		if (queueFamily.queueFlags & VK_QUEUE_TRANSFER_BIT) // VkQueueFlagBits
 		{
-			indices.transferFamily = i;
-		}
-		
-		if (indices.isComplete())
-		{
-			break;
+			int rank = ((queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) ? 0 : 2) + ((queueFamily.queueFlags & VK_QUEUE_COMPUTE_BIT) ? 0 : 1);
+			if (rank > transferRank)
+			{
+				indices.transferFamily = i;
+				transferRank = rank;
+			}
 		}
 
 		i++;
 	}
 
+	// The graphics family always supports the transfer commands, even when its flags don't tell it
+	if (!indices.transferFamily.has_value())
+	{
+		indices.transferFamily = indices.graphicsFamily;
+	}
+
 	return indices;
 }
 
@@ -513,6 +584,48 @@ int Screen::rateDeviceSuitability(VkPhysicalDevice device)
 
 
 
+uint32_t Screen::bindlessTextureLimit(VkPhysicalDevice device)
+{
+	// The descriptor indexing is the part of Vulkan 1.2
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(device, &properties);
+	if (properties.apiVersion < VK_API_VERSION_1_2)
+	{
+		return 0;
+	}
+
+	VkPhysicalDeviceVulkan12Features vulkan12Features{};
+	vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	VkPhysicalDeviceFeatures2 features{};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &vulkan12Features;
+	vkGetPhysicalDeviceFeatures2(device, &features);
+
+	// The array has the runtime size, its unused elements stay empty and the new elements are written while the frames use the set
+	if (!vulkan12Features.runtimeDescriptorArray ||
+		!vulkan12Features.descriptorBindingPartiallyBound ||
+		!vulkan12Features.descriptorBindingVariableDescriptorCount ||
+		!vulkan12Features.descriptorBindingSampledImageUpdateAfterBind ||
+		!vulkan12Features.descriptorBindingUpdateUnusedWhilePending ||
+		!vulkan12Features.shaderSampledImageArrayNonUniformIndexing)
+	{
+		return 0;
+	}
+
+	VkPhysicalDeviceDescriptorIndexingProperties indexingProperties{};
+	indexingProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_DESCRIPTOR_INDEXING_PROPERTIES;
+	VkPhysicalDeviceProperties2 properties2{};
+	properties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+	properties2.pNext = &indexingProperties;
+	vkGetPhysicalDeviceProperties2(device, &properties2);
+
+	return std::min({ MAX_BINDLESS_TEXTURES,
+						indexingProperties.maxDescriptorSetUpdateAfterBindSampledImages,
+						indexingProperties.maxPerStageDescriptorUpdateAfterBindSampledImages });
+}
+
+
+
 void Screen::createLogicalDevice()
 {
 	// Searching for available indices of families of Physical Device
@@ -536,6 +649,43 @@ void Screen::createLogicalDevice()
 	// Creating the structure with information of features of the Physical device
 	VkPhysicalDeviceFeatures deviceFeatures{};
 	deviceFeatures.samplerAnisotropy = VK_TRUE;
+	// The scene is drawn by the indirect commands, both features are optional
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+	multiDrawIndirect = (supportedFeatures.multiDrawIndirect == VK_TRUE);
+	drawIndirectFirstInstance = (supportedFeatures.drawIndirectFirstInstance == VK_TRUE);
+	deviceFeatures.multiDrawIndirect = supportedFeatures.multiDrawIndirect;
+	deviceFeatures.drawIndirectFirstInstance = supportedFeatures.drawIndirectFirstInstance;
+	// The block compressed textures are used only when the device can sample them, otherwise the RGBA8 texture is loaded
+	deviceFeatures.textureCompressionBC = supportedFeatures.textureCompressionBC;
+
+	// The features of the bindless texture array, isDeviceSuitable() has checked them
+	maxBindlessTextures = bindlessTextureLimit(physicalDevice);
+	VkPhysicalDeviceVulkan12Features vulkan12Features{};
+	vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	vulkan12Features.runtimeDescriptorArray = VK_TRUE;
+	vulkan12Features.descriptorBindingPartiallyBound = VK_TRUE;
+	vulkan12Features.descriptorBindingVariableDescriptorCount = VK_TRUE;
+	vulkan12Features.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+	vulkan12Features.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+	vulkan12Features.shaderSampledImageArrayNonUniformIndexing = VK_TRUE;
+	// The uploads of the transfer queue signal the timeline semaphore that the frames wait for
+	vulkan12Features.timelineSemaphore = VK_TRUE;
+	// The cached command buffers draw the number of the commands that the frame writes to the indirect buffer
+	VkPhysicalDeviceVulkan12Features supportedVulkan12Features{};
+	supportedVulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	VkPhysicalDeviceFeatures2 supportedFeatures2{};
+	supportedFeatures2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	supportedFeatures2.pNext = &supportedVulkan12Features;
+	vkGetPhysicalDeviceFeatures2(physicalDevice, &supportedFeatures2);
+	commandCache = CACHE_COMMAND_BUFFERS && multiDrawIndirect && drawIndirectFirstInstance && supportedVulkan12Features.drawIndirectCount == VK_TRUE;
+	vulkan12Features.drawIndirectCount = commandCache ? VK_TRUE : VK_FALSE;
+
+	// The core features are passed in the chain with the Vulkan 1.2 features instead of pEnabledFeatures
+	VkPhysicalDeviceFeatures2 enabledFeatures{};
+	enabledFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	enabledFeatures.pNext = &vulkan12Features;
+	enabledFeatures.features = deviceFeatures;
 
 	// Creating the main structure with information for the Logical device
 	VkDeviceCreateInfo createInfo{};
@@ -543,10 +693,18 @@ void Screen::createLogicalDevice()
 	createInfo.pQueueCreateInfos = queueCreateInfos.data();
 	
 	createInfo.queueCreateInfoCount = static_cast<uint32_t>(queueCreateInfos.size());
-	createInfo.pEnabledFeatures = &deviceFeatures;
+	createInfo.pNext = &enabledFeatures;
+	createInfo.pEnabledFeatures = nullptr;
 	// Adding the information about an extension VK_KHR_swapchain to the logical device
-	createInfo.enabledExtensionCount = static_cast<uint32_t>(DEVICE_EXTENSIONS.size());
-	createInfo.ppEnabledExtensionNames = DEVICE_EXTENSIONS.data();
+	/// VK_EXT_memory_budget is optional, without it the budget of the heaps is estimated by the allocator
+	std::vector<const char*> deviceExtensions = DEVICE_EXTENSIONS;
+	bool memoryBudget = isDeviceExtensionSupported(physicalDevice, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	if (memoryBudget)
+	{
+		deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	}
+	createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
+	createInfo.ppEnabledExtensionNames = deviceExtensions.data();
 	
 	if (enableValidationLayers)
 	{
@@ -568,7 +726,66 @@ void Screen::createLogicalDevice()
 	vkGetDeviceQueue(device, indices.graphicsFamily.value(), 0, &graphicsQueue);
 	vkGetDeviceQueue(device, indices.presentFamily.value(), 0, &presentQueue);
 	vkGetDeviceQueue(device, indices.transferFamily.value(), 0, &transferQueue);
+	graphicsFamily = indices.graphicsFamily.value();
+	transferFamily = indices.transferFamily.value();
+	if (enableValidationLayers)
+	{
+		std::cout << "--Queue families: graphics " << graphicsFamily << " transfer " << transferFamily <<
+			(graphicsFamily != transferFamily ? " (dedicated transfer queue)" : "") << std::endl;
+	}
+
+	// The allocator reads the memory types of the device that are used by all buffers and images
+	gpuAllocator.init(physicalDevice, device, memoryBudget);
+	// The streaming backs off when the usage of a heap comes close to its budget
+	gpuAllocator.setBudgetWarning(MEMORY_BUDGET_WARNING, [this](uint32_t heap, const GpuMemorySnapshot& snapshot)
+	{
+		onMemoryBudgetWarning(heap, snapshot);
+	});
+	directUpload = DIRECT_UPLOAD && gpuAllocator.mappableVideoMemory();
+	if (enableValidationLayers)
+	{
+		std::cout << "--Memory: " << (directUpload ? "direct upload to the video memory" : "upload through the staging buffer") << std::endl;
+	}
+}
+
+
+
+bool Screen::isDeviceExtensionSupported(VkPhysicalDevice device, const char* extensionName)
+{
+	uint32_t extensionCount;
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, nullptr);
+	std::vector<VkExtensionProperties> availableExtensions(extensionCount);
+	vkEnumerateDeviceExtensionProperties(device, nullptr, &extensionCount, availableExtensions.data());
+
+	for (const auto& extension : availableExtensions)
+	{
+		if (strcmp(extension.extensionName, extensionName) == 0)
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+
+
+bool Screen::supportsTimelineSemaphore(VkPhysicalDevice device)
+{
+	// The timeline semaphores are the part of Vulkan 1.2
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(device, &properties);
+	if (properties.apiVersion < VK_API_VERSION_1_2)
+	{
+		return false;
+	}
 
+	VkPhysicalDeviceVulkan12Features vulkan12Features{};
+	vulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+	VkPhysicalDeviceFeatures2 features{};
+	features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+	features.pNext = &vulkan12Features;
+	vkGetPhysicalDeviceFeatures2(device, &features);
+	return vulkan12Features.timelineSemaphore == VK_TRUE;
 }
 
 
@@ -782,6 +999,8 @@ void Screen::recreateSwapChain()
 	createImageViews();
 	createDepthResources();
 	createFramebuffers();
+	// The cached command buffers refer to the old framebuffers and the number of the images may change
+	allocateCommandCache();
 }
 
 
@@ -790,7 +1009,7 @@ void Screen::cleanupSwapChain()
 {
 	vkDestroyImageView(device, depthImageView, nullptr);
 	vkDestroyImage(device, depthImage, nullptr);
-	vkFreeMemory(device, depthMemory, nullptr);
+	gpuAllocator.free(depthMemory);
 	//
 	for (size_t i{}; i < swapChainFramebuffers.size(); ++i)
 	{
@@ -822,13 +1041,25 @@ void Screen::createImageViews()
 
 void Screen::createGraphicsPipeline() 
 {
-	// Reading the shader files
+	// Reading the shader files, the vertex shader variants are read for each vertex layout below
 	Shaders shader;
-	auto vertShaderCode = shader.readFile("Shaders/vert.spv");
+	// The SPIR-V modules are the output of Compile_Shaders.bat, they aren't kept in the repository
+	if (!std::ifstream("Shaders/frag.spv").good())
+	{
+		throw std::runtime_error("ERROR::Screen::createGraphicsPipeline()::Shaders/frag.spv is missing, run Compile_Shaders.bat");
+	}
 	auto fragShaderCode = shader.readFile("Shaders/frag.spv");
+	// The fragment shader samples the bindless array (binding 3) by the shared sampler (binding 1) of the descriptor set layout
+	ShaderInterface fragInterface = shader.readInterface(fragShaderCode);
+	for (uint32_t binding : { 1u, 3u })
+	{
+		if (std::find(fragInterface.bindings.begin(), fragInterface.bindings.end(), binding) == fragInterface.bindings.end())
+		{
+			throw std::runtime_error("ERROR::Screen::createGraphicsPipeline()::Shaders/frag.spv doesn't match the descriptor set layout, run Compile_Shaders.bat");
+		}
+	}
 
 	// Creating the local Shader Modules for the current Pipeline
-	VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
 	VkShaderModule fragShaderModule = createShaderModule(fragShaderCode);
 	
 	// Plug in the Vertex Shader Modules to the Pipeline
@@ -836,7 +1067,7 @@ void Screen::createGraphicsPipeline()
 	vertShaderStageInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
 	vertShaderStageInfo.stage = VK_SHADER_STAGE_VERTEX_BIT;
 	/// Plugin the Shader with Shader module and determination the Enterpoint
-	vertShaderStageInfo.module = vertShaderModule;
+	vertShaderStageInfo.module = VK_NULL_HANDLE;
 	vertShaderStageInfo.pName = "main";
 	vertShaderStageInfo.pSpecializationInfo = nullptr;
 
@@ -852,16 +1083,10 @@ void Screen::createGraphicsPipeline()
 	// The Array for storing the Shaders structures that was determined above the code
 	VkPipelineShaderStageCreateInfo shaderStages[] = { vertShaderStageInfo, fragShaderStageInfo };
 	
-	auto bindingDescription = Vertex::getBindingDescription();
-	auto attributeDescriptions = Vertex::getAttributeDescriptions();
-	
-	// the Structure to describe the Vertices Data Format
+	// the Structure to describe the Vertices Data Format, the descriptions are taken from the vertex layout below
 	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
 	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
 	vertexInputInfo.vertexBindingDescriptionCount = 1;
-	vertexInputInfo.pVertexBindingDescriptions = &bindingDescription;
-	vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size());
-	vertexInputInfo.pVertexAttributeDescriptions = attributeDescriptions.data();
 	
 	// the Structure that describes what geometry is formed from the vertices and availability of restart the geometry for Line Strip and Triangle Strip
 	VkPipelineInputAssemblyStateCreateInfo inputAssembly{};
@@ -986,15 +1211,41 @@ void Screen::createGraphicsPipeline()
 	pipelineInfo.basePipelineHandle = VK_NULL_HANDLE;
 	//pipelineInfo.basePipelineIndex = -1;
 
-	//
-	if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipeline) != VK_SUCCESS)
+	// The meshes of the geometry pool can have any vertex layout, each layout gets its vertex shader variant and vertex input
+	for (uint32_t i = 0; i < VERTEX_LAYOUT_COUNT; ++i)
 	{
-		throw std::runtime_error("ERROR::Screen::createGraphicsPipeline()::Failed ti create the Graphics Pipeline");
+		VertexLayout layout = static_cast<VertexLayout>(i);
+		graphicsPipelines[i] = VK_NULL_HANDLE;
+		if (!isVertexLayoutSupported(layout))
+		{
+			// The full precision layout is the fallback of all meshes, so its shader has to match
+			if (layout == VERTEX_LAYOUT_FULL)
+			{
+				throw std::runtime_error("ERROR::Screen::createGraphicsPipeline()::" + std::string(getVertexLayoutInfo(layout).vertexShader) +
+											" doesn't match the vertex layout or the descriptor set layout, run Compile_Shaders.bat");
+			}
+			continue;
+		}
+
+		VertexLayoutInfo layoutInfo = getVertexLayoutInfo(layout);
+		auto vertShaderCode = shader.readFile(layoutInfo.vertexShader);
+		VkShaderModule vertShaderModule = createShaderModule(vertShaderCode);
+		shaderStages[0].module = vertShaderModule;
+
+		vertexInputInfo.pVertexBindingDescriptions = &layoutInfo.bindingDescription;
+		vertexInputInfo.vertexAttributeDescriptionCount = static_cast<uint32_t>(layoutInfo.attributeDescriptions.size());
+		vertexInputInfo.pVertexAttributeDescriptions = layoutInfo.attributeDescriptions.data();
+
+		//
+		if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo, nullptr, &graphicsPipelines[i]) != VK_SUCCESS)
+		{
+			throw std::runtime_error("ERROR::Screen::createGraphicsPipeline()::Failed ti create the Graphics Pipeline");
+		}
+		vkDestroyShaderModule(device, vertShaderModule, nullptr);
 	}
 
 	// Destroy the shaders only after creating the Graphics Pipeline
 	vkDestroyShaderModule(device, fragShaderModule, nullptr);
-	vkDestroyShaderModule(device, vertShaderModule, nullptr);
 }
 
 
@@ -1149,33 +1400,23 @@ void Screen::createCommandPool()
 
 void Screen::createVertexBuffer()
 {
-	VkDeviceSize bufferSize = sizeof(vertices[0]) * vertices.size();
-	
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-
-	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, stagingBuffer, stagingBufferMemory);
-
-	
-	// Fill the vertex buffer with ...
-	void* data;
-	vkMapMemory(device, stagingBufferMemory, 0, bufferSize, 0, &data);
-	// Function to copy memory data (destination, source, number of bites)
-	memcpy(data, vertices.data(), static_cast<size_t>(bufferSize));
-	//
-	vkUnmapMemory(device, stagingBufferMemory);
-
-	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
+	// The buffer has the capacity of the whole pool, the meshes are copied to their ranges by uploadMeshes()
+	VkDeviceSize bufferSize = geometryPool.vertexCapacity();
 
-	copyBuffer(stagingBuffer, vertexBuffer, bufferSize,0, transferQueue);
+	// With the direct upload the buffer is mapped and written by uploadMeshes() without the staging copy
+	VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	if (directUpload)
+	{
+		properties |= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	}
 
-	vkDestroyBuffer(device, stagingBuffer, nullptr);
-	vkFreeMemory(device, stagingBufferMemory, nullptr);
+	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT, properties, vertexBuffer, vertexBufferMemory, MEMORY_CATEGORY_GEOMETRY);
 }
 
 
 
-void Screen::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+void Screen::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, GpuAllocation& bufferMemory,
+							MemoryCategory category, VkMemoryPropertyFlags preferred)
 {
 	VkBufferCreateInfo bufferInfo{};
 	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -1188,23 +1429,98 @@ void Screen::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryP
 		throw std::runtime_error("ERROR::Screen::createBuffer()::Failed to create buffer");
 	}
 
-	VkMemoryRequirements memRequirements;
-	vkGetBufferMemoryRequirements(device, buffer, &memRequirements);
+	// The requirements tell if the driver wants the buffer in its own allocation
+	VkMemoryDedicatedRequirements dedicatedRequirements{};
+	dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+	VkMemoryRequirements2 memRequirements{};
+	memRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+	memRequirements.pNext = &dedicatedRequirements;
+	VkBufferMemoryRequirementsInfo2 requirementsInfo{};
+	requirementsInfo.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+	requirementsInfo.buffer = buffer;
+	vkGetBufferMemoryRequirements2(device, &requirementsInfo, &memRequirements);
+
+	VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+	dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+	dedicatedInfo.buffer = buffer;
+	bool dedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+
+	// Allocate the buffer memory from the block of the memory type
+	uint32_t memoryType = findMemoryType(memRequirements.memoryRequirements.memoryTypeBits, properties, preferred);
+	bufferMemory = gpuAllocator.allocate(memRequirements.memoryRequirements, memoryType, true, dedicated ? &dedicatedInfo : nullptr, category);
+
+	// Bind the buffer to the memory
+	vkBindBufferMemory(device, buffer, bufferMemory.memory, bufferMemory.offset);
+
+}
+
 
-	// Allocate the Vertex buffer memory
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
 
-	if (vkAllocateMemory(device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS)
+void Screen::printMemoryStats()
+{
+	if (enableValidationLayers)
 	{
-		throw std::runtime_error("ERROR::Screen::createBuffer()::Failed to allocate the buffer memory");
+		GpuAllocatorStats stats = gpuAllocator.stats();
+		std::cout << "--Memory: blocks: " << stats.blockCount << " (" << stats.blockBytes << " bytes, used " << stats.usedBytes <<
+			") dedicated: " << stats.dedicatedCount << " (" << stats.dedicatedBytes << " bytes) allocations: " << stats.allocationCount <<
+			" largest free range: " << stats.largestFreeRange << " fragmentation: " << stats.fragmentation << std::endl;
+
+		const char* categoryNames[MEMORY_CATEGORY_COUNT] = { "geometry", "texture", "uniform", "attachment", "staging" };
+		GpuMemorySnapshot snapshot = gpuAllocator.snapshot();
+		for (uint32_t i = 0; i < MEMORY_CATEGORY_COUNT; ++i)
+		{
+			std::cout << "--Memory: " << categoryNames[i] << ": " << snapshot.categoryBytes[i] << " bytes" << std::endl;
+		}
+		for (uint32_t i = 0; i < snapshot.heapCount; ++i)
+		{
+			std::cout << "--Memory: heap " << i << ": allocated " << snapshot.heapAllocated[i] << " usage " << snapshot.heapUsage[i] << " budget " <<
+				snapshot.heapBudget[i] << (snapshot.budgetExtension ? "" : " (estimated)") << std::endl;
+		}
 	}
+}
 
-	// Bind the buffer to the memory
-	vkBindBufferMemory(device, buffer, bufferMemory, 0);
 
+
+void Screen::onMemoryBudgetWarning(uint32_t heap, const GpuMemorySnapshot& snapshot)
+{
+	if (enableValidationLayers)
+	{
+		std::cout << "--Memory: heap " << heap << " is close to its budget: usage " << snapshot.heapUsage[heap] << " budget " << snapshot.heapBudget[heap] << std::endl;
+	}
+
+	// The texture streaming keeps the levels it has but doesn't load more, the levels above the new budget are evicted by the next loads
+	VkDeviceSize over = snapshot.heapUsage[heap] - static_cast<VkDeviceSize>(static_cast<double>(snapshot.heapBudget[heap]) * MEMORY_BUDGET_WARNING);
+	VkDeviceSize resident = textureStreamer.residentBytes();
+	textureStreamer.configure(resident > over ? resident - over : 0, TEXTURE_STREAMING_UPLOAD_SIZE, TEXTURE_STREAMING_TAIL_SIZE);
+}
+
+
+
+void Screen::restoreStreamingBudget(const GpuMemorySnapshot& snapshot)
+{
+	VkDeviceSize budget = textureStreamer.getBudget();
+	if (budget >= TEXTURE_STREAMING_BUDGET)
+	{
+		return;
+	}
+
+	// The streaming gets back only the bytes that keep every heap below the threshold, so the next loads don't call the warning again
+	VkDeviceSize room = TEXTURE_STREAMING_BUDGET - budget;
+	for (uint32_t i = 0; i < snapshot.heapCount; ++i)
+	{
+		VkDeviceSize threshold = static_cast<VkDeviceSize>(static_cast<double>(snapshot.heapBudget[i]) * MEMORY_BUDGET_WARNING);
+		room = std::min(room, snapshot.heapUsage[i] < threshold ? threshold - snapshot.heapUsage[i] : 0);
+	}
+	if (room == 0)
+	{
+		return;
+	}
+
+	textureStreamer.configure(budget + room, TEXTURE_STREAMING_UPLOAD_SIZE, TEXTURE_STREAMING_TAIL_SIZE);
+	if (enableValidationLayers && budget + room == TEXTURE_STREAMING_BUDGET)
+	{
+		std::cout << "--Memory: the budget of the texture streaming is restored" << std::endl;
+	}
 }
 
 
@@ -1212,7 +1528,7 @@ void Screen::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryP
 void Screen::createCommandBuffer()
 {
 	// Resize the vector contains commandBuffers to the max number of the rendered simultaneously images
-	commandBuffer.resize(MAX_FRAMES_IN_FLIGHT);
+	commandBuffer.resize(framesInFlight);
 	// Making the temp Vulkan structure to place the necessary information about Command Buffer 
 	VkCommandBufferAllocateInfo allocInfo{};
 	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
@@ -1225,7 +1541,7 @@ void Screen::createCommandBuffer()
 		throw std::runtime_error("ERROR::Screen::createCommandBuffer()::Failed to allocate the Graphics Command Buffers");
 	}
 	//// Create the command buffer for the transfer queue
-	//commandBufferTransfer.resize(MAX_FRAMES_IN_FLIGHT);
+	//commandBufferTransfer.resize(framesInFlight);
 	//allocInfo.commandPool = commandPoolTransfer;
 	//allocInfo.commandBufferCount = static_cast<uint32_t>(commandBufferTransfer.size());
 
@@ -1235,6 +1551,35 @@ void Screen::createCommandBuffer()
 	//	throw std::runtime_error("ERROR::Screen::createCommandBuffer()::Failed to allocate the Transfer Command Buffer");
 	//}
 
+	cachedLayouts = 0;
+	allocateCommandCache();
+
+	// The pools of the recording threads, the calling thread of parallelFor() records one part too
+	uint32_t poolCount = threadPool.size() + 1;
+	recordThreads = std::min(RECORD_THREADS, poolCount);
+	recordPools.assign(framesInFlight, std::vector<VkCommandPool>(poolCount));
+	secondaryCommandBuffers.assign(framesInFlight, std::vector<VkCommandBuffer>(poolCount));
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = graphicsFamily;
+	for (size_t frame = 0; frame < framesInFlight; ++frame)
+	{
+		for (uint32_t i = 0; i < poolCount; ++i)
+		{
+			if (vkCreateCommandPool(device, &poolInfo, nullptr, &recordPools[frame][i]) != VK_SUCCESS)
+			{
+				throw std::runtime_error("ERROR::Screen::createCommandBuffer()::Failed to create the Recording Command Pool");
+			}
+			allocInfo.commandPool = recordPools[frame][i];
+			allocInfo.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+			allocInfo.commandBufferCount = 1;
+			if (vkAllocateCommandBuffers(device, &allocInfo, &secondaryCommandBuffers[frame][i]) != VK_SUCCESS)
+			{
+				throw std::runtime_error("ERROR::Screen::createCommandBuffer()::Failed to allocate the Secondary Command Buffer");
+			}
+		}
+	}
 }
 
 
@@ -1252,6 +1597,13 @@ void Screen::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIn
 		throw std::runtime_error("ERROR::Screen::recordCommandBuffer()::Failed to begin recording the Command Buffer");
 	}
 
+	// The resources that the transfer queue released since the previous frame are taken by the graphics queue before the render pass
+	/// The cached command buffer is submitted many times, so the acquires are recorded by drawFrame() to the command buffer of the frame
+	if (!commandCache)
+	{
+		recordUploadAcquires(commandBuffer);
+	}
+
 	// The Vulkan Structure that contains the necessary information for the Render Pass
 	VkRenderPassBeginInfo renderPassInfo{};
 	renderPassInfo.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
@@ -1266,13 +1618,36 @@ void Screen::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIn
 	clearValues[1].depthStencil = { 1.0f,0 };
 	renderPassInfo.clearValueCount = static_cast<uint32_t>(clearValues.size());
 	renderPassInfo.pClearValues = clearValues.data();
+	// The many draws that are recorded by one command each are split between the threads, the primary buffer only executes their secondary buffers
+	bool parallel = !commandCache && recordThreads > 1 && (!drawIndirectFirstInstance || !multiDrawIndirect) &&
+					sceneDraws.size() >= PARALLEL_RECORD_MIN_DRAWS;
 	// Function to start the Render  Pass
-	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, VK_SUBPASS_CONTENTS_INLINE);
+	vkCmdBeginRenderPass(commandBuffer, &renderPassInfo, parallel ? VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS : VK_SUBPASS_CONTENTS_INLINE);
 
-	// Putting the Graphics Pipeline to the work
-	vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipeline);
+	if (parallel)
+	{
+		recordSecondaryDraws(commandBuffer, imageIndex);
+	}
+	else
+	{
+		recordDrawRange(commandBuffer, 0, static_cast<uint32_t>(sceneDraws.size()));
+	}
 
-	//
+	// Function to end the Render Pass
+	vkCmdEndRenderPass(commandBuffer);
+	
+	// Function to end the recording of the Command Buffer
+	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+	{
+		throw std::runtime_error("ERROR::Screen::recordCommandBuffer()::Failed to end recording the Command Buffer");
+	}
+}
+
+
+
+void Screen::recordDrawRange(VkCommandBuffer commandBuffer, uint32_t firstDraw, uint32_t lastDraw)
+{
+	// The secondary command buffers don't inherit the state, so each of them sets it again
 	VkViewport viewport{};
 	viewport.x = 0.0f;
 	viewport.y = 0.0f;
@@ -1290,33 +1665,155 @@ void Screen::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIn
 	VkBuffer vertexBuffers[] = { vertexBuffer };
 	VkDeviceSize offsets[] = { 0 };
 	vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-	vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+	vkCmdBindIndexBuffer(commandBuffer, indexBuffer, 0, geometryPool.indexType());
 
 	// Function to bind the Descriptor sets
 	vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSets[currentFrame], 0, nullptr);
 	
 	// Function to draw the image 
 	//vkCmdDraw(commandBuffer, static_cast<uint32_t>(vertices.size()), 1, 0, 0);
-	vkCmdDrawIndexed(commandBuffer, static_cast<uint32_t>(indices.size()), 1, 0, 0, 0);
+	// The draw commands of the scene were written by updateSceneDraws(), the pipeline is changed only between the vertex layouts
+	/// The cached command buffer draws each used layout from its fixed range of the indirect buffer, the count is written by each frame
+	for (uint32_t i = 0; commandCache && i < VERTEX_LAYOUT_COUNT; ++i)
+	{
+		if ((cachedLayouts & (1u << i)) == 0)
+		{
+			continue;
+		}
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipelines[i]);
+		VkDeviceSize countOffset = sizeof(VkDrawIndexedIndirectCommand) * VERTEX_LAYOUT_COUNT * MAX_SCENE_DRAWS + sizeof(uint32_t) * i;
+		vkCmdDrawIndexedIndirectCount(commandBuffer, indirectBuffers[currentFrame], sizeof(VkDrawIndexedIndirectCommand) * i * MAX_SCENE_DRAWS,
+										indirectBuffers[currentFrame], countOffset, MAX_SCENE_DRAWS, sizeof(VkDrawIndexedIndirectCommand));
+	}
+	/// Only the part of the commands of each layout between firstDraw and lastDraw is recorded
+	for (uint32_t i = 0; !commandCache && i < VERTEX_LAYOUT_COUNT; ++i)
+	{
+		uint32_t layoutFirst = std::max(layoutFirstDraw[i], firstDraw);
+		uint32_t layoutLast = std::min(layoutFirstDraw[i] + layoutDrawCount[i], lastDraw);
+		if (layoutFirst >= layoutLast)
+		{
+			continue;
+		}
 
+		// Putting the Graphics Pipeline to the work
+		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, graphicsPipelines[i]);
 
-	// Function to end the Render Pass
-	vkCmdEndRenderPass(commandBuffer);
-	
-	// Function to end the recording of the Command Buffer
-	if (vkEndCommandBuffer(commandBuffer) != VK_SUCCESS)
+		VkDeviceSize drawOffset = layoutFirst * sizeof(VkDrawIndexedIndirectCommand);
+		if (!drawIndirectFirstInstance)
+		{
+			// The indirect commands can't set firstInstance without the feature, so the same commands are recorded directly
+			for (uint32_t draw = layoutFirst; draw < layoutLast; ++draw)
+			{
+				const VkDrawIndexedIndirectCommand& command = sceneDraws[draw];
+				vkCmdDrawIndexed(commandBuffer, command.indexCount, command.instanceCount, command.firstIndex, command.vertexOffset, command.firstInstance);
+			}
+		}
+		else if (multiDrawIndirect)
+		{
+			vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffers[currentFrame], drawOffset, layoutLast - layoutFirst, sizeof(VkDrawIndexedIndirectCommand));
+		}
+		else
+		{
+			for (uint32_t draw = 0; draw < layoutLast - layoutFirst; ++draw)
+			{
+				vkCmdDrawIndexedIndirect(commandBuffer, indirectBuffers[currentFrame], drawOffset + draw * sizeof(VkDrawIndexedIndirectCommand), 1,
+											sizeof(VkDrawIndexedIndirectCommand));
+			}
+		}
+	}
+}
+
+
+
+void Screen::recordSecondaryDraws(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+{
+	// Each thread records the equal part of the draws to the secondary command buffer of its own pool, so the pools aren't locked
+	uint32_t drawCount = static_cast<uint32_t>(sceneDraws.size());
+	uint32_t chunkCount = std::min(recordThreads, drawCount);
+	std::vector<VkCommandBuffer>& secondaries = secondaryCommandBuffers[currentFrame];
+	threadPool.parallelFor(chunkCount, [this, &secondaries, imageIndex, drawCount, chunkCount](size_t chunk)
 	{
-		throw std::runtime_error("ERROR::Screen::recordCommandBuffer()::Failed to end recording the Command Buffer");
+		// The previous use of the frame is finished by the GPU, so the old commands of its pools are freed at once
+		vkResetCommandPool(device, recordPools[currentFrame][chunk], 0);
+
+		VkCommandBufferInheritanceInfo inheritanceInfo{};
+		inheritanceInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+		inheritanceInfo.renderPass = renderPass;
+		inheritanceInfo.subpass = 0;
+		inheritanceInfo.framebuffer = swapChainFramebuffers[imageIndex];
+		VkCommandBufferBeginInfo beginInfo{};
+		beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+		beginInfo.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+		beginInfo.pInheritanceInfo = &inheritanceInfo;
+		if (vkBeginCommandBuffer(secondaries[chunk], &beginInfo) != VK_SUCCESS)
+		{
+			throw std::runtime_error("ERROR::Screen::recordSecondaryDraws()::Failed to begin recording the Secondary Command Buffer");
+		}
+
+		uint32_t firstDraw = static_cast<uint32_t>(static_cast<size_t>(drawCount) * chunk / chunkCount);
+		uint32_t lastDraw = static_cast<uint32_t>(static_cast<size_t>(drawCount) * (chunk + 1) / chunkCount);
+		recordDrawRange(secondaries[chunk], firstDraw, lastDraw);
+
+		if (vkEndCommandBuffer(secondaries[chunk]) != VK_SUCCESS)
+		{
+			throw std::runtime_error("ERROR::Screen::recordSecondaryDraws()::Failed to end recording the Secondary Command Buffer");
+		}
+	});
+
+	// The parts are executed in the order of the draws
+	vkCmdExecuteCommands(commandBuffer, chunkCount, secondaries.data());
+}
+
+
+
+void Screen::setRecordingBenchmark(uint32_t threads, uint32_t drawCount)
+{
+	// The draws are recorded by one command each like on the devices without multiDrawIndirect, the cached command buffers aren't recorded
+	commandCache = false;
+	multiDrawIndirect = false;
+	recordThreads = std::clamp(threads, 1u, getMaxRecordThreads());
+
+	const PoolMesh& mesh = geometryPool.getMesh(sceneObjects[0].mesh);
+	const MeshLod& lod = mesh.lods[0];
+	sceneDraws.assign(std::min(drawCount, MAX_SCENE_DRAWS), { lod.indexCount, 1, mesh.firstIndex + lod.firstIndex, mesh.vertexOffset, 0 });
+	layoutFirstDraw.fill(0);
+	layoutDrawCount.fill(0);
+	layoutDrawCount[mesh.vertexLayout] = static_cast<uint32_t>(sceneDraws.size());
+}
+
+
+
+void Screen::recordBenchmarkFrame()
+{
+	// The command buffer and the secondary pools of the slot can still be used by the frame that was submitted framesInFlight frames ago
+	if (frameSubmission >= framesInFlight)
+	{
+		waitFrame(frameSubmission + 1 - framesInFlight);
 	}
+	vkResetCommandBuffer(commandBuffer[currentFrame], 0);
+	recordCommandBuffer(commandBuffer[currentFrame], 0);
 }
 
 
 
 void Screen::drawFrame()
 {
+	// Uploading the assets that were loaded since the previous frame, all of them are submitted by one batch
+	beginUploadBatch();
+	assetLoader.pump();
+	endUploadBatch();
 	
-	// Waiting signal of the fence to create a new image
-	vkWaitForFences(device, 1, &inFlightFence[currentFrame], VK_TRUE, UINT64_MAX);
+	// The resources of this frame were used by the frame that was submitted framesInFlight frames ago, the CPU waits only when the GPU is that far behind
+	if (frameSubmission >= framesInFlight)
+	{
+		waitFrame(frameSubmission + 1 - framesInFlight);
+	}
+	// The uploads that the transfer queue has finished give back their command buffers and staging regions
+	collectUploads();
+
+	// The usage of the video memory before the streaming of the frame, it calls the warning when a heap comes close to its budget
+	memorySnapshot = gpuAllocator.snapshot();
+	restoreStreamingBudget(memorySnapshot);
 
 	uint32_t imageIndex;
 
@@ -1335,38 +1832,91 @@ void Screen::drawFrame()
 
 	// Update the Uniform Buffer
 	updateUniformBuffer(currentFrame);
+	// Writing the draw commands of the visible objects
+	updateSceneDraws(currentFrame);
+	// Loading and evicting the texture levels by the sizes of the visible objects on the screen, the new levels are uploaded by one batch
+	beginUploadBatch();
+	updateTextureStreaming(currentFrame);
+	endUploadBatch();
 
-	vkResetFences(device,1,&inFlightFence[currentFrame]);
-	
 	// Getting the image from the Swap Chain
 	//vkAcquireNextImageKHR(device, swapChain, UINT64_MAX, imageAvailableSemaphore[currentFrame], VK_NULL_HANDLE, &imageIndex);
 	
-	//
-	vkResetCommandBuffer(commandBuffer[currentFrame], 0);
-	recordCommandBuffer(commandBuffer[currentFrame], imageIndex);
+	// The command buffers of the frame, the acquires of the uploads go before the cached draws
+	std::array<VkCommandBuffer, 2> submitCommandBuffers{};
+	uint32_t submitCommandBufferCount = 0;
+	if (!commandCache)
+	{
+		vkResetCommandBuffer(commandBuffer[currentFrame], 0);
+		recordCommandBuffer(commandBuffer[currentFrame], imageIndex);
+		submitCommandBuffers[submitCommandBufferCount++] = commandBuffer[currentFrame];
+	}
+	else
+	{
+		if (!pendingAcquires.empty())
+		{
+			VkCommandBufferBeginInfo beginInfo{};
+			beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+			beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+			vkResetCommandBuffer(commandBuffer[currentFrame], 0);
+			if (vkBeginCommandBuffer(commandBuffer[currentFrame], &beginInfo) != VK_SUCCESS)
+			{
+				throw std::runtime_error("ERROR::Screen::drawFrame()::Failed to begin recording the Acquire Command Buffer");
+			}
+			recordUploadAcquires(commandBuffer[currentFrame]);
+			if (vkEndCommandBuffer(commandBuffer[currentFrame]) != VK_SUCCESS)
+			{
+				throw std::runtime_error("ERROR::Screen::drawFrame()::Failed to end recording the Acquire Command Buffer");
+			}
+			submitCommandBuffers[submitCommandBufferCount++] = commandBuffer[currentFrame];
+		}
+
+		// The previous use of the frame is finished by the GPU, so none of its cached command buffers is pending and the invalidated one is recorded again
+		size_t cached = currentFrame * swapChainImages.size() + imageIndex;
+		if (!cachedRecorded[cached])
+		{
+			vkResetCommandBuffer(cachedCommandBuffers[cached], 0);
+			recordCommandBuffer(cachedCommandBuffers[cached], imageIndex);
+			cachedRecorded[cached] = true;
+		}
+		submitCommandBuffers[submitCommandBufferCount++] = cachedCommandBuffers[cached];
+	}
 	
 	// The Vulkan structure to setup the sending to the queue and synchronization 
 	VkSubmitInfo submitInfo{};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 	/// Making the arrays to keep semaphores and stages of the Graphics Pipeline
-	VkSemaphore waitSemaphores[] = { imageAvailableSemaphore[currentFrame] };
-	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
+	/// The frame also waits for the last upload on the GPU, only the stages that read the uploaded resources are held and the CPU doesn't wait
+	VkSemaphore waitSemaphores[] = { imageAvailableSemaphore[currentFrame], uploadTimeline };
+	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
+											VK_PIPELINE_STAGE_TRANSFER_BIT | VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT };
+	uint64_t waitValues[] = { 0, uploadSubmission };
+	/// The binary semaphore is waited by the presentation, the timeline semaphore gets the number of the frame
+	uint64_t signalValues[] = { 0, frameSubmission + 1 };
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.waitSemaphoreValueCount = 2;
+	timelineInfo.pWaitSemaphoreValues = waitValues;
+	timelineInfo.signalSemaphoreValueCount = 2;
+	timelineInfo.pSignalSemaphoreValues = signalValues;
+	submitInfo.pNext = &timelineInfo;
 	/// Filling the VkSubmitInfo with information that describing what semaphores we need to wait and for what stage of the pipeline
-	submitInfo.waitSemaphoreCount = 1;
+	submitInfo.waitSemaphoreCount = 2;
 	submitInfo.pWaitSemaphores = waitSemaphores;
 	submitInfo.pWaitDstStageMask = waitStages;
 	/// Pointing what a Command Buffer of the gotten Image we have to use 
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffer[currentFrame];
+	submitInfo.commandBufferCount = submitCommandBufferCount;
+	submitInfo.pCommandBuffers = submitCommandBuffers.data();
 	/// Making the array with semaphores witch signal about the ending of the executing the Command Buffers
-	VkSemaphore signalSemaphores[] = { renderFinishedSemaphore[currentFrame] };
-	submitInfo.signalSemaphoreCount = 1;
+	VkSemaphore signalSemaphores[] = { renderFinishedSemaphore[currentFrame], frameTimeline };
+	submitInfo.signalSemaphoreCount = 2;
 	submitInfo.pSignalSemaphores = signalSemaphores;
 	// Sending the Command Buffer to the Graphics Queue
-	if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, inFlightFence[currentFrame]) != VK_SUCCESS)
+	if (vkQueueSubmit(graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
 	{
 		throw std::runtime_error("ERROR::Screen::drawFrame()::Failed to submit the Draw Command Buffer");
 	}
+	++frameSubmission;
 
 	// Sending the result of rendering back to the Swap Chain
 	// Setup the Screen display
@@ -1394,7 +1944,7 @@ void Screen::drawFrame()
 		throw std::runtime_error("ERROR::Screen::drawFrame()::Failed to present swap chain image");
 	}
 
-	currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+	currentFrame = (currentFrame + 1) % framesInFlight;
 }
 
 
@@ -1402,9 +1952,8 @@ void Screen::drawFrame()
 void Screen::createSyncObjects()
 {
 	// Resize all the synchro objects toward the max count of the simultaneously rendered images 
-	imageAvailableSemaphore.resize(MAX_FRAMES_IN_FLIGHT);
-	renderFinishedSemaphore.resize(MAX_FRAMES_IN_FLIGHT);
-	inFlightFence.resize(MAX_FRAMES_IN_FLIGHT);
+	imageAvailableSemaphore.resize(framesInFlight);
+	renderFinishedSemaphore.resize(framesInFlight);
 	
 	// Filling the Vulkan structure with information about semaphores 
 	VkSemaphoreCreateInfo semaphoreInfo{};
@@ -1412,40 +1961,130 @@ void Screen::createSyncObjects()
 	semaphoreInfo.pNext = nullptr;
 	semaphoreInfo.flags = VK_NULL_HANDLE;
 
-	// Filling the Vulkan structure with information about fences
-	VkFenceCreateInfo fenceInfo{};
-	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-	fenceInfo.pNext = nullptr;
-	fenceInfo.flags = VK_FENCE_CREATE_SIGNALED_BIT;
-
-	for (size_t i{}; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	for (size_t i{}; i < framesInFlight; ++i)
 	{
 
 		if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &imageAvailableSemaphore[i]) != VK_SUCCESS ||
-			vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphore[i]) != VK_SUCCESS ||
-			vkCreateFence(device, &fenceInfo, nullptr, &inFlightFence[i]) != VK_SUCCESS)
+			vkCreateSemaphore(device, &semaphoreInfo, nullptr, &renderFinishedSemaphore[i]) != VK_SUCCESS)
 		{
 			throw std::runtime_error("ERROR::Screen::createSyncObjects()::Failed the Synchronization objects");
 		}
 	}
-}
-
 
+	// The value of the timeline semaphore is the number of the last finished frame, it replaces the fences of the frames
+	VkSemaphoreTypeCreateInfo typeInfo{};
+	typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	typeInfo.initialValue = 0;
+	semaphoreInfo.pNext = &typeInfo;
+	if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &frameTimeline) != VK_SUCCESS)
+	{
+		throw std::runtime_error("ERROR::Screen::createSyncObjects()::Failed to create the frame timeline semaphore");
+	}
+	frameSubmission = 0;
+}
+
+
+
+bool Screen::isFrameComplete(uint64_t frame)
+{
+	uint64_t completed = 0;
+	vkGetSemaphoreCounterValue(device, frameTimeline, &completed);
+	return completed >= frame;
+}
+
+
+
+void Screen::waitFrame(uint64_t frame)
+{
+	VkSemaphoreWaitInfo waitInfo{};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &frameTimeline;
+	waitInfo.pValues = &frame;
+	if (vkWaitSemaphores(device, &waitInfo, UINT64_MAX) != VK_SUCCESS)
+	{
+		throw std::runtime_error("ERROR::Screen::waitFrame()::Failed to wait for the frame");
+	}
+}
+
+
+
+void Screen::allocateCommandCache()
+{
+	if (!commandCache)
+	{
+		return;
+	}
+
+	if (!cachedCommandBuffers.empty())
+	{
+		vkFreeCommandBuffers(device, commandPool, static_cast<uint32_t>(cachedCommandBuffers.size()), cachedCommandBuffers.data());
+	}
+	cachedCommandBuffers.resize(framesInFlight * swapChainImages.size());
+
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = commandPool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = static_cast<uint32_t>(cachedCommandBuffers.size());
+	if (vkAllocateCommandBuffers(device, &allocInfo, cachedCommandBuffers.data()) != VK_SUCCESS)
+	{
+		throw std::runtime_error("ERROR::Screen::allocateCommandCache()::Failed to allocate the Cached Command Buffers");
+	}
+	invalidateCommandCache();
+}
+
+
+
+void Screen::invalidateCommandCache()
+{
+	cachedRecorded.assign(cachedCommandBuffers.size(), false);
+	if (enableValidationLayers && commandCache)
+	{
+		std::cout << "--The cached command buffers are recorded again" << std::endl;
+	}
+}
 
-uint32_t Screen::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
+
+
+uint32_t Screen::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, VkMemoryPropertyFlags preferred)
 {
-	// Get the information about memory properties of the Physical device
-	VkPhysicalDeviceMemoryProperties memProperties;
-	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memProperties);
+	// The memory properties of the Physical device are read once by the allocator
+	const VkPhysicalDeviceMemoryProperties& memProperties = gpuAllocator.memoryProperties();
 
+	uint32_t bestType = UINT32_MAX;
+	uint32_t bestCost = UINT32_MAX;
 	for (uint32_t i{}; i < memProperties.memoryTypeCount; ++i)
 	{
-		if ((typeFilter & (1 << i)) && (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
+		VkMemoryPropertyFlags flags = memProperties.memoryTypes[i].propertyFlags;
+		if (!(typeFilter & (1 << i)) || (flags & properties) != properties)
+		{
+			continue;
+		}
+
+		// Each missing preferred property costs more than all extra properties
+		uint32_t cost = 0;
+		for (VkMemoryPropertyFlags extra = flags & ~(properties | preferred); extra != 0; extra &= extra - 1)
+		{
+			++cost;
+		}
+		for (VkMemoryPropertyFlags missing = preferred & ~flags; missing != 0; missing &= missing - 1)
+		{
+			cost += 32;
+		}
+		if (cost < bestCost)
 		{
-			return i;
+			bestType = i;
+			bestCost = cost;
 		}
 	}
-	throw std::runtime_error("ERROR::Screen::findMemory()::Failed to find suitable memory type");
+
+	if (bestType == UINT32_MAX)
+	{
+		throw std::runtime_error("ERROR::Screen::findMemory()::Failed to find suitable memory type");
+	}
+	return bestType;
 }
 
 
@@ -1468,23 +2107,17 @@ void Screen::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize siz
 
 void Screen::createIndexBuffer()
 {
-	VkDeviceSize bufferSize = sizeof(indices[0]) * indices.size();
-	VkBuffer stagingBuffer;
-	VkDeviceMemory staginBufferMemory;
+	// The buffer has the capacity of the whole pool, the meshes are copied to their ranges by uploadMeshes()
+	VkDeviceSize bufferSize = geometryPool.indexCapacity();
 
-	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,stagingBuffer,staginBufferMemory);
-
-	void* data;
-	vkMapMemory(device, staginBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, indices.data(), static_cast<size_t>(bufferSize));
-	vkUnmapMemory(device, staginBufferMemory);
-
-	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
-
-	copyBuffer(stagingBuffer, indexBuffer, bufferSize, 1, transferQueue);
+	// With the direct upload the buffer is mapped and written by uploadMeshes() without the staging copy
+	VkMemoryPropertyFlags properties = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+	if (directUpload)
+	{
+		properties |= VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+	}
 
-	vkDestroyBuffer(device, stagingBuffer, nullptr);
-	vkFreeMemory(device, staginBufferMemory, nullptr);
+	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, properties, indexBuffer, indexBufferMemory, MEMORY_CATEGORY_GEOMETRY);
 }
 
 
@@ -1499,17 +2132,46 @@ void Screen::createDescriptorSetLayout()
 	uboLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
 	uboLayoutBinding.pImmutableSamplers = nullptr;
 
+	// The sampler is separate from the images, so all textures of the array share it
 	VkDescriptorSetLayoutBinding samplerLayoutBinding{};
 	samplerLayoutBinding.binding = 1;
-	samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+	samplerLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
 	samplerLayoutBinding.descriptorCount = 1;
 	samplerLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
 	samplerLayoutBinding.pImmutableSamplers = nullptr;
 
-	std::array<VkDescriptorSetLayoutBinding, 2> bindings = { uboLayoutBinding, samplerLayoutBinding };
+	// The matrices of the scene objects
+	VkDescriptorSetLayoutBinding objectLayoutBinding{};
+	objectLayoutBinding.binding = 2;
+	objectLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	objectLayoutBinding.descriptorCount = 1;
+	objectLayoutBinding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+	objectLayoutBinding.pImmutableSamplers = nullptr;
+
+	// The bindless texture array, it's the last binding because its size is set when the descriptor set is allocated
+	VkDescriptorSetLayoutBinding textureLayoutBinding{};
+	textureLayoutBinding.binding = 3;
+	textureLayoutBinding.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	textureLayoutBinding.descriptorCount = maxBindlessTextures;
+	textureLayoutBinding.stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT;
+	textureLayoutBinding.pImmutableSamplers = nullptr;
+
+	std::array<VkDescriptorSetLayoutBinding, 4> bindings = { uboLayoutBinding, samplerLayoutBinding, objectLayoutBinding, textureLayoutBinding };
+
+	// The empty elements of the array aren't read, the new textures are written while the frames in flight use the set
+	std::array<VkDescriptorBindingFlags, 4> bindingFlags = { 0, 0, 0,
+		VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT |
+		VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT | VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT };
+
+	VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsInfo{};
+	bindingFlagsInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+	bindingFlagsInfo.bindingCount = static_cast<uint32_t>(bindingFlags.size());
+	bindingFlagsInfo.pBindingFlags = bindingFlags.data();
 
 	VkDescriptorSetLayoutCreateInfo layoutInfo{};
 	layoutInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+	layoutInfo.pNext = &bindingFlagsInfo;
+	layoutInfo.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
 	layoutInfo.bindingCount = static_cast<uint32_t>(bindings.size());
 	layoutInfo.pBindings = bindings.data();
 
@@ -1524,14 +2186,15 @@ void Screen::createDescriptorSetLayout()
 void Screen::createUniformBuffers()
 {
 	VkDeviceSize bufferSize = sizeof(UniformBufferObject);
-	uniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
-	uniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
-	uniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
+	uniformBuffers.resize(framesInFlight);
+	uniformBuffersMemory.resize(framesInFlight);
+	uniformBuffersMapped.resize(framesInFlight);
 
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	for (size_t i = 0; i < framesInFlight; ++i)
 	{
-		createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBuffers[i], uniformBuffersMemory[i]);
-		vkMapMemory(device, uniformBuffersMemory[i], 0, bufferSize, 0, &uniformBuffersMapped[i]);
+		createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, uniformBuffers[i], uniformBuffersMemory[i], MEMORY_CATEGORY_UNIFORM,
+						directUpload ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT : 0);
+		uniformBuffersMapped[i] = uniformBuffersMemory[i].mapped;
 	}
 }
 
@@ -1548,9 +2211,12 @@ void Screen::updateUniformBuffer(uint32_t currentImage)
 
 	ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
 	ubo.view = glm::lookAt(glm::vec3(5.0f, 5.0f, 5.0f), glm::vec3(0.0f, 0.0f, 0.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-	ubo.proj = glm::perspective(glm::radians(45.0f), swapChainExtent.width / static_cast<float>(swapChainExtent.height), 0.1f, 1000.0f);
+	// The depth of Vulkan is in [0, 1], GLM_FORCE_DEPTH_ZERO_TO_ONE is defined only in main.cpp, so the projection asks for it by name
+	ubo.proj = glm::perspectiveRH_ZO(glm::radians(45.0f), swapChainExtent.width / static_cast<float>(swapChainExtent.height), 0.1f, 1000.0f);
 	ubo.proj[1][1] *= -1;
 
+	// The culling and the level of detail selection of the scene use the matrices of the frame
+	frameUniforms = ubo;
 	memcpy(uniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
 }
 
@@ -1558,19 +2224,26 @@ void Screen::updateUniformBuffer(uint32_t currentImage)
 
 void Screen::createDescriptorPool()
 {
-	std::array<VkDescriptorPoolSize, 2> poolSizes{};
+	std::array<VkDescriptorPoolSize, 4> poolSizes{};
 	poolSizes[0].type = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER;
-	poolSizes[0].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	poolSizes[0].descriptorCount = static_cast<uint32_t>(framesInFlight);
+
+	poolSizes[1].type = VK_DESCRIPTOR_TYPE_SAMPLER;
+	poolSizes[1].descriptorCount = static_cast<uint32_t>(framesInFlight);
+
+	poolSizes[2].type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+	poolSizes[2].descriptorCount = static_cast<uint32_t>(framesInFlight);
 
-	poolSizes[1].type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
-	poolSizes[1].descriptorCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	poolSizes[3].type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	poolSizes[3].descriptorCount = static_cast<uint32_t>(framesInFlight) * maxBindlessTextures;
 		
 	VkDescriptorPoolCreateInfo poolInfo{};
 	poolInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
 	poolInfo.poolSizeCount = static_cast<uint32_t>(poolSizes.size());
 	poolInfo.pPoolSizes = poolSizes.data();
-	poolInfo.maxSets = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
-	poolInfo.flags = 0;
+	poolInfo.maxSets = static_cast<uint32_t>(framesInFlight);
+	// The sets of the layout with the update after bind binding are allocated only from such pool
+	poolInfo.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
 
 	if (vkCreateDescriptorPool(device, &poolInfo, nullptr, &descriptorPool) != VK_SUCCESS)
 	{
@@ -1582,33 +2255,44 @@ void Screen::createDescriptorPool()
 
 void Screen::createDescriptorSets()
 {
-	std::vector<VkDescriptorSetLayout> layouts(MAX_FRAMES_IN_FLIGHT, descriptorSetLayout);
+	std::vector<VkDescriptorSetLayout> layouts(framesInFlight, descriptorSetLayout);
+
+	// The size of the bindless texture array of each set
+	std::vector<uint32_t> textureCounts(framesInFlight, maxBindlessTextures);
+	VkDescriptorSetVariableDescriptorCountAllocateInfo countInfo{};
+	countInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO;
+	countInfo.descriptorSetCount = static_cast<uint32_t>(textureCounts.size());
+	countInfo.pDescriptorCounts = textureCounts.data();
 	
 	VkDescriptorSetAllocateInfo allocinfo{};
 	allocinfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+	allocinfo.pNext = &countInfo;
 	allocinfo.descriptorPool = descriptorPool;
-	allocinfo.descriptorSetCount = static_cast<uint32_t>(MAX_FRAMES_IN_FLIGHT);
+	allocinfo.descriptorSetCount = static_cast<uint32_t>(framesInFlight);
 	allocinfo.pSetLayouts = layouts.data();
 
-	descriptorSets.resize(MAX_FRAMES_IN_FLIGHT);
+	descriptorSets.resize(framesInFlight);
 	if (vkAllocateDescriptorSets(device, &allocinfo, descriptorSets.data()) != VK_SUCCESS)
 	{
 		throw std::runtime_error("ERROR::Screen::createDescriptorSets()::");
 	}
 
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
+	for (size_t i = 0; i < framesInFlight; ++i)
 	{
 		VkDescriptorBufferInfo bufferInfo{};
 		bufferInfo.buffer = uniformBuffers[i];
 		bufferInfo.offset = 0;
 		bufferInfo.range = sizeof(UniformBufferObject);
 
-		VkDescriptorImageInfo imageInfo{};
-		imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
-		imageInfo.imageView = textureImageView;
-		imageInfo.sampler = textureSampler;
+		VkDescriptorImageInfo samplerInfo{};
+		samplerInfo.sampler = textureSampler;
+
+		VkDescriptorBufferInfo objectBufferInfo{};
+		objectBufferInfo.buffer = objectBuffers[i];
+		objectBufferInfo.offset = 0;
+		objectBufferInfo.range = VK_WHOLE_SIZE;
 
-		std::array<VkWriteDescriptorSet, 2> descriptorWrites{};
+		std::array<VkWriteDescriptorSet, 3> descriptorWrites{};
 
 		descriptorWrites[0].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
 		descriptorWrites[0].dstSet = descriptorSets[i];
@@ -1624,60 +2308,188 @@ void Screen::createDescriptorSets()
 		descriptorWrites[1].dstSet = descriptorSets[i];
 		descriptorWrites[1].dstBinding = 1;
 		descriptorWrites[1].dstArrayElement = 0;
-		descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER;
+		descriptorWrites[1].descriptorType = VK_DESCRIPTOR_TYPE_SAMPLER;
 		descriptorWrites[1].descriptorCount = 1;
 		descriptorWrites[1].pBufferInfo = nullptr;
-		descriptorWrites[1].pImageInfo = &imageInfo;
+		descriptorWrites[1].pImageInfo = &samplerInfo;
 		descriptorWrites[1].pTexelBufferView = nullptr;
 
+		descriptorWrites[2].sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+		descriptorWrites[2].dstSet = descriptorSets[i];
+		descriptorWrites[2].dstBinding = 2;
+		descriptorWrites[2].dstArrayElement = 0;
+		descriptorWrites[2].descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+		descriptorWrites[2].descriptorCount = 1;
+		descriptorWrites[2].pBufferInfo = &objectBufferInfo;
+		descriptorWrites[2].pImageInfo = nullptr;
+		descriptorWrites[2].pTexelBufferView = nullptr;
+
 		vkUpdateDescriptorSets(device, static_cast<uint32_t>(descriptorWrites.size()), descriptorWrites.data(), 0, nullptr);
 	}
+
+	// The textures that were added before the sets existed
+	for (uint32_t i = 0; i < static_cast<uint32_t>(textures.size()); ++i)
+	{
+		for (uint32_t j = 0; j < static_cast<uint32_t>(descriptorSets.size()); ++j)
+		{
+			writeTextureDescriptor(i, j);
+		}
+	}
+	pendingTextureWrites.assign(framesInFlight, {});
 }
 
 
 
-void Screen::createTextureImage()
+BindlessTexture Screen::createTextureImage(const TextureData& texture, uint32_t firstLevel)
 {
-	int texWidth, texHeight, texChannels;
-	stbi_uc* pixels = stbi_load(TEXTURE_PATH.c_str(), &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-	VkDeviceSize imageSize = texWidth * texHeight * 4;
+	int texWidth = static_cast<int>(texture.width);
+	int texHeight = static_cast<int>(texture.height);
+	VkDeviceSize imageSize = static_cast<VkDeviceSize>(texWidth) * texHeight * 4;
+	// The image that was decoded straight into the staging ring is copied by the GPU from its region
+	bool staged = (texture.staged.size != 0);
+	const unsigned char* pixels = staged ? texture.staged.data : texture.pixels.data();
 
-	if (!pixels)
+	// The cooked texture brings its own levels, they are copied as they are
+	bool cooked = !texture.levels.empty();
+	BindlessTexture result{};
+	result.format = texture.format;
+	result.mipLevels = cooked ? static_cast<uint32_t>(texture.levels.size()) - firstLevel : MipGenerator::levelCount(texture.width, texture.height);
+	std::vector<MipLevel> levels;
+	if (cooked)
 	{
-		throw std::runtime_error("ERROR::Screen::createTextureImage()::Failed to load texture image");
+		// The image starts from firstLevel, so the offsets of the levels are moved to the start of its data
+		const MipLevel& first = texture.levels[firstLevel];
+		texWidth = static_cast<int>(first.width);
+		texHeight = static_cast<int>(first.height);
+		imageSize = texture.pixels.size() - first.offset;
+		pixels += first.offset;
+		for (size_t i = firstLevel; i < texture.levels.size(); ++i)
+		{
+			levels.push_back(MipLevel{ texture.levels[i].offset - first.offset, texture.levels[i].width, texture.levels[i].height });
+		}
 	}
 
-	mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(texWidth, texHeight)))) + 1;
-
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
+	// The GPU builds the levels by the blits when the format can be filtered linearly, otherwise the whole chain is built on the CPU
+	bool blitMipmaps = !cooked && supportsLinearBlit(result.format);
+	std::vector<unsigned char> mipChain;
+	if (!cooked && !blitMipmaps)
+	{
+		MipGenerator generator(threadPool);
+		generator.generate(pixels, texture.width, texture.height, texture.format == VK_FORMAT_R8G8B8A8_SRGB, mipChain, levels);
+		imageSize = mipChain.size();
+	}
 
-	createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, 
-					VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, 
-					stagingBuffer, stagingBufferMemory);
-	void* data;
-	vkMapMemory(device, stagingBufferMemory, 0, imageSize, 0, &data);
-	memcpy(data, pixels, static_cast<size_t>(imageSize));
-	vkUnmapMemory(device, stagingBufferMemory);
+	// The image that was decoded into the ring isn't needed after the mip chain is built from it on the CPU
+	if (staged && !mipChain.empty())
+	{
+		stagingRing.release(texture.staged);
+	}
 
-	stbi_image_free(pixels);
-	createImage(texWidth, texHeight, mipLevels, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL, 
+	createImage(texWidth, texHeight, result.mipLevels, result.format, VK_IMAGE_TILING_OPTIMAL, 
 					VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, 
-					VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, textureImage, textureImageMemory);
+					VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, result.image, result.memory, MEMORY_CATEGORY_TEXTURE);
 
-	transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, mipLevels);
-	copyBufferToImage(stagingBuffer, textureImage, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight));
+	// The copies go to the upload batch of the transfer queue, the render loop doesn't wait for them
+	beginUploadBatch();
 
-	transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, mipLevels);
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.image = result.image;
+	barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, result.mipLevels, 0, 1 };
+	uploadBatch.preBarriers.push_back(barrier);
 
-	vkDestroyBuffer(device, stagingBuffer, nullptr);
-	vkFreeMemory(device, stagingBufferMemory, nullptr);
+	if (staged && mipChain.empty())
+	{
+		// The GPU copies the image from its region of the ring, the region is reclaimed when the copy is finished
+		stagingRing.retire(texture.staged, uploadSubmission + 1);
+		copyBufferToImage(result.image, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight), texture.staged.offset);
+	}
+	else
+	{
+		// The data is copied through the staging ring in chunks, the blits need only the first level
+		if (blitMipmaps)
+		{
+			levels = { MipLevel{ 0, static_cast<uint32_t>(texWidth), static_cast<uint32_t>(texHeight) } };
+		}
+		stageToImage(result.image, result.format, mipChain.empty() ? pixels : mipChain.data(), levels);
+	}
+
+	UploadAcquire acquire{ VK_NULL_HANDLE, 0, 0, result.image, result.mipLevels, blitMipmaps, static_cast<int32_t>(texWidth), static_cast<int32_t>(texHeight) };
+	if (transferFamily == graphicsFamily)
+	{
+		// The queue of the upload can blit, the image leaves it ready for the shaders
+		if (blitMipmaps)
+		{
+			uploadBatch.acquires.push_back(acquire);
+		}
+		else
+		{
+			barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+			barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+			uploadBatch.imageBarriers.push_back(barrier);
+		}
+	}
+	else
+	{
+		// The transfer queue releases the image to the graphics family, the next frame acquires it with the same layouts
+		/// The image for the blits stays in VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, the frame builds its levels after the acquire
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = blitMipmaps ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = 0;
+		barrier.srcQueueFamilyIndex = transferFamily;
+		barrier.dstQueueFamilyIndex = graphicsFamily;
+		uploadBatch.imageBarriers.push_back(barrier);
+		uploadBatch.acquires.push_back(acquire);
+	}
+
+	endUploadBatch();
+
+	if (enableValidationLayers)
+	{
+		std::cout << "--Texture: " << texWidth << "x" << texHeight << " format: " << result.format << " levels: " << result.mipLevels <<
+			" upload bytes: " << imageSize << std::endl;
+	}
+
+	return result;
+}
+
+
+
+uint32_t Screen::addTexture(const TextureData& texture, uint32_t firstLevel)
+{
+	if (textures.size() >= maxBindlessTextures)
+	{
+		throw std::runtime_error("ERROR::Screen::addTexture()::The bindless texture array is full");
+	}
+
+	BindlessTexture bindless = createTextureImage(texture, firstLevel);
+	createTextureImageView(bindless);
+
+	uint32_t index = static_cast<uint32_t>(textures.size());
+	textures.emplace_back(bindless);
+	textureSources.resize(textures.size());
+	// The sets don't exist yet for the placeholder, createDescriptorSets() writes it
+	for (uint32_t i = 0; i < static_cast<uint32_t>(descriptorSets.size()); ++i)
+	{
+		writeTextureDescriptor(index, i);
+	}
+	return index;
 }
 
 
 
 void Screen::createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling,
-							VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory)
+							VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, GpuAllocation& imageMemory,
+							MemoryCategory category)
 {
 	VkImageCreateInfo imageInfo{};
 	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -1700,20 +2512,26 @@ void Screen::createImage(uint32_t width, uint32_t height, uint32_t mipLevels, Vk
 		throw std::runtime_error("ERROR::Screen::createImage()::Failed to create the Textur image");
 	}
 
-	VkMemoryRequirements memRequirements;
-	vkGetImageMemoryRequirements(device, image, &memRequirements);
+	// The attachments are usually preferred in their own allocation by the driver
+	VkMemoryDedicatedRequirements dedicatedRequirements{};
+	dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+	VkMemoryRequirements2 memRequirements{};
+	memRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+	memRequirements.pNext = &dedicatedRequirements;
+	VkImageMemoryRequirementsInfo2 requirementsInfo{};
+	requirementsInfo.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+	requirementsInfo.image = image;
+	vkGetImageMemoryRequirements2(device, &requirementsInfo, &memRequirements);
 
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
+	VkMemoryDedicatedAllocateInfo dedicatedInfo{};
+	dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+	dedicatedInfo.image = image;
+	bool dedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
 
-	if (vkAllocateMemory(device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS)
-	{
-		throw std::runtime_error("ERROR::Screen::createImage()::Failed to allocate Image memory");
-	}
+	uint32_t memoryType = findMemoryType(memRequirements.memoryRequirements.memoryTypeBits, properties);
+	imageMemory = gpuAllocator.allocate(memRequirements.memoryRequirements, memoryType, tiling == VK_IMAGE_TILING_LINEAR, dedicated ? &dedicatedInfo : nullptr, category);
 
-	vkBindImageMemory(device, image, imageMemory, 0);
+	vkBindImageMemory(device, image, imageMemory.memory, imageMemory.offset);
 }
 
 
@@ -1749,11 +2567,12 @@ void Screen::endSingleTimeCommands(VkCommandBuffer commandBuffer, VkQueue queue)
 	submitInfo.commandBufferCount = 1;
 	submitInfo.pCommandBuffers = &commandBuffer;
 
-	vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
-	vkQueueWaitIdle(queue);
+	// Only this submission is waited for, the frames on the queue keep running
+	vkResetFences(device, 1, &uploadFence);
+	vkQueueSubmit(queue, 1, &submitInfo, uploadFence);
+	vkWaitForFences(device, 1, &uploadFence, VK_TRUE, UINT64_MAX);
 
 	vkFreeCommandBuffers(device, commandPool, 1, &commandBuffer);
-
 }
 
 
@@ -1826,13 +2645,10 @@ void Screen::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout
 
 
 
-void Screen::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
+void Screen::copyBufferToImage(VkImage image, uint32_t width, uint32_t height, VkDeviceSize offset)
 {
-	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-	
 	VkBufferImageCopy region{};
-	region.bufferOffset = 0;
+	region.bufferOffset = offset;
 	region.bufferRowLength = 0;
 	region.bufferImageHeight = 0;
 
@@ -1844,17 +2660,14 @@ void Screen::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, u
 	region.imageOffset = { 0, 0, 0 };
 	region.imageExtent = { width, height,1 };
 
-	vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-	endSingleTimeCommands(commandBuffer, graphicsQueue);
-
+	uploadBatch.imageCopies.push_back({ image, region });
 }
 
 
 
-void Screen::createTextureImageView()
+void Screen::createTextureImageView(BindlessTexture& texture)
 {
-	textureImageView = createImageView(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT, mipLevels);
+	texture.view = createImageView(texture.image, texture.format, VK_IMAGE_ASPECT_COLOR_BIT, texture.mipLevels);
 }
 
 
@@ -1868,9 +2681,9 @@ VkImageView Screen::createImageView(VkImage image, VkFormat format, VkImageAspec
 	viewInfo.format = format;
 	viewInfo.subresourceRange.aspectMask = aspectFlags;
 	viewInfo.subresourceRange.baseMipLevel = 0;
-	viewInfo.subresourceRange.levelCount = 1;
+	viewInfo.subresourceRange.levelCount = mipLevels;
 	viewInfo.subresourceRange.baseArrayLayer = 0;
-	viewInfo.subresourceRange.layerCount = mipLevels;
+	viewInfo.subresourceRange.layerCount = 1;
 
 	VkImageView imageView;
 	if (vkCreateImageView(device, &viewInfo, nullptr, &imageView) != VK_SUCCESS)
@@ -1902,8 +2715,9 @@ void Screen::createTextureSampler()
 
 	samplerInfo.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR;
 	samplerInfo.mipLodBias = 0.0f;
+	// The sampler is shared by the textures with the different number of levels, so the range is limited by their views
 	samplerInfo.minLod = 0.0f;
-	samplerInfo.maxLod = 0.0f;
+	samplerInfo.maxLod = VK_LOD_CLAMP_NONE;
 
 	if (vkCreateSampler(device, &samplerInfo, nullptr, &textureSampler) != VK_SUCCESS)
 	{
@@ -1913,176 +2727,1333 @@ void Screen::createTextureSampler()
 
 
 
-void Screen::createDepthResources()
+bool Screen::supportsLinearBlit(VkFormat format)
 {
-	VkFormat depthFormat = findDepthFormat();
+	VkFormatProperties props;
+	vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
 
-	createImage(swapChainExtent.width, swapChainExtent.height, 1, depthFormat, VK_IMAGE_TILING_OPTIMAL,
-		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthMemory);
+	VkFormatFeatureFlags required = VK_FORMAT_FEATURE_BLIT_SRC_BIT | VK_FORMAT_FEATURE_BLIT_DST_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT;
+	return (props.optimalTilingFeatures & required) == required;
+}
 
-	depthImageView = createImageView(depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
 
-	transitionImageLayout(depthImage, depthFormat, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, 1);
 
+void Screen::generateMipmaps(VkCommandBuffer commandBuffer, VkImage image, int32_t texWidth, int32_t texHeight, uint32_t mipLevels)
+{
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.image = image;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+	barrier.subresourceRange.levelCount = 1;
+
+	int32_t mipWidth = texWidth;
+	int32_t mipHeight = texHeight;
+
+	for (uint32_t i = 1; i < mipLevels; ++i)
+	{
+		// The previous level is written by the copy or the blit, it becomes the source of this level
+		barrier.subresourceRange.baseMipLevel = i - 1;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		int32_t nextWidth = (mipWidth > 1) ? mipWidth / 2 : 1;
+		int32_t nextHeight = (mipHeight > 1) ? mipHeight / 2 : 1;
+
+		VkImageBlit blit{};
+		blit.srcOffsets[0] = { 0, 0, 0 };
+		blit.srcOffsets[1] = { mipWidth, mipHeight, 1 };
+		blit.srcSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.srcSubresource.mipLevel = i - 1;
+		blit.srcSubresource.baseArrayLayer = 0;
+		blit.srcSubresource.layerCount = 1;
+		blit.dstOffsets[0] = { 0, 0, 0 };
+		blit.dstOffsets[1] = { nextWidth, nextHeight, 1 };
+		blit.dstSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+		blit.dstSubresource.mipLevel = i;
+		blit.dstSubresource.baseArrayLayer = 0;
+		blit.dstSubresource.layerCount = 1;
+
+		vkCmdBlitImage(commandBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &blit, VK_FILTER_LINEAR);
+
+		// The source level isn't needed by the next blits, it's ready for the shaders
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL;
+		barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		mipWidth = nextWidth;
+		mipHeight = nextHeight;
+	}
+
+	// The last level is only written by the blit
+	barrier.subresourceRange.baseMipLevel = mipLevels - 1;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 0, nullptr, 1, &barrier);
 }
 
 
 
-VkFormat Screen::findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features)
+void Screen::stageToImage(VkImage image, VkFormat format, const unsigned char* data, const std::vector<MipLevel>& levels)
 {
-	for (VkFormat format : candidates)
+	uint32_t blockBytes, blockExtent;
+	if (!Ktx2Loader::formatBlock(format, blockBytes, blockExtent))
 	{
-		VkFormatProperties props;
-		vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+		throw std::runtime_error("ERROR::Screen::stageToImage()::Unsupported texture format");
+	}
 
-		if (tiling == VK_IMAGE_TILING_LINEAR && (props.linearTilingFeatures & features) == features)
-		{
-			return format;
-		}
-		else if (tiling == VK_IMAGE_TILING_OPTIMAL && (props.optimalTilingFeatures & features) == features)
+	for (size_t i = 0; i < levels.size(); ++i)
+	{
+		// The rows of the blocks, the compressed formats are copied by the rows of 4x4 blocks
+		uint32_t blockRows = (levels[i].height + blockExtent - 1) / blockExtent;
+		VkDeviceSize rowSize = static_cast<VkDeviceSize>((levels[i].width + blockExtent - 1) / blockExtent) * blockBytes;
+		uint32_t chunkRows = static_cast<uint32_t>(std::max<VkDeviceSize>(STAGING_CHUNK_SIZE / rowSize, 1));
+
+		for (uint32_t row = 0; row < blockRows; row += chunkRows)
 		{
-			return format;
+			uint32_t rows = std::min(chunkRows, blockRows - row);
+			StagingRegion region;
+			reserveStaging(rows * rowSize, std::max(blockBytes, 4u), region);
+			memcpy(region.data, data + levels[i].offset + row * rowSize, static_cast<size_t>(rows * rowSize));
+
+			VkBufferImageCopy copy{};
+			copy.bufferOffset = region.offset;
+			copy.bufferRowLength = 0;
+			copy.bufferImageHeight = 0;
+
+			copy.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+			copy.imageSubresource.mipLevel = static_cast<uint32_t>(i);
+			copy.imageSubresource.baseArrayLayer = 0;
+			copy.imageSubresource.layerCount = 1;
+
+			// The last chunk ends at the edge of the level, which isn't a multiple of the block for the small levels
+			uint32_t y = row * blockExtent;
+			copy.imageOffset = { 0, static_cast<int32_t>(y), 0 };
+			copy.imageExtent = { levels[i].width, std::min(rows * blockExtent, levels[i].height - y), 1 };
+
+			uploadBatch.imageCopies.push_back({ image, copy });
+			stagingRing.retire(region, uploadSubmission + 1);
 		}
-		
-		throw std::runtime_error("ERROR::Screen::findSupportedFormat()::Failed ti find supported format");
 	}
 }
 
 
 
-VkFormat Screen::findDepthFormat()
+std::string Screen::chooseTexturePath()
 {
-	return findSupportedFormat(
-								{VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
-								VK_IMAGE_TILING_OPTIMAL,
-								VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
-	);
-}
-
+	VkFormat cookedFormat = Ktx2Loader::readFormat(COOKED_TEXTURE_PATH);
+	if (cookedFormat == VK_FORMAT_UNDEFINED)
+	{
+		return TEXTURE_PATH;
+	}
 
+	// The BC formats need the feature of the device, which createLogicalDevice() enables when it's supported
+	VkPhysicalDeviceFeatures supportedFeatures;
+	vkGetPhysicalDeviceFeatures(physicalDevice, &supportedFeatures);
+	if (Ktx2Loader::isBlockCompressed(cookedFormat) && supportedFeatures.textureCompressionBC != VK_TRUE)
+	{
+		return TEXTURE_PATH;
+	}
 
-bool Screen::hasStencilComponent(VkFormat format)
-{
-	return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
+	// The RGBA8 format is the fallback candidate, every device can sample it
+	VkFormat format = findSupportedFormat({ cookedFormat, VK_FORMAT_R8G8B8A8_SRGB }, VK_IMAGE_TILING_OPTIMAL,
+											VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_SAMPLED_IMAGE_FILTER_LINEAR_BIT);
+	return (format == cookedFormat) ? COOKED_TEXTURE_PATH : TEXTURE_PATH;
 }
 
 
 
-void Screen::loadModel()
+void Screen::createStagingRing()
 {
-	tinyobj::attrib_t attrib;
-	std::vector<tinyobj::shape_t> shapes;
-	std::vector<tinyobj::material_t> materials;
-	std::string warn, err;
+	// The buffer stays mapped until the cleanup, the workers decode the images straight into its regions
+	createBuffer(STAGING_SIZE, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
+					stagingBuffer, stagingMemory, MEMORY_CATEGORY_STAGING);
+	stagingRing.reset(stagingMemory.mapped, STAGING_SIZE);
 
-	if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, MODEL_PATH.c_str())) {
-		throw std::runtime_error(warn + err);
+	VkFenceCreateInfo fenceInfo{};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	if (vkCreateFence(device, &fenceInfo, nullptr, &uploadFence) != VK_SUCCESS)
+	{
+		throw std::runtime_error("ERROR::Screen::createStagingRing()::Failed to create the upload fence");
 	}
 
-	std::unordered_map<Vertex, uint32_t> uniqueVertices{};
-
-	for (const auto& shape : shapes) {
-		for (const auto& index : shape.mesh.indices) {
-			Vertex vertex{};
-
-			vertex.pos = {
-				attrib.vertices[3 * index.vertex_index + 0],
-				attrib.vertices[3 * index.vertex_index + 1],
-				attrib.vertices[3 * index.vertex_index + 2]
-			};
+	// The value of the semaphore is the number of the last finished upload
+	VkSemaphoreTypeCreateInfo typeInfo{};
+	typeInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+	typeInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+	typeInfo.initialValue = 0;
+	VkSemaphoreCreateInfo semaphoreInfo{};
+	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+	semaphoreInfo.pNext = &typeInfo;
+	if (vkCreateSemaphore(device, &semaphoreInfo, nullptr, &uploadTimeline) != VK_SUCCESS)
+	{
+		throw std::runtime_error("ERROR::Screen::createStagingRing()::Failed to create the upload timeline semaphore");
+	}
+	uploadSubmission = 0;
+	uploadBatch.depth = 0;
+}
 
-			vertex.texCoord = {
-				attrib.texcoords[2 * index.texcoord_index + 0],
-				1.0f - attrib.texcoords[2 * index.texcoord_index + 1]
-			};
 
-			vertex.color = { 1.0f, 1.0f, 1.0f };
 
-			if (uniqueVertices.count(vertex) == 0) {
-				uniqueVertices[vertex] = static_cast<uint32_t>(vertices.size());
-				vertices.push_back(vertex);
-			}
+void Screen::reserveStaging(VkDeviceSize size, VkDeviceSize alignment, StagingRegion& region)
+{
+	if (stagingRing.reserve(size, alignment, region))
+	{
+		return;
+	}
 
-			indices.push_back(uniqueVertices[vertex]);
-		}
+	// The ring is taken by the copies of the batch that aren't submitted, they are submitted and the batch collects the next copies
+	flushUploadBatch();
+	collectUploads();
+	if (stagingRing.reserve(size, alignment, region))
+	{
+		return;
 	}
 
+	// The whole ring is taken by the uploads in flight, it's the only case when the CPU waits for the transfer queue
+	waitUploads(uploadSubmission);
+	if (!stagingRing.reserve(size, alignment, region))
+	{
+		throw std::runtime_error("ERROR::Screen::reserveStaging()::The staging ring is taken by the decoded images");
+	}
 }
 
 
 
-void Screen::performInitialRotation()
+VkCommandBuffer Screen::beginUpload()
 {
-	hasRotated = false;
-	if (!hasRotated)
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandPool = commandPoolTransfer;
+	allocInfo.commandBufferCount = 1;
+
+	VkCommandBuffer commandBuffer;
+	if (vkAllocateCommandBuffers(device, &allocInfo, &commandBuffer) != VK_SUCCESS)
 	{
-		UniformBufferObject ubo{};
-		ubo.model = glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
-		
-		memcpy(uniformBuffersMapped[0], &ubo, sizeof(ubo));
-		hasRotated = true;
+		throw std::runtime_error("ERROR::Screen::beginUpload()::Failed to allocate the upload Command Buffer");
 	}
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	vkBeginCommandBuffer(commandBuffer, &beginInfo);
+
+	return commandBuffer;
 }
 
 
 
-void Screen::resizeWindow(int width, int height)
+void Screen::submitUpload(VkCommandBuffer commandBuffer)
 {
-	if (width < 100 || height < 100)
-	{
-		throw std::invalid_argument("ERROR::Screen::set_Window()- width or height less then 100");
-	}
-	else
+	vkEndCommandBuffer(commandBuffer);
+
+	// The submission signals the next value, the frames and reclaim() compare it with the value of the semaphore
+	uint64_t signalValue = ++uploadSubmission;
+	VkTimelineSemaphoreSubmitInfo timelineInfo{};
+	timelineInfo.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+	timelineInfo.signalSemaphoreValueCount = 1;
+	timelineInfo.pSignalSemaphoreValues = &signalValue;
+
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.pNext = &timelineInfo;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &commandBuffer;
+	submitInfo.signalSemaphoreCount = 1;
+	submitInfo.pSignalSemaphores = &uploadTimeline;
+
+	if (vkQueueSubmit(transferQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
 	{
-		SDL_SetWindowSize(window,width, height);
+		throw std::runtime_error("ERROR::Screen::submitUpload()::Failed to submit the upload Command Buffer");
 	}
+	uploadsInFlight.push_back(UploadSubmission{ commandBuffer, signalValue });
 }
 
 
 
-void Screen::cleanup()
+void Screen::collectUploads()
 {
-	if (enableValidationLayers) 
+	uint64_t completed = 0;
+	vkGetSemaphoreCounterValue(device, uploadTimeline, &completed);
+
+	// The uploads finish in the order of their submission
+	size_t finished = 0;
+	while (finished < uploadsInFlight.size() && uploadsInFlight[finished].value <= completed)
 	{
-		DestroyDebugUtilsMessengerEXT(instanceVK, debugMessenger, nullptr);
+		vkFreeCommandBuffers(device, commandPoolTransfer, 1, &uploadsInFlight[finished].commandBuffer);
+		++finished;
 	}
+	uploadsInFlight.erase(uploadsInFlight.begin(), uploadsInFlight.begin() + finished);
 
-	cleanupSwapChain();
+	stagingRing.reclaim(completed);
+}
 
-	vkDestroySampler(device, textureSampler, nullptr);
-	vkDestroyImageView(device, textureImageView, nullptr);
-	vkDestroyImage(device, textureImage, nullptr);
-	vkFreeMemory(device, textureImageMemory, nullptr);
 
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; ++i)
-	{
-		vkDestroyBuffer(device, uniformBuffers[i], nullptr);
-		vkFreeMemory(device, uniformBuffersMemory[i], nullptr);
-	}
 
-	vkDestroyDescriptorPool(device, descriptorPool, nullptr);
-	vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+void Screen::waitUploads(uint64_t value)
+{
+	VkSemaphoreWaitInfo waitInfo{};
+	waitInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO;
+	waitInfo.semaphoreCount = 1;
+	waitInfo.pSemaphores = &uploadTimeline;
+	waitInfo.pValues = &value;
+	vkWaitSemaphores(device, &waitInfo, UINT64_MAX);
 
-	vkDestroyBuffer(device, indexBuffer, nullptr);
-	vkFreeMemory(device, indexBufferMemory, nullptr);
+	collectUploads();
+}
 
-	vkDestroyBuffer(device, vertexBuffer, nullptr);
-	vkFreeMemory(device, vertexBufferMemory, nullptr);
 
-	for (size_t i{}; i < MAX_FRAMES_IN_FLIGHT; ++i)
-	{
-		vkDestroySemaphore(device, imageAvailableSemaphore[i], nullptr);
-		vkDestroySemaphore(device, renderFinishedSemaphore[i], nullptr);
-		vkDestroyFence(device, inFlightFence[i], nullptr);
-	}
-	vkDestroyCommandPool(device, commandPool, nullptr);
 
-	//for (auto framebuffer : swapChainFramebuffers)
-	//{
+void Screen::recordUploadAcquires(VkCommandBuffer commandBuffer)
+{
+	// Each acquire repeats the release of the transfer queue, the stage of the barrier is the stage where the frame waits for the upload
+	for (const UploadAcquire& acquire : pendingAcquires)
+	{
+		if (acquire.buffer != VK_NULL_HANDLE)
+		{
+			VkBufferMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			barrier.srcAccessMask = 0;
+			barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_INDEX_READ_BIT;
+			barrier.srcQueueFamilyIndex = transferFamily;
+			barrier.dstQueueFamilyIndex = graphicsFamily;
+			barrier.buffer = acquire.buffer;
+			barrier.offset = acquire.offset;
+			barrier.size = acquire.size;
+			vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+			continue;
+		}
+
+		VkImageMemoryBarrier barrier{};
+		barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+		barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+		barrier.newLayout = acquire.generateMips ? VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL : VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+		barrier.srcAccessMask = 0;
+		barrier.dstAccessMask = acquire.generateMips ? VK_ACCESS_TRANSFER_READ_BIT | VK_ACCESS_TRANSFER_WRITE_BIT : VK_ACCESS_SHADER_READ_BIT;
+		barrier.srcQueueFamilyIndex = transferFamily;
+		barrier.dstQueueFamilyIndex = graphicsFamily;
+		barrier.image = acquire.image;
+		barrier.subresourceRange = { VK_IMAGE_ASPECT_COLOR_BIT, 0, acquire.mipLevels, 0, 1 };
+		VkPipelineStageFlags stage = acquire.generateMips ? VK_PIPELINE_STAGE_TRANSFER_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		vkCmdPipelineBarrier(commandBuffer, stage, stage, 0, 0, nullptr, 0, nullptr, 1, &barrier);
+
+		if (acquire.generateMips)
+		{
+			generateMipmaps(commandBuffer, acquire.image, acquire.width, acquire.height, acquire.mipLevels);
+		}
+	}
+	pendingAcquires.clear();
+}
+
+
+
+void Screen::beginUploadBatch()
+{
+	++uploadBatch.depth;
+}
+
+
+
+void Screen::endUploadBatch()
+{
+	if (--uploadBatch.depth == 0)
+	{
+		flushUploadBatch();
+	}
+}
+
+
+
+void Screen::flushUploadBatch()
+{
+	UploadBatch& batch = uploadBatch;
+	if (batch.preBarriers.empty() && batch.bufferCopies.empty() && batch.imageCopies.empty() && batch.bufferBarriers.empty() && batch.imageBarriers.empty() &&
+		batch.acquires.empty())
+	{
+		return;
+	}
+
+	VkCommandBuffer commandBuffer = beginUpload();
+
+	// All new images become the destinations of the copies by one barrier
+	if (!batch.preBarriers.empty())
+	{
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 0, nullptr,
+								static_cast<uint32_t>(batch.preBarriers.size()), batch.preBarriers.data());
+	}
+
+	// The copies to the same destination that follow each other are one command with many regions
+	std::vector<VkBufferCopy> bufferRegions;
+	for (size_t i = 0; i < batch.bufferCopies.size(); ++i)
+	{
+		bufferRegions.push_back(batch.bufferCopies[i].second);
+		if (i + 1 == batch.bufferCopies.size() || batch.bufferCopies[i + 1].first != batch.bufferCopies[i].first)
+		{
+			vkCmdCopyBuffer(commandBuffer, stagingBuffer, batch.bufferCopies[i].first, static_cast<uint32_t>(bufferRegions.size()), bufferRegions.data());
+			bufferRegions.clear();
+		}
+	}
+	std::vector<VkBufferImageCopy> imageRegions;
+	for (size_t i = 0; i < batch.imageCopies.size(); ++i)
+	{
+		imageRegions.push_back(batch.imageCopies[i].second);
+		if (i + 1 == batch.imageCopies.size() || batch.imageCopies[i + 1].first != batch.imageCopies[i].first)
+		{
+			vkCmdCopyBufferToImage(commandBuffer, stagingBuffer, batch.imageCopies[i].first, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+									static_cast<uint32_t>(imageRegions.size()), imageRegions.data());
+			imageRegions.clear();
+		}
+	}
+
+	// The finished resources are released to the graphics family or made ready for the shaders by one barrier
+	if (!batch.bufferBarriers.empty() || !batch.imageBarriers.empty())
+	{
+		VkPipelineStageFlags dstStage = (transferFamily != graphicsFamily) ? VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT : VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+		vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, dstStage, 0, 0, nullptr,
+								static_cast<uint32_t>(batch.bufferBarriers.size()), batch.bufferBarriers.data(),
+								static_cast<uint32_t>(batch.imageBarriers.size()), batch.imageBarriers.data());
+	}
+
+	if (transferFamily != graphicsFamily)
+	{
+		pendingAcquires.insert(pendingAcquires.end(), batch.acquires.begin(), batch.acquires.end());
+	}
+	else
+	{
+		for (const UploadAcquire& acquire : batch.acquires)
+		{
+			generateMipmaps(commandBuffer, acquire.image, acquire.width, acquire.height, acquire.mipLevels);
+		}
+	}
+
+	submitUpload(commandBuffer);
+
+	batch.preBarriers.clear();
+	batch.bufferCopies.clear();
+	batch.imageCopies.clear();
+	batch.bufferBarriers.clear();
+	batch.imageBarriers.clear();
+	batch.acquires.clear();
+}
+
+
+
+void Screen::writeTextureDescriptor(uint32_t index, uint32_t frame)
+{
+	// The sampler is in the binding 1, the element of the array has only the image
+	VkDescriptorImageInfo imageInfo{};
+	imageInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	imageInfo.imageView = textures[index].view;
+	imageInfo.sampler = VK_NULL_HANDLE;
+
+	VkWriteDescriptorSet descriptorWrite{};
+	descriptorWrite.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+	descriptorWrite.dstSet = descriptorSets[frame];
+	descriptorWrite.dstBinding = 3;
+	descriptorWrite.dstArrayElement = index;
+	descriptorWrite.descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE;
+	descriptorWrite.descriptorCount = 1;
+	descriptorWrite.pImageInfo = &imageInfo;
+
+	vkUpdateDescriptorSets(device, 1, &descriptorWrite, 0, nullptr);
+}
+
+
+
+bool Screen::setTextureResidency(const TextureResidency& change)
+{
+	// The new image has only the resident levels, so its view starts from the finest one and the sampler can't reach the missing levels
+	uint32_t index = change.texture;
+	BindlessTexture texture{};
+	try
+	{
+		texture = createTextureImage(textureSources[index], change.level);
+		createTextureImageView(texture);
+	}
+	catch (const std::exception& ex)
+	{
+		// The texture keeps the levels of its old image
+		std::cerr << ex.what() << std::endl;
+		textureStreamer.restore(change);
+		return false;
+	}
+
+	// The frames in flight still sample the old image, it's kept until they and the frame that is prepared now are finished
+	retiredTextures.emplace_back(textures[index], frameSubmission + 1);
+	textures[index] = texture;
+
+	for (std::vector<uint32_t>& writes : pendingTextureWrites)
+	{
+		writes.push_back(index);
+	}
+
+	if (enableValidationLayers)
+	{
+		std::cout << "--Texture streaming: texture " << index << (change.evicted ? " evicted to level " : " loaded to level ") <<
+			change.level << " resident bytes: " << textureStreamer.residentBytes() << " / " << textureStreamer.getBudget() << std::endl;
+	}
+	return true;
+}
+
+
+
+void Screen::updateTextureStreaming(uint32_t currentImage)
+{
+	// The set of the frame isn't used by the GPU after its previous frame is finished, so the elements that were replaced are written now
+	for (uint32_t index : pendingTextureWrites[currentImage])
+	{
+		writeTextureDescriptor(index, currentImage);
+	}
+	pendingTextureWrites[currentImage].clear();
+
+	// The images whose frame is finished by the GPU aren't used by any set or frame
+	for (size_t i = 0; i < retiredTextures.size();)
+	{
+		if (!isFrameComplete(retiredTextures[i].second))
+		{
+			++i;
+			continue;
+		}
+
+		BindlessTexture& texture = retiredTextures[i].first;
+		vkDestroyImageView(device, texture.view, nullptr);
+		vkDestroyImage(device, texture.image, nullptr);
+		gpuAllocator.free(texture.memory);
+		retiredTextures.erase(retiredTextures.begin() + i);
+	}
+
+	// The requests were made by updateSceneDraws() of this frame
+	/// The evictions come before the load they make the room for, they are applied only after the image of the load is created,
+	/// so the texture that fails to load doesn't cost the levels of the others
+	std::vector<TextureResidency> changes = textureStreamer.update();
+	size_t firstEviction = 0;
+	for (size_t i = 0; i < changes.size(); ++i)
+	{
+		if (changes[i].evicted)
+		{
+			continue;
+		}
+
+		// The failed load gives the levels back in the reverse order, the texture evicted twice ends with its first level
+		if (setTextureResidency(changes[i]))
+		{
+			for (size_t j = firstEviction; j < i; ++j)
+			{
+				setTextureResidency(changes[j]);
+			}
+		}
+		else
+		{
+			for (size_t j = i; j > firstEviction; --j)
+			{
+				textureStreamer.restore(changes[j - 1]);
+			}
+		}
+		firstEviction = i + 1;
+	}
+
+	// The new elements are used by this frame already
+	for (uint32_t index : pendingTextureWrites[currentImage])
+	{
+		writeTextureDescriptor(index, currentImage);
+	}
+	pendingTextureWrites[currentImage].clear();
+}
+
+
+
+void Screen::createDepthResources()
+{
+	VkFormat depthFormat = findDepthFormat();
+
+	createImage(swapChainExtent.width, swapChainExtent.height, 1, depthFormat, VK_IMAGE_TILING_OPTIMAL,
+		VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, depthImage, depthMemory, MEMORY_CATEGORY_ATTACHMENT);
+
+	depthImageView = createImageView(depthImage, depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT, 1);
+
+	// The layout isn't changed by the separate submission, the render pass moves the image from VK_IMAGE_LAYOUT_UNDEFINED when it clears it
+}
+
+
+
+VkFormat Screen::findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features)
+{
+	for (VkFormat format : candidates)
+	{
+		VkFormatProperties props;
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, format, &props);
+
+		if (tiling == VK_IMAGE_TILING_LINEAR && (props.linearTilingFeatures & features) == features)
+		{
+			return format;
+		}
+		else if (tiling == VK_IMAGE_TILING_OPTIMAL && (props.optimalTilingFeatures & features) == features)
+		{
+			return format;
+		}
+	}
+
+	throw std::runtime_error("ERROR::Screen::findSupportedFormat()::Failed ti find supported format");
+}
+
+
+
+VkFormat Screen::findDepthFormat()
+{
+	return findSupportedFormat(
+								{VK_FORMAT_D32_SFLOAT, VK_FORMAT_D32_SFLOAT_S8_UINT, VK_FORMAT_D24_UNORM_S8_UINT},
+								VK_IMAGE_TILING_OPTIMAL,
+								VK_FORMAT_FEATURE_DEPTH_STENCIL_ATTACHMENT_BIT
+	);
+}
+
+
+
+bool Screen::hasStencilComponent(VkFormat format)
+{
+	return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
+}
+
+
+
+void Screen::loadModel(const std::string& modelPath, MeshCache& cache)
+{
+	// Mapping the mesh that was cooked by AssetCooker or saved on the previous run
+	std::string cachePath = modelPath + MESH_CACHE_EXTENSION;
+	MeshCooker cooker(threadPool, meshCookSettings());
+	if (cache.open(cachePath, modelPath, cooker.cacheFlags()))
+	{
+		// The cache is rebuilt when the saved layout was changed or can't be read by this device
+		VertexLayout cachedLayout = static_cast<VertexLayout>(cache.vertexLayout());
+		if (cachedLayout < VERTEX_LAYOUT_COUNT &&
+			getVertexLayoutInfo(cachedLayout).stride == cache.getHeader().vertexStride &&
+			isVertexLayoutSupported(cachedLayout))
+		{
+			if (enableValidationLayers)
+			{
+				std::cout << "--Mesh cache: " << cachePath << " vertices: " << cache.vertexCount() <<
+					" indices: " << cache.indexCount() << std::endl;
+			}
+			return;
+		}
+		cache.close();
+	}
+
+	// The model wasn't cooked by AssetCooker or it was changed, it's processed here the same way
+	cooker.setLayoutFilter([this](VertexLayout layout) { return isVertexLayoutSupported(layout); });
+	cooker.cook(modelPath, cachePath, cache);
+}
+
+
+
+void Screen::performInitialRotation()
+{
+	hasRotated = false;
+	if (!hasRotated)
+	{
+		UniformBufferObject ubo{};
+		ubo.model = glm::rotate(glm::mat4(1.0f), glm::radians(90.0f), glm::vec3(1.0f, 0.0f, 0.0f));
+		
+		memcpy(uniformBuffersMapped[0], &ubo, sizeof(ubo));
+		hasRotated = true;
+	}
+}
+
+
+
+MeshCookSettings Screen::meshCookSettings()
+{
+	MeshCookSettings settings{};
+	settings.optimize = OPTIMIZE_MESH;
+	settings.compactVertices = COMPACT_VERTICES;
+	settings.packedNormals = PACKED_NORMALS;
+	settings.maxLodCount = MAX_LOD_COUNT;
+	settings.lodTrianglePercent = LOD_TRIANGLE_PERCENT;
+	settings.lodErrorPermille = LOD_ERROR_PERMILLE;
+	settings.verbose = enableValidationLayers;
+	return settings;
+}
+
+
+
+bool Screen::isVertexLayoutSupported(VertexLayout layout)
+{
+	// The compact layouts that are switched off aren't built into the cooker settings or the pipelines
+	if constexpr (!COMPACT_VERTICES)
+	{
+		if (layout != VERTEX_LAYOUT_FULL)
+		{
+			return false;
+		}
+	}
+	if constexpr (!PACKED_NORMALS)
+	{
+		if (layout == VERTEX_LAYOUT_COMPACT_NORMAL)
+		{
+			return false;
+		}
+	}
+
+	VertexLayoutInfo layoutInfo = getVertexLayoutInfo(layout);
+
+	// The shader variant of the layout has to be compiled by Compile_Shaders.bat
+	if (!std::ifstream(layoutInfo.vertexShader).good())
+	{
+		return false;
+	}
+
+	// The module that was compiled from the older source doesn't read the object buffer or reads the attributes the layout doesn't have
+	Shaders shader;
+	ShaderInterface shaderInterface = shader.readInterface(shader.readFile(layoutInfo.vertexShader));
+	for (uint32_t binding : { 0u, 2u })
+	{
+		if (std::find(shaderInterface.bindings.begin(), shaderInterface.bindings.end(), binding) == shaderInterface.bindings.end())
+		{
+			return false;
+		}
+	}
+	for (uint32_t location : shaderInterface.inputLocations)
+	{
+		auto attribute = std::find_if(layoutInfo.attributeDescriptions.begin(), layoutInfo.attributeDescriptions.end(),
+										[location](const VkVertexInputAttributeDescription& description) { return description.location == location; });
+		if (attribute == layoutInfo.attributeDescriptions.end())
+		{
+			return false;
+		}
+	}
+
+	for (const auto& attribute : layoutInfo.attributeDescriptions)
+	{
+		VkFormatProperties props;
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, attribute.format, &props);
+
+		if ((props.bufferFeatures & VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT) != VK_FORMAT_FEATURE_VERTEX_BUFFER_BIT)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+
+
+void Screen::createPlaceholderMesh(MeshCache& cache)
+{
+	// The cube of the unit size in the full precision layout, it has one level and no meshlets
+	std::vector<Vertex> cubeVertices;
+	for (uint32_t i = 0; i < 8; ++i)
+	{
+		Vertex vertex{};
+		vertex.pos = glm::vec3((i & 1) ? 0.5f : -0.5f, (i & 2) ? 0.5f : -0.5f, (i & 4) ? 0.5f : -0.5f);
+		vertex.color = glm::vec3(1.0f);
+		vertex.texCoord = glm::vec2((i & 1) ? 1.0f : 0.0f, (i & 2) ? 1.0f : 0.0f);
+		cubeVertices.push_back(vertex);
+	}
+	// The triangles are counter clockwise from the outside of the cube
+	const uint16_t cubeIndices[] = {
+		0, 4, 6, 0, 6, 2,
+		1, 3, 7, 1, 7, 5,
+		0, 1, 5, 0, 5, 4,
+		2, 6, 7, 2, 7, 3,
+		0, 2, 3, 0, 3, 1,
+		4, 5, 7, 4, 7, 6
+	};
+
+	VertexBounds bounds{ glm::vec3(-0.5f), glm::vec3(1.0f) };
+	std::vector<char> vertexData = encodeVertices(VERTEX_LAYOUT_FULL, cubeVertices, bounds);
+	MeshLod lod{ 0, static_cast<uint32_t>(std::size(cubeIndices)), 0, 0, 0.0f, 0 };
+
+	MeshCacheData meshData{};
+	meshData.vertices = vertexData.data();
+	meshData.vertexStride = getVertexLayoutInfo(VERTEX_LAYOUT_FULL).stride;
+	meshData.vertexCount = static_cast<uint32_t>(cubeVertices.size());
+	meshData.vertexLayout = VERTEX_LAYOUT_FULL;
+	meshData.indices = cubeIndices;
+	meshData.indexSize = sizeof(uint16_t);
+	meshData.indexCount = lod.indexCount;
+	meshData.lods = &lod;
+	meshData.lodCount = 1;
+	meshData.meshlets = nullptr;
+	meshData.meshletCount = 0;
+	for (int i = 0; i < 3; ++i)
+	{
+		meshData.boundsMin[i] = -0.5f;
+		meshData.boundsMax[i] = 0.5f;
+	}
+	meshData.flags = 0;
+	// The placeholder is built on each run, so it's kept only in memory
+	cache.create("", "", meshData);
+}
+
+
+
+void Screen::appendMeshletDraws(const PoolMesh& mesh, const MeshLod& lod, const glm::vec4 planes[6], const glm::vec3& cameraPosition, uint32_t objectIndex)
+{
+	// The visible meshlets that follow each other in the index buffer are drawn with one command
+	const Meshlet* meshlets = mesh.meshlets.data() + lod.firstMeshlet;
+	uint32_t drawFirstIndex = 0;
+	uint32_t drawIndexCount = 0;
+	for (uint32_t i = 0; i < lod.meshletCount; ++i)
+	{
+		const Meshlet& meshlet = meshlets[i];
+		if (!MeshletBuilder::isVisible(meshlet, planes, cameraPosition))
+		{
+			continue;
+		}
+
+		if (drawIndexCount > 0 && drawFirstIndex + drawIndexCount == meshlet.firstIndex)
+		{
+			drawIndexCount += meshlet.indexCount;
+			continue;
+		}
+		if (drawIndexCount > 0)
+		{
+			sceneDraws.push_back({ drawIndexCount, 1, mesh.firstIndex + drawFirstIndex, mesh.vertexOffset, objectIndex });
+		}
+		drawFirstIndex = meshlet.firstIndex;
+		drawIndexCount = meshlet.indexCount;
+	}
+
+	if (drawIndexCount > 0)
+	{
+		sceneDraws.push_back({ drawIndexCount, 1, mesh.firstIndex + drawFirstIndex, mesh.vertexOffset, objectIndex });
+	}
+}
+
+
+
+uint32_t Screen::selectLod(const PoolMesh& mesh, const glm::mat4& modelView, uint32_t currentLod)
+{
+	uint32_t lodCount = static_cast<uint32_t>(mesh.lods.size());
+	const MeshLod* lods = mesh.lods.data();
+
+	// The distance from the camera to the bounding sphere, the near plane is the closest distance
+	glm::vec4 center = modelView * glm::vec4(mesh.center, 1.0f);
+	float distance = std::max(glm::length(glm::vec3(center)) - mesh.radius, 0.1f);
+	// The size of one unit of the model in pixels at this distance, proj[1][1] is 1 / tan(fov / 2)
+	float pixelsPerUnit = std::fabs(frameUniforms.proj[1][1]) * 0.5f * static_cast<float>(swapChainExtent.height) / distance;
+
+	uint32_t lod = 0;
+	for (uint32_t i = 1; i < lodCount; ++i)
+	{
+		float threshold = (i > currentLod) ? LOD_PIXEL_ERROR * (1.0f - LOD_HYSTERESIS) : LOD_PIXEL_ERROR;
+		if (lods[i].error * pixelsPerUnit > threshold)
+		{
+			break;
+		}
+		lod = i;
+	}
+	return lod;
+}
+
+
+
+void Screen::loadScene()
+{
+	// The pool keeps the 16-bit indices when every model of the scene was cooked with them, a missing or changed cache can have any size
+	uint32_t indexSize = sizeof(uint16_t);
+	MeshCooker cooker(threadPool, meshCookSettings());
+	for (const std::string& modelPath : SCENE_MODELS)
+	{
+		MeshCache cache;
+		if (!cache.open(modelPath + MESH_CACHE_EXTENSION, modelPath, cooker.cacheFlags()) || cache.indexSize() != sizeof(uint16_t))
+		{
+			indexSize = sizeof(uint32_t);
+			break;
+		}
+	}
+	// The sizes of the models are unknown until they are loaded, so the pool has the fixed capacity
+	geometryPool.reset(GEOMETRY_POOL_VERTEX_SIZE, GEOMETRY_POOL_INDEX_SIZE, indexSize);
+	if (enableValidationLayers)
+	{
+		std::cout << "--Geometry pool: " << indexSize * 8 << "-bit indices" << std::endl;
+	}
+
+	// The placeholder is the first mesh of the pool, it's uploaded with the pool buffers by uploadScene()
+	sceneCaches.clear();
+	sceneCaches.emplace_back(std::make_unique<MeshCache>());
+	createPlaceholderMesh(*sceneCaches.back());
+	uint32_t placeholderMesh = geometryPool.addMesh("placeholder", *sceneCaches.back());
+
+	// Each model of the scene is shown by the placeholder until streamSceneMesh() replaces it
+	sceneObjects.clear();
+	for (size_t i = 0; i < SCENE_MODELS.size(); ++i)
+	{
+		SceneObject object{};
+		object.mesh = placeholderMesh;
+		object.texture = 0;
+		object.transform = glm::mat4(1.0f);
+		object.currentLod = 0;
+		sceneObjects.emplace_back(object);
+	}
+	placeSceneObjects();
+}
+
+
+
+void Screen::uploadScene()
+{
+	std::vector<uint32_t> meshIds;
+	std::vector<const MeshCache*> caches;
+	for (size_t i = 0; i < sceneCaches.size(); ++i)
+	{
+		meshIds.push_back(static_cast<uint32_t>(i));
+		caches.push_back(sceneCaches[i].get());
+	}
+	uploadMeshes(meshIds, caches);
+
+	// The meshes are in the pool buffers, the draws need only the levels and the meshlets that the pool has copied
+	sceneCaches.clear();
+}
+
+
+
+void Screen::uploadMeshes(const std::vector<uint32_t>& meshIds, const std::vector<const MeshCache*>& caches)
+{
+	// The vertices and the indices of all meshes go through the staging ring and one command buffer
+	VkDeviceSize indexSize = geometryPool.getIndexSize();
+	VkDeviceSize bufferSize = 0;
+	for (const auto* cache : caches)
+	{
+		bufferSize += cache->vertexDataSize() + cache->indexCount() * indexSize;
+	}
+	if (bufferSize == 0)
+	{
+		return;
+	}
+
+	if (directUpload)
+	{
+		// The meshes are written straight to their ranges of the mapped pool buffers, there is no staging copy and no submission
+		/// The ranges of the new meshes aren't read by the frames in flight, the coherent writes are visible to the next submission
+		char* vertexData = static_cast<char*>(vertexBufferMemory.mapped);
+		char* indexData = static_cast<char*>(indexBufferMemory.mapped);
+		for (size_t i = 0; i < meshIds.size(); ++i)
+		{
+			const PoolMesh& mesh = geometryPool.getMesh(meshIds[i]);
+			const MeshCache& cache = *caches[i];
+			memcpy(vertexData + mesh.vertexByteOffset, cache.vertexData(), static_cast<size_t>(cache.vertexDataSize()));
+			geometryPool.writeIndices(cache, indexData + mesh.indexByteOffset);
+		}
+		return;
+	}
+
+	// Each mesh is copied to its ranges of the pool buffers by the upload batch, the large meshes are split to the chunks of the staging ring
+	beginUploadBatch();
+	for (size_t i = 0; i < meshIds.size(); ++i)
+	{
+		const PoolMesh& mesh = geometryPool.getMesh(meshIds[i]);
+		const MeshCache& cache = *caches[i];
+		const unsigned char* vertexData = static_cast<const unsigned char*>(cache.vertexData());
+
+		stageToBuffer(vertexBuffer, mesh.vertexByteOffset, cache.vertexDataSize(), 4,
+			[vertexData](unsigned char* destination, VkDeviceSize offset, VkDeviceSize size)
+			{
+				memcpy(destination, vertexData + offset, static_cast<size_t>(size));
+			});
+		stageToBuffer(indexBuffer, mesh.indexByteOffset, cache.indexCount() * indexSize, indexSize,
+			[this, &cache, indexSize](unsigned char* destination, VkDeviceSize offset, VkDeviceSize size)
+			{
+				geometryPool.writeIndices(cache, destination, static_cast<uint32_t>(offset / indexSize), static_cast<uint32_t>(size / indexSize));
+			});
+	}
+
+	// The ranges are released to the graphics family and acquired by the next frame, the rest of the buffers stays with the graphics queue
+	if (transferFamily != graphicsFamily)
+	{
+		std::vector<VkBufferMemoryBarrier>& barriers = uploadBatch.bufferBarriers;
+		for (size_t i = 0; i < meshIds.size(); ++i)
+		{
+			const PoolMesh& mesh = geometryPool.getMesh(meshIds[i]);
+			VkBufferMemoryBarrier barrier{};
+			barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+			barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			barrier.dstAccessMask = 0;
+			barrier.srcQueueFamilyIndex = transferFamily;
+			barrier.dstQueueFamilyIndex = graphicsFamily;
+
+			barrier.buffer = vertexBuffer;
+			barrier.offset = mesh.vertexByteOffset;
+			barrier.size = caches[i]->vertexDataSize();
+			barriers.push_back(barrier);
+			uploadBatch.acquires.push_back(UploadAcquire{ barrier.buffer, barrier.offset, barrier.size, VK_NULL_HANDLE, 0, false, 0, 0 });
+			barrier.buffer = indexBuffer;
+			barrier.offset = mesh.indexByteOffset;
+			barrier.size = caches[i]->indexCount() * indexSize;
+			barriers.push_back(barrier);
+			uploadBatch.acquires.push_back(UploadAcquire{ barrier.buffer, barrier.offset, barrier.size, VK_NULL_HANDLE, 0, false, 0, 0 });
+		}
+	}
+	endUploadBatch();
+}
+
+
+
+void Screen::stageToBuffer(VkBuffer buffer, VkDeviceSize bufferOffset, VkDeviceSize size, VkDeviceSize granularity,
+							const std::function<void(unsigned char*, VkDeviceSize, VkDeviceSize)>& write)
+{
+	VkDeviceSize chunkSize = STAGING_CHUNK_SIZE / granularity * granularity;
+	for (VkDeviceSize offset = 0; offset < size; offset += chunkSize)
+	{
+		VkDeviceSize copySize = std::min(chunkSize, size - offset);
+		StagingRegion region;
+		reserveStaging(copySize, granularity, region);
+		write(region.data, offset, copySize);
+
+		VkBufferCopy copy{ region.offset, bufferOffset + offset, copySize };
+		uploadBatch.bufferCopies.push_back({ buffer, copy });
+		stagingRing.retire(region, uploadSubmission + 1);
+	}
+}
+
+
+
+void Screen::createSceneBuffers()
+{
+	// The buffers are written by the CPU every frame, so each frame in flight has its own copy
+	VkDeviceSize objectBufferSize = sizeof(ObjectData) * std::max<size_t>(sceneObjects.size(), 1);
+	VkDeviceSize indirectBufferSize = sizeof(VkDrawIndexedIndirectCommand) * MAX_SCENE_DRAWS;
+	// The cached command buffers have the fixed range of the commands for each vertex layout and their counts after the ranges
+	if (commandCache)
+	{
+		indirectBufferSize = (sizeof(VkDrawIndexedIndirectCommand) * MAX_SCENE_DRAWS + sizeof(uint32_t)) * VERTEX_LAYOUT_COUNT;
+	}
+
+	objectBuffers.resize(framesInFlight);
+	objectBuffersMemory.resize(framesInFlight);
+	objectBuffersMapped.resize(framesInFlight);
+	indirectBuffers.resize(framesInFlight);
+	indirectBuffersMemory.resize(framesInFlight);
+	indirectBuffersMapped.resize(framesInFlight);
+
+	for (size_t i = 0; i < framesInFlight; ++i)
+	{
+		createBuffer(objectBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, objectBuffers[i], objectBuffersMemory[i], MEMORY_CATEGORY_UNIFORM,
+						directUpload ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT : 0);
+		objectBuffersMapped[i] = objectBuffersMemory[i].mapped;
+
+		createBuffer(indirectBufferSize, VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT, indirectBuffers[i], indirectBuffersMemory[i], MEMORY_CATEGORY_UNIFORM,
+						directUpload ? VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT : 0);
+		indirectBuffersMapped[i] = indirectBuffersMemory[i].mapped;
+	}
+
+	sceneDraws.reserve(MAX_SCENE_DRAWS);
+	layoutFirstDraw.fill(0);
+	layoutDrawCount.fill(0);
+}
+
+
+
+void Screen::updateSceneDraws(uint32_t currentImage)
+{
+	ObjectData* objectData = static_cast<ObjectData*>(objectBuffersMapped[currentImage]);
+	sceneDraws.clear();
+	uint32_t usedLayouts = 0;
+
+	// The objects are visited for each vertex layout, so the commands of one pipeline are next to each other
+	for (uint32_t layout = 0; layout < VERTEX_LAYOUT_COUNT; ++layout)
+	{
+		layoutFirstDraw[layout] = static_cast<uint32_t>(sceneDraws.size());
+		for (uint32_t i = 0; i < static_cast<uint32_t>(sceneObjects.size()); ++i)
+		{
+			SceneObject& object = sceneObjects[i];
+			const PoolMesh& mesh = geometryPool.getMesh(object.mesh);
+			if (mesh.vertexLayout != layout)
+			{
+				continue;
+			}
+			usedLayouts |= 1u << layout;
+			objectData[i].model = object.transform * mesh.positionDecode;
+			objectData[i].textureIndex = object.texture;
+
+			// The frustum is moved to the space of the model, where the bounds of the mesh and its meshlets are
+			glm::mat4 modelView = frameUniforms.view * frameUniforms.model * object.transform;
+			glm::vec4 planes[6];
+			MeshletBuilder::extractFrustum(frameUniforms.proj * modelView, planes);
+			if (!MeshletBuilder::isSphereVisible(mesh.center, mesh.radius, planes))
+			{
+				continue;
+			}
+
+			// The texture levels are requested by the diameter of the bounding sphere on the screen in pixels
+			float distance = std::max(glm::length(glm::vec3(modelView * glm::vec4(mesh.center, 1.0f))) - mesh.radius, 0.1f);
+			textureStreamer.request(object.texture, mesh.radius * std::abs(frameUniforms.proj[1][1]) * swapChainExtent.height / distance);
+
+			// The commands that don't fit the indirect buffer are dropped, the level is drawn by one command when the meshlets don't fit
+			uint32_t freeDraws = MAX_SCENE_DRAWS - static_cast<uint32_t>(sceneDraws.size());
+			if (freeDraws == 0)
+			{
+				continue;
+			}
+
+			// Choosing the level of detail by its error on the screen
+			object.currentLod = selectLod(mesh, modelView, object.currentLod);
+			const MeshLod& lod = mesh.lods[object.currentLod];
+			if (!CULL_MESHLETS || lod.meshletCount == 0 || lod.meshletCount > freeDraws)
+			{
+				sceneDraws.push_back({ lod.indexCount, 1, mesh.firstIndex + lod.firstIndex, mesh.vertexOffset, i });
+			}
+			else
+			{
+				glm::vec3 cameraPosition = glm::vec3(glm::inverse(modelView) * glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+				appendMeshletDraws(mesh, lod, planes, cameraPosition, i);
+			}
+		}
+		layoutDrawCount[layout] = static_cast<uint32_t>(sceneDraws.size()) - layoutFirstDraw[layout];
+	}
+
+	if (!commandCache)
+	{
+		memcpy(indirectBuffersMapped[currentImage], sceneDraws.data(), sceneDraws.size() * sizeof(VkDrawIndexedIndirectCommand));
+		return;
+	}
+
+	// The cached command buffers read the commands of each layout from its range and the number of them from the end of the buffer
+	unsigned char* indirectData = static_cast<unsigned char*>(indirectBuffersMapped[currentImage]);
+	uint32_t* drawCounts = reinterpret_cast<uint32_t*>(indirectData + sizeof(VkDrawIndexedIndirectCommand) * VERTEX_LAYOUT_COUNT * MAX_SCENE_DRAWS);
+	for (uint32_t layout = 0; layout < VERTEX_LAYOUT_COUNT; ++layout)
+	{
+		memcpy(indirectData + sizeof(VkDrawIndexedIndirectCommand) * layout * MAX_SCENE_DRAWS, sceneDraws.data() + layoutFirstDraw[layout],
+				layoutDrawCount[layout] * sizeof(VkDrawIndexedIndirectCommand));
+		drawCounts[layout] = layoutDrawCount[layout];
+	}
+	// The scene has the objects of another vertex layout, so the pipelines of the cached command buffers change
+	if (usedLayouts != cachedLayouts)
+	{
+		cachedLayouts = usedLayouts;
+		invalidateCommandCache();
+	}
+}
+
+
+
+void Screen::placeSceneObjects()
+{
+	// The first object stays in its place, the next ones are placed in a row after it along the X axis
+	float rowEnd = 0.0f;
+	for (size_t i = 0; i < sceneObjects.size(); ++i)
+	{
+		const PoolMesh& mesh = geometryPool.getMesh(sceneObjects[i].mesh);
+		if (i == 0)
+		{
+			rowEnd = mesh.center.x - mesh.radius;
+		}
+
+		sceneObjects[i].transform = glm::translate(glm::mat4(1.0f), glm::vec3(rowEnd + mesh.radius - mesh.center.x, 0.0f, 0.0f));
+		rowEnd += 2.0f * mesh.radius;
+	}
+}
+
+
+
+void Screen::startAssetLoading()
+{
+	// The models are parsed or mapped by loadModel() on the worker threads
+	assetLoader.setMeshLoader([this](const std::string& modelPath, MeshCache& cache) { loadModel(modelPath, cache); });
+
+	for (uint32_t i = 0; i < static_cast<uint32_t>(SCENE_MODELS.size()); ++i)
+	{
+		assetLoader.start(streamSceneMesh(i));
+	}
+	assetLoader.start(streamTexture());
+}
+
+
+
+AssetTask<void> Screen::streamSceneMesh(uint32_t objectIndex)
+{
+	std::string modelPath = SCENE_MODELS[objectIndex];
+	try
+	{
+		std::unique_ptr<MeshCache> cache = co_await assetLoader.loadMesh(modelPath);
+		if (assetLoader.isCancelled())
+		{
+			co_return;
+		}
+
+		// The render thread adds the mesh to the pool and uploads it, the next frame draws it instead of the placeholder
+		uint32_t meshId = geometryPool.addMesh(modelPath, *cache);
+		uploadMeshes({ meshId }, { cache.get() });
+		sceneObjects[objectIndex].mesh = meshId;
+		sceneObjects[objectIndex].currentLod = 0;
+		placeSceneObjects();
+
+		if (enableValidationLayers)
+		{
+			std::cout << "--Streamed mesh: " << modelPath << " geometry pool: vertex bytes: " << geometryPool.vertexUsed() << " / " <<
+				geometryPool.vertexCapacity() << " index bytes: " << geometryPool.indexUsed() << " / " << geometryPool.indexCapacity() << std::endl;
+		}
+	}
+	catch (const std::exception& ex)
+	{
+		// The object keeps the placeholder when its model can't be loaded
+		std::cerr << ex.what() << std::endl;
+	}
+}
+
+
+
+AssetTask<void> Screen::streamTexture()
+{
+	try
+	{
+		uint32_t index = 0;
+		if (STREAM_TEXTURES)
+		{
+			TextureData texture = co_await assetLoader.loadTexture(chooseTexturePath(), true);
+			if (assetLoader.isCancelled())
+			{
+				co_return;
+			}
+
+			// Only the mip tail is uploaded, the finer levels are streamed when the objects are large on the screen
+			uint32_t tailLevel = textureStreamer.tailLevel(texture);
+			index = addTexture(texture, tailLevel);
+			textureStreamer.addTexture(index, texture, tailLevel);
+			textureSources[index] = std::move(texture);
+		}
+		else
+		{
+			// The staging ring is created with the device, so the decoding starts when the render thread is running
+			co_await assetLoader.resumeOnRenderThread();
+			TextureData texture = co_await assetLoader.loadTextureToStaging(chooseTexturePath(), stagingRing);
+			if (assetLoader.isCancelled())
+			{
+				stagingRing.release(texture.staged);
+				co_return;
+			}
+
+			// The GPU copies the image from the ring and builds its levels, the region is released after the copy
+			index = addTexture(texture);
+		}
+
+		// The objects switch from the placeholder to the new element by their texture index in the next frame
+		for (SceneObject& object : sceneObjects)
+		{
+			object.texture = index;
+		}
+	}
+	catch (const std::exception& ex)
+	{
+		// The objects keep the placeholder texture when the texture can't be loaded
+		std::cerr << ex.what() << std::endl;
+	}
+}
+
+
+
+void Screen::resizeWindow(int width, int height)
+{
+	if (width < 100 || height < 100)
+	{
+		throw std::invalid_argument("ERROR::Screen::set_Window()- width or height less then 100");
+	}
+	else
+	{
+		SDL_SetWindowSize(window,width, height);
+	}
+}
+
+
+
+void Screen::cleanup()
+{
+	// The loading coroutines are finished before the resources they use are destroyed
+	assetLoader.drain();
+	// The frames and the uploads that are still on the queues use the buffers, the allocator and the staging ring
+	vkDeviceWaitIdle(device);
+
+	if (enableValidationLayers) 
+	{
+		DestroyDebugUtilsMessengerEXT(instanceVK, debugMessenger, nullptr);
+	}
+
+	cleanupSwapChain();
+
+	vkDestroySampler(device, textureSampler, nullptr);
+	vkDestroyBuffer(device, stagingBuffer, nullptr);
+	gpuAllocator.free(stagingMemory);
+	vkDestroyFence(device, uploadFence, nullptr);
+	vkDestroySemaphore(device, uploadTimeline, nullptr);
+	uploadsInFlight.clear();
+	pendingAcquires.clear();
+	for (BindlessTexture& texture : textures)
+	{
+		vkDestroyImageView(device, texture.view, nullptr);
+		vkDestroyImage(device, texture.image, nullptr);
+		gpuAllocator.free(texture.memory);
+	}
+	for (auto& retired : retiredTextures)
+	{
+		vkDestroyImageView(device, retired.first.view, nullptr);
+		vkDestroyImage(device, retired.first.image, nullptr);
+		gpuAllocator.free(retired.first.memory);
+	}
+	textures.clear();
+	retiredTextures.clear();
+	textureSources.clear();
+
+	for (size_t i = 0; i < framesInFlight; ++i)
+	{
+		vkDestroyBuffer(device, uniformBuffers[i], nullptr);
+		gpuAllocator.free(uniformBuffersMemory[i]);
+		vkDestroyBuffer(device, objectBuffers[i], nullptr);
+		gpuAllocator.free(objectBuffersMemory[i]);
+		vkDestroyBuffer(device, indirectBuffers[i], nullptr);
+		gpuAllocator.free(indirectBuffersMemory[i]);
+	}
+
+	vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+	vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+
+	vkDestroyBuffer(device, indexBuffer, nullptr);
+	gpuAllocator.free(indexBufferMemory);
+
+	vkDestroyBuffer(device, vertexBuffer, nullptr);
+	gpuAllocator.free(vertexBufferMemory);
+
+	for (size_t i{}; i < framesInFlight; ++i)
+	{
+		vkDestroySemaphore(device, imageAvailableSemaphore[i], nullptr);
+		vkDestroySemaphore(device, renderFinishedSemaphore[i], nullptr);
+	}
+	vkDestroySemaphore(device, frameTimeline, nullptr);
+	vkDestroyCommandPool(device, commandPool, nullptr);
+	vkDestroyCommandPool(device, commandPoolTransfer, nullptr);
+	for (const std::vector<VkCommandPool>& pools : recordPools)
+	{
+		for (VkCommandPool pool : pools)
+		{
+			vkDestroyCommandPool(device, pool, nullptr);
+		}
+	}
+
+	//for (auto framebuffer : swapChainFramebuffers)
+	//{
 	//	vkDestroyFramebuffer(device, framebuffer, nullptr);
 	//}
 
-	vkDestroyPipeline(device, graphicsPipeline, nullptr);
+	for (auto pipeline : graphicsPipelines)
+	{
+		if (pipeline != VK_NULL_HANDLE)
+		{
+			vkDestroyPipeline(device, pipeline, nullptr);
+		}
+	}
 	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 	vkDestroyRenderPass(device, renderPass, nullptr);
 
@@ -2092,6 +4063,7 @@ void Screen::cleanup()
 	//}
 
 	//vkDestroySwapchainKHR(device, swapChain, nullptr);
+	gpuAllocator.destroy();
 	vkDestroyDevice(device, nullptr);
 	//SDL_DestroyWindowSurface(window);
 	vkDestroySurfaceKHR(instanceVK, surface, nullptr);
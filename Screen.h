@@ -7,11 +7,21 @@
 
 #include <glm.hpp>
 #include <gtc/matrix_transform.hpp>
-#include <gtx/hash.hpp>
 #include <stb_image.h>
 #include <tiny_obj_loader.h>
 
 #include "Shaders.h"
+#include "MeshCache.h"
+#include "ThreadPool.h"
+#include "MeshCooker.h"
+#include "VertexLayouts.h"
+#include "GeometryPool.h"
+#include "AssetLoader.h"
+#include "MipGenerator.h"
+#include "Ktx2Loader.h"
+#include "TextureStreamer.h"
+#include "GpuAllocator.h"
+#include "TaskGraph.h"
 #include <iostream>
 #include <fstream>
 #include <stdexcept>
@@ -25,7 +35,8 @@
 #include <array>
 #include <optional>
 #include <set>
-#include <unordered_map>
+#include <memory>
+#include <functional>
 
 #ifdef NDEBUG
 const bool enableValidationLayers = false;
@@ -42,7 +53,7 @@ struct QueueFamilyIndices
 	std::optional<uint32_t> graphicsFamily;
 	// This Queue Family contains the queues of ______ commands
 	std::optional<uint32_t> presentFamily;
-
+	// This Queue Family copies the uploads, it's the family of the transfer commands only when the device has it, otherwise the graphics family
 	std::optional<uint32_t> transferFamily;
 
 	bool isComplete() 
@@ -68,67 +79,83 @@ VkResult createDebugUtilsMessengerEXT(VkInstance instance,
 										const VkAllocationCallbacks* pAllocator,
 										VkDebugUtilsMessengerEXT* pDebugMessenger);
 
-// Shaders
-struct Vertex
+// Descriptors
+struct UniformBufferObject
 {
-	glm::vec3 pos;
-	glm::vec3 color;
-	glm::vec2 texCoord;
+	alignas(16) glm::mat4 model;
+	alignas(16) glm::mat4 view;
+	alignas(16) glm::mat4 proj;
+	
+};
 
-	// Function to get the Binding description between Shader and Vulkan
-	static VkVertexInputBindingDescription getBindingDescription()
-	{
-		VkVertexInputBindingDescription bindingDescription{};
-		bindingDescription.binding = 0;
-		bindingDescription.stride = sizeof(Vertex);
-		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+// The per object data in the storage buffer, the vertex shader takes it by gl_InstanceIndex
+/// The layout matches the std430 struct of the shaders, the size is a multiple of 16 bytes
+struct ObjectData
+{
+	glm::mat4 model;
+	// The index of the texture in the bindless array of the fragment shader
+	uint32_t textureIndex;
+	uint32_t reserved[3];
+};
 
-		return bindingDescription;
-	}
+// The texture of the bindless array, its index in Screen::textures is the index in the descriptor array
+struct BindlessTexture
+{
+	VkImage image;
+	GpuAllocation memory;
+	VkImageView view;
+	VkFormat format;
+	uint32_t mipLevels;
+};
 
-	static std::array<VkVertexInputAttributeDescription, 3> getAttributeDescriptions()
-	{
-		std::array<VkVertexInputAttributeDescription, 3> attributeDescriptions{};
-		// Description of vertex attribute
-		attributeDescriptions[0].binding = 0;
-		attributeDescriptions[0].location = 0;
-		attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescriptions[0].offset = offsetof(Vertex, pos);
-		// Description of color attribute
-		attributeDescriptions[1].binding = 0;
-		attributeDescriptions[1].location = 1;
-		attributeDescriptions[1].format = VK_FORMAT_R32G32B32_SFLOAT;
-		attributeDescriptions[1].offset = offsetof(Vertex, color);
-		// Description of texture attribute
-		attributeDescriptions[2].binding = 0;
-		attributeDescriptions[2].location = 2;
-		attributeDescriptions[2].format = VK_FORMAT_R32G32_SFLOAT;
-		attributeDescriptions[2].offset = offsetof(Vertex, texCoord);
-
-		return attributeDescriptions;
-	}
+// The resource that the transfer queue released, the next frame acquires it on the graphics queue before its draws
+struct UploadAcquire
+{
+	// The range of the buffer, buffer is VK_NULL_HANDLE for the image
+	VkBuffer buffer;
+	VkDeviceSize offset;
+	VkDeviceSize size;
+	VkImage image;
+	uint32_t mipLevels;
+	// The image that gets its levels by the blits from the first level after it's acquired, the blits need the graphics queue
+	bool generateMips;
+	int32_t width;
+	int32_t height;
+};
 
-	bool operator==(const Vertex& other) const
-	{
-		return pos == other.pos && color == other.color && texCoord == other.texCoord;
-	}
+// The command buffer of the transfer queue and the value of the timeline semaphore that its submission signals
+struct UploadSubmission
+{
+	VkCommandBuffer commandBuffer;
+	uint64_t value;
 };
 
-namespace std {
-	template<> struct hash<Vertex> {
-		size_t operator()(Vertex const& vertex) const {
-			return ((hash<glm::vec3>()(vertex.pos) ^ (hash<glm::vec3>()(vertex.color) << 1)) >> 1) ^ (hash<glm::vec2>()(vertex.texCoord) << 1);
-		}
-	};
-}
+// The uploads that are collected between beginUploadBatch() and endUploadBatch() and recorded to one command buffer of the transfer queue
+/// The layout transitions before the copies and the barriers after them are merged into one vkCmdPipelineBarrier each
+/// The copies to the same buffer or image that follow each other are recorded by one command, all copies are read from the staging buffer
+struct UploadBatch
+{
+	// The number of the nested batches, the uploads are submitted when the outer one ends
+	uint32_t depth;
+	std::vector<VkImageMemoryBarrier> preBarriers;
+	std::vector<std::pair<VkBuffer, VkBufferCopy>> bufferCopies;
+	std::vector<std::pair<VkImage, VkBufferImageCopy>> imageCopies;
+	std::vector<VkBufferMemoryBarrier> bufferBarriers;
+	std::vector<VkImageMemoryBarrier> imageBarriers;
+	// The finished resources, the graphics queue acquires them when the families differ, otherwise the blits of their levels follow the barriers
+	std::vector<UploadAcquire> acquires;
+};
 
-// Descriptors
-struct UniformBufferObject
+// The instance of the mesh of the geometry pool in the scene
+struct SceneObject
 {
-	alignas(16) glm::mat4 model;
-	alignas(16) glm::mat4 view;
-	alignas(16) glm::mat4 proj;
-	
+	uint32_t mesh;
+	// The index of the texture of the object in the bindless array, 0 is the placeholder texture
+	uint32_t texture;
+	// Placement of the mesh in the scene, the rotation of the scene from the uniform buffer is applied after it
+	glm::mat4 transform;
+	// The level of detail of the previous frame for the hysteresis
+	uint32_t currentLod;
 };
 
 
@@ -139,13 +166,76 @@ public:
 	const std::vector<const char*> VALIDATION_LAYERS = {"VK_LAYER_KHRONOS_validation"};
 	// This constant intended for enumeration of required device extensions
 	const std::vector<const char*> DEVICE_EXTENSIONS = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
-	// This constant to specifies the limit of simultaneous rendering of images
-	const int MAX_FRAMES_IN_FLIGHT = 2;
+	// This constant to specifies the limit of simultaneous rendering of images, the number of the frames in flight is chosen from 1 to it
+	/// More frames keep the GPU busy when the CPU time of the frames varies, fewer frames show the input on the screen earlier
+	const uint32_t MAX_FRAMES_IN_FLIGHT = 4;
 
 	const std::string MODEL_PATH = "models/gex_rot.obj";//viking_room.obj";
 	const std::string TEXTURE_PATH = "textures/sot.png";
+	// The texture cooked by AssetCooker with its mip chain in RGBA8 or BC1, it's used instead of TEXTURE_PATH when the device can sample its format
+	const std::string COOKED_TEXTURE_PATH = "textures/sot.ktx2";
+	// The models of the scene, each of them is placed once in a row along the X axis
+	/// They are loaded by the coroutines on the worker threads, a cube is drawn in place of each model until it's uploaded
+	const std::vector<std::string> SCENE_MODELS = { MODEL_PATH };
+	// The binary copy of the loaded model is saved next to it, it's mapped to memory instead of parsing the OBJ file again
+	const std::string MESH_CACHE_EXTENSION = ".vkmesh";
+	// The smallest capacity of the shared vertex and index buffers, the meshes are added without new buffers until they are full
+	const VkDeviceSize GEOMETRY_POOL_VERTEX_SIZE = 64ull * 1024 * 1024;
+	const VkDeviceSize GEOMETRY_POOL_INDEX_SIZE = 32ull * 1024 * 1024;
+	// The capacity of the indirect buffer of each frame, the objects above it draw their levels by one command or aren't drawn
+	const uint32_t MAX_SCENE_DRAWS = 16384;
+	// Reordering of the triangles and the vertices of the loaded model for the vertex cache and the overdraw
+	const bool OPTIMIZE_MESH = true;
+	// Quantized vertex layouts, the full precision layout is used for the models with vertex colors
+	static constexpr bool COMPACT_VERTICES = true;
+	// Octahedral packed normal in the compact layout when the model has normals
+	static constexpr bool PACKED_NORMALS = true;
+	// Levels of detail, each level has about half of the triangles of the previous one
+	const uint32_t MAX_LOD_COUNT = 6;
+	// The target of each level in percent of the triangles of the previous level and the largest error of one step in per mille of the size of the model
+	const uint32_t LOD_TRIANGLE_PERCENT = 50;
+	const uint32_t LOD_ERROR_PERMILLE = 50;
+	// The coarser level is drawn while its error on the screen is less than this number of pixels
+	const float LOD_PIXEL_ERROR = 1.0f;
+	// The switch to the coarser level needs the error below (1 - LOD_HYSTERESIS) * LOD_PIXEL_ERROR, so the levels don't flicker
+	const float LOD_HYSTERESIS = 0.25f;
+	// The meshlets out of the frustum or facing away from the camera are skipped before the draw calls
+	const bool CULL_MESHLETS = true;
+	// The size of the bindless texture array, it's limited by maxDescriptorSetUpdateAfterBindSampledImages of the device
+	/// All textures are bound by one descriptor set per frame, the shaders index them by the texture index of the object
+	const uint32_t MAX_BINDLESS_TEXTURES = 4096;
+	// The video memory of the streamed textures, the fine levels of the least recently used textures are evicted above it
+	const VkDeviceSize TEXTURE_STREAMING_BUDGET = 256ull * 1024 * 1024;
+	// The bytes of the texture levels that are uploaded in one frame, the other requests wait for the next frames
+	const VkDeviceSize TEXTURE_STREAMING_UPLOAD_SIZE = 16ull * 1024 * 1024;
+	// The levels of this size and smaller are the mip tail, it's resident all the time
+	const uint32_t TEXTURE_STREAMING_TAIL_SIZE = 128;
+	// The fine levels of the textures are streamed by TextureStreamer, otherwise the image is decoded straight into the staging ring
+	/// and uploaded once with all levels, which doesn't keep its copy in the system memory
+	/// The streamer uploads the fine levels later from the system memory, so the streamed images get their levels from MipGenerator on the CPU,
+	/// the levels are built by the blits on the GPU only when the streaming is switched off
+	const bool STREAM_TEXTURES = true;
+	// The persistently mapped staging memory of all uploads
+	const VkDeviceSize STAGING_SIZE = 64ull * 1024 * 1024;
+	// The largest region of one copy, the larger uploads are split to the chunks of this size, so they never need more staging memory
+	const VkDeviceSize STAGING_CHUNK_SIZE = 8ull * 1024 * 1024;
+	// The vertices, the indices and the per frame data are written straight to the video memory when the CPU can map all of it
+	/// (integrated GPUs and resizable BAR), otherwise they go through the staging buffer and the copy on the transfer queue
+	const bool DIRECT_UPLOAD = true;
+	// The part of the budget of the heap when the memory warning is called
+	const float MEMORY_BUDGET_WARNING = 0.9f;
+	// The command buffers of the frames are recorded once for each swap chain image and frame in flight and submitted again every frame
+	/// They are recorded again only when the swap chain or the vertex layouts of the scene change, the draws of the frame go to the indirect buffer
+	/// with their count, so it needs drawIndirectCount of the device, otherwise the command buffer is recorded every frame
+	const bool CACHE_COMMAND_BUFFERS = true;
+	// The draws of the frame are recorded to the secondary command buffers by this number of threads when each draw is its own command
+	/// (the devices without multiDrawIndirect or drawIndirectFirstInstance) and the frame has at least PARALLEL_RECORD_MIN_DRAWS of them
+	const uint32_t RECORD_THREADS = 4;
+	const uint32_t PARALLEL_RECORD_MIN_DRAWS = 512;
 	
-	Screen();
+	// The benchmark creates the Screen with serialStartup, so the stages of the initialization run one after another as before the task graph
+	/// framesInFlight is the number of the frames that the CPU prepares while the GPU renders the previous ones
+	explicit Screen(bool serialStartup = false, uint32_t framesInFlight = 2);
 
 	// 1. Functions of SDL2 library initialization
 	void initSDL();
@@ -153,6 +243,7 @@ public:
 	SDL_Window* get_window() { return window; };
 
 	// 2. Functions of Vulkan library initialization
+	/// The stages are the tasks of startupGraph with the declared dependencies, the independent ones run in parallel on the thread pool
 	void initVulkanLib();
 
 	/// 2.1. Functions for creating the Vulkan Instance
@@ -177,6 +268,8 @@ public:
 	static void DestroyDebugUtilsMessengerEXT(VkInstance instance,
 												VkDebugUtilsMessengerEXT debugMessenger,
 												const VkAllocationCallbacks* pAllocator);
+	/// 2.5. Function to print the times of the startup stages and the longest chain of their dependencies
+	void printStartupStats();
 
 	// 3. Creating the surface
 	void createSurface();
@@ -189,6 +282,12 @@ public:
 	bool isDeviceSuitable(VkPhysicalDevice device);
 	/// 4.2. Optional function to rate the available physical devices with desired parameters 
 	int rateDeviceSuitability(VkPhysicalDevice device);
+	/// 4.3. Function to get the size of the bindless texture array that the device supports, 0 when it has no descriptor indexing
+	uint32_t bindlessTextureLimit(VkPhysicalDevice device);
+	/// 4.4. Function to check that the physical device supports the optional extension
+	bool isDeviceExtensionSupported(VkPhysicalDevice device, const char* extensionName);
+	/// 4.5. Function to check that the device supports the timeline semaphores of the upload submissions
+	bool supportsTimelineSemaphore(VkPhysicalDevice device);
 		
 	// 5. Creating the logical device
 	/// 5.1. Function to find out the available and correct Queue Families in the Physical Device
@@ -232,10 +331,12 @@ public:
 	void createFramebuffers();
 	/// 10.2. Creating the Command Pool that contains the commands to manage the memory which used to store the Buffers
 	void createCommandPool();
-	/// 10.3. Function to create the Vertex Buffer that contains the vertices
+	/// 10.3. Function to create the Vertex Buffer of the geometry pool that contains the vertices of all meshes
 	void createVertexBuffer();
-	/// 10.4. Function to create the VkBuffer
-	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, VkDeviceMemory& bufferMemory);
+	/// 10.4. Function to create the VkBuffer, its memory is sub-allocated from the blocks of gpuAllocator
+	/// The category of the buffer is counted by the memory accounting
+	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties, VkBuffer& buffer, GpuAllocation& bufferMemory,
+						MemoryCategory category, VkMemoryPropertyFlags preferred = 0);
 	/// 10.5. Creating the Command Buffer that allocates the memory and records commands for each Image of the SwapChain
 	void createCommandBuffer();
 	/// 10.6. Function to writes the commands to execute into a command buffer
@@ -247,15 +348,44 @@ public:
 	void drawFrame();
 	/// 10.7. Creating the Synchronization object like Semaphores and Fences
 	void createSyncObjects();
+	/// 10.8. Function to allocate the cached command buffers for the images of the current swap chain, the old ones are freed
+	void allocateCommandCache();
+	/// 10.9. Function to mark the cached command buffers as not recorded, each of them is recorded again when its frame and image come next
+	void invalidateCommandCache();
+	/// 10.10. Function to record the state of the scene and its draws from firstDraw to lastDraw inside the render pass
+	void recordDrawRange(VkCommandBuffer commandBuffer, uint32_t firstDraw, uint32_t lastDraw);
+	/// 10.11. Function to record the parts of the draws to the secondary command buffers on the threads and to execute them by the primary one
+	void recordSecondaryDraws(VkCommandBuffer commandBuffer, uint32_t imageIndex);
+	/// 10.12. Function to prepare the recording benchmark, the copies of the draw of the first object are recorded by one command each on the threads
+	void setRecordingBenchmark(uint32_t threads, uint32_t drawCount);
+	/// 10.13. Function to record the command buffer of the frame for the benchmark without submitting it, it waits for the frame slot like drawFrame()
+	void recordBenchmarkFrame();
+	/// 10.14. Function to check without waiting that the GPU has finished the frame, the frames are numbered from 1 in the order of their submission
+	bool isFrameComplete(uint64_t frame);
+	/// 10.15. Function to wait on the CPU until the GPU finishes the frame
+	void waitFrame(uint64_t frame);
+	// The number of the last submitted frame, 0 before the first frame
+	uint64_t getSubmittedFrame() const { return frameSubmission; };
+	uint32_t getFramesInFlight() const { return framesInFlight; };
+	// The number of the command pools of each frame, it's the largest number of the recording threads
+	uint32_t getMaxRecordThreads() const { return recordPools.empty() ? 1 : static_cast<uint32_t>(recordPools[0].size()); };
 	
 	// 11. Find the memory type of the GPU
-	/// 11.1. Function to determine the type of GPU memory
-	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+	/// 11.1. Function to determine the type of GPU memory, the type with the preferred properties is chosen when there is one
+	/// Among the others the type with the fewest properties that weren't asked for is chosen, so the plain resources don't take the mapped video memory
+	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties, VkMemoryPropertyFlags preferred = 0);
+	/// 11.2. Function to print the usage and the fragmentation of the video memory, the bytes of the categories and the budget of the heaps
+	void printMemoryStats();
+	/// 11.3. Function that is called when the usage of the heap goes above MEMORY_BUDGET_WARNING of its budget
+	/// The budget of the texture streaming is lowered by the bytes above the threshold, so the streaming stops loading the levels until restoreStreamingBudget() gives them back
+	void onMemoryBudgetWarning(uint32_t heap, const GpuMemorySnapshot& snapshot);
+	/// 11.4. Function to give the lowered budget of the texture streaming back as the usage of the heaps goes down, up to TEXTURE_STREAMING_BUDGET
+	void restoreStreamingBudget(const GpuMemorySnapshot& snapshot);
 
 	// 12. Function to copy VkBuffer
 	void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size, uint32_t indexBuffer, VkQueue queue);
 
-	// 13. Function to create the IndexBuffer
+	// 13. Function to create the IndexBuffer of the geometry pool
 	void createIndexBuffer();
 
 	// 14. Descriptors
@@ -271,25 +401,70 @@ public:
 	void createDescriptorSets();
 
 	// 15. Texture mapping
-	/// 15.1. Function to create Texture Image
-	void createTextureImage();
+	/// 15.1. Function to create Texture Image from the decoded pixels, the texture with the stored levels can start from firstLevel
+	/// The staged region of the texture is released after the copy
+	BindlessTexture createTextureImage(const TextureData& texture, uint32_t firstLevel = 0);
 	/// 15.2. Function to create image
 	void createImage(uint32_t width, uint32_t height, uint32_t mipLevels, VkFormat format, VkImageTiling tiling,
-						VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
+						VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, GpuAllocation& imageMemory,
+						MemoryCategory category);
 	/// 15.3. Function to start recording of the command buffer
 	VkCommandBuffer beginSingleTimeCommands();
-	/// 15.4. Function to end recording of the command buffer
+	/// 15.4. Function to end recording of the command buffer, submit it and wait for it, it's used only for the work that isn't an upload
 	void endSingleTimeCommands(VkCommandBuffer commandBuffer, VkQueue queue);
 	/// 15.5. Function to handle layout transitions
 	void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout, uint32_t mipLevels);
-	/// 15.6. Function to copy Buffer to Image
-	void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
+	/// 15.6. Function to add the copy of the staging buffer at offset to the first level of Image to the upload batch
+	void copyBufferToImage(VkImage image, uint32_t width, uint32_t height, VkDeviceSize offset);
 	/// 15.7. Function to create the Texture Image View
-	void createTextureImageView();
+	void createTextureImageView(BindlessTexture& texture);
 	/// 15.8 Abstract function to create imageViews
 	VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags, uint32_t mipLevels);
 	/// 15.9. Function to create the Texture Sampler
 	void createTextureSampler();
+	/// 15.10. Function to upload the texture to the next element of the bindless array, returns its index
+	/// The element isn't used by the frames in flight, so it's written without waiting for them
+	uint32_t addTexture(const TextureData& texture, uint32_t firstLevel = 0);
+	/// 15.11. Function to check that the GPU can build the mip levels of the format by vkCmdBlitImage with the linear filter
+	bool supportsLinearBlit(VkFormat format);
+	/// 15.12. Function to record the blits that fill the levels 1..N from the level 0, all levels end in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL
+	/// The command buffer belongs to the graphics family, the blits aren't supported by the transfer only queues
+	void generateMipmaps(VkCommandBuffer commandBuffer, VkImage image, int32_t texWidth, int32_t texHeight, uint32_t mipLevels);
+	/// 15.13. Function to add the copies of the levels to the image through the staging ring to the upload batch, the offsets of the levels are counted from data
+	/// The levels are split to the chunks of the rows, so the texture of any size is copied
+	void stageToImage(VkImage image, VkFormat format, const unsigned char* data, const std::vector<MipLevel>& levels);
+	/// 15.14. Function to choose the cooked KTX2 texture when the device supports its format, otherwise the image that is decoded at runtime
+	std::string chooseTexturePath();
+	/// 15.15. Function to write the texture to its element of the bindless array in the descriptor set of the frame
+	void writeTextureDescriptor(uint32_t index, uint32_t frame);
+	/// 15.16. Function to recreate the streamed texture with the levels from the first one, the old image is destroyed when no frame uses it
+	/// The descriptor set of each frame gets the new image when the frame starts, so the render loop doesn't wait for the frames in flight
+	/// Returns false and gives the change back to the streamer when the new image can't be created
+	bool setTextureResidency(const TextureResidency& change);
+	/// 15.17. Function to apply the residency changes of the streamed textures, it's called after the fence of the frame is signaled
+	void updateTextureStreaming(uint32_t currentImage);
+	/// 15.18. Function to create the staging buffer of all uploads that stays mapped and the timeline semaphore of the upload submissions
+	void createStagingRing();
+	/// 15.19. Function to reserve the region of the staging ring for the copy of the upload batch
+	/// When the ring is full, the collected copies are submitted, the CPU waits only when the uploads in flight take the whole ring
+	void reserveStaging(VkDeviceSize size, VkDeviceSize alignment, StagingRegion& region);
+	/// 15.20. Function to start recording of the command buffer of the transfer queue
+	VkCommandBuffer beginUpload();
+	/// 15.21. Function to submit the upload to the transfer queue without waiting, it signals the next value of the timeline semaphore
+	/// The frames that are submitted after it wait for the value on the GPU
+	void submitUpload(VkCommandBuffer commandBuffer);
+	/// 15.22. Function to free the command buffers of the finished uploads and to reclaim their regions of the staging ring, it doesn't wait
+	void collectUploads();
+	/// 15.23. Function to wait on the CPU until the timeline semaphore reaches the value
+	void waitUploads(uint64_t value);
+	/// 15.24. Function to record the acquire barriers of the released resources and the blits of their levels before the render pass of the frame
+	void recordUploadAcquires(VkCommandBuffer commandBuffer);
+	/// 15.25. Function to start the upload batch, the textures and the meshes that are created until endUploadBatch() are submitted together
+	void beginUploadBatch();
+	/// 15.26. Function to end the upload batch, the outer batch submits the collected uploads
+	void endUploadBatch();
+	/// 15.27. Function to record the collected uploads to one command buffer and submit it, the batch stays open
+	void flushUploadBatch();
 
 	// 16. Depth
 	/// 16.1. Function to set up resources
@@ -302,12 +477,50 @@ public:
 	bool hasStencilComponent(VkFormat format);
 
 	// 17. Models
-	/// 17.1. Function to load models
-	void loadModel();
+	/// 17.1. Function to load the model to the mesh cache
+	void loadModel(const std::string& modelPath, MeshCache& cache);
 	/// 17.2. Function to change the start point of the model
 	void performInitialRotation();
+	/// 17.3. Function to get the settings of the mesh processing from the options above
+	MeshCookSettings meshCookSettings();
+	/// 17.4. Function to verify that the shader variant of the layout exists and the device can read all its attributes
+	bool isVertexLayoutSupported(VertexLayout layout);
+	/// 17.5. Function to choose the level of detail by its projected error with the view and projection of the frame
+	uint32_t selectLod(const PoolMesh& mesh, const glm::mat4& modelView, uint32_t currentLod);
+	/// 17.6. Function to add the draw commands of the visible meshlets of the level of detail
+	void appendMeshletDraws(const PoolMesh& mesh, const MeshLod& lod, const glm::vec4 planes[6], const glm::vec3& cameraPosition, uint32_t objectIndex);
+	/// 17.7. Function to build the cube that is drawn until the model is loaded
+	void createPlaceholderMesh(MeshCache& cache);
+
+	// 18. Scene
+	/// 18.1. Function to fill the scene with the placeholder mesh, the models replace it when they are loaded
+	void loadScene();
+	/// 18.2. Function to copy the meshes of the scene that are already loaded to the geometry pool and to release their caches
+	void uploadScene();
+	/// 18.3. Function to copy the meshes to their ranges of the pool buffers through the staging ring
+	void uploadMeshes(const std::vector<uint32_t>& meshIds, const std::vector<const MeshCache*>& caches);
+	/// 18.4. Function to create the object and the indirect buffers of each frame
+	void createSceneBuffers();
+	/// 18.5. Function to choose the levels of detail, cull the objects and the meshlets and write the draw commands of the frame
+	void updateSceneDraws(uint32_t currentImage);
+	/// 18.6. Function to place the objects in a row by the sizes of their current meshes
+	void placeSceneObjects();
+	/// 18.7. Function to start the coroutines that load the models and the texture
+	void startAssetLoading();
+	/// 18.8. Coroutine to load the model on the worker threads and to upload it on the render thread in place of the placeholder
+	AssetTask<void> streamSceneMesh(uint32_t objectIndex);
+	/// 18.9. Coroutine to decode the texture on the worker threads and to add it to the bindless array on the render thread
+	AssetTask<void> streamTexture();
+	/// 18.10. Function to add the copy of the size bytes to the buffer through the staging ring to the upload batch, write() fills each chunk
+	/// write() gets the destination, the offset from the start of the data and the size of the chunk, the chunks are multiples of granularity
+	void stageToBuffer(VkBuffer buffer, VkDeviceSize bufferOffset, VkDeviceSize size, VkDeviceSize granularity,
+						const std::function<void(unsigned char*, VkDeviceSize, VkDeviceSize)>& write);
 
 	VkDevice get_device() { return device; };
+	// The usage of the video memory that was taken at the start of the last frame
+	const GpuMemorySnapshot& getMemorySnapshot() const { return memorySnapshot; };
+	// The stages of the initialization with their times
+	const TaskGraph& getStartupGraph() const { return startupGraph; };
 
 	void resizeWindow(int width, int height);
 
@@ -335,8 +548,16 @@ private:
 
 
 	VkDevice device;
+	// The allocator of the memory of all buffers and images
+	GpuAllocator gpuAllocator;
+	// True when the buffers are written by the CPU in the device local memory without the staging copy
+	bool directUpload;
+	GpuMemorySnapshot memorySnapshot;
 	VkQueue graphicsQueue;
 	VkQueue transferQueue;
+	// The families of the graphics and the transfer queues, the resources that are written by the transfer queue change their owner when they differ
+	uint32_t graphicsFamily;
+	uint32_t transferFamily;
 
 	VkSwapchainKHR swapChain;
 	std::vector<VkImage> swapChainImages;
@@ -349,50 +570,120 @@ private:
 	VkRenderPass renderPass;
 	VkDescriptorSetLayout descriptorSetLayout;
 	VkPipelineLayout pipelineLayout;
-	VkPipeline graphicsPipeline;
+	// One pipeline for each vertex layout, the layouts that can't be read by the device have VK_NULL_HANDLE
+	std::array<VkPipeline, VERTEX_LAYOUT_COUNT> graphicsPipelines;
 
 	std::vector<VkFramebuffer> swapChainFramebuffers;
 	VkCommandPool commandPool;
 	VkCommandPool commandPoolTransfer;
 
 
-	std::vector<Vertex> vertices;
-	std::vector<uint32_t> indices;
+	// The meshes of the scene share the vertex and the index buffers of the pool
+	GeometryPool geometryPool;
+	std::vector<SceneObject> sceneObjects;
+	// The caches of the meshes that are uploaded with the creation of the pool buffers
+	std::vector<std::unique_ptr<MeshCache>> sceneCaches;
+	// The matrices of the current frame, the model matrix is the rotation of the whole scene
+	UniformBufferObject frameUniforms;
 	VkBuffer vertexBuffer;
-	VkDeviceMemory vertexBufferMemory;
+	GpuAllocation vertexBufferMemory;
 	VkBuffer indexBuffer;
-	VkDeviceMemory indexBufferMemory;
+	GpuAllocation indexBufferMemory;
+
+	// The matrices and the texture indices of the objects (ObjectData), the vertex shader takes them by gl_InstanceIndex that is the firstInstance of the draw
+	std::vector<VkBuffer> objectBuffers;
+	std::vector<GpuAllocation> objectBuffersMemory;
+	std::vector<void*> objectBuffersMapped;
+	// The draw commands of each frame, they are grouped by the vertex layout
+	std::vector<VkBuffer> indirectBuffers;
+	std::vector<GpuAllocation> indirectBuffersMemory;
+	std::vector<void*> indirectBuffersMapped;
+	std::vector<VkDrawIndexedIndirectCommand> sceneDraws;
+	// The first draw command and the number of the commands of each vertex layout
+	std::array<uint32_t, VERTEX_LAYOUT_COUNT> layoutFirstDraw;
+	std::array<uint32_t, VERTEX_LAYOUT_COUNT> layoutDrawCount;
+	// The features of the device for the indirect draws, without them each command is drawn separately
+	bool multiDrawIndirect;
+	bool drawIndirectFirstInstance;
+	// True when the command buffers are cached, the number of the draws of each layout is read by the device from the end of the indirect buffer
+	bool commandCache;
 
 	std::vector<VkBuffer> uniformBuffers;
-	std::vector<VkDeviceMemory> uniformBuffersMemory;
+	std::vector<GpuAllocation> uniformBuffersMemory;
 	std::vector<void*> uniformBuffersMapped;
 
 	VkDescriptorPool descriptorPool;
 	std::vector<VkDescriptorSet> descriptorSets;
 
 	VkImage depthImage;
-	VkDeviceMemory depthMemory;
+	GpuAllocation depthMemory;
 	VkImageView depthImageView;
 
-	VkImage textureImage;
-	VkDeviceMemory textureImageMemory;
-	VkImageView textureImageView;
+	// The textures of the bindless array, the first one is the placeholder
+	std::vector<BindlessTexture> textures;
+	// One sampler for all textures, the views limit the levels of each texture
 	VkSampler textureSampler;
-
-	uint32_t mipLevels;
+	// The persistently mapped staging buffer of all uploads and its regions
+	VkBuffer stagingBuffer;
+	GpuAllocation stagingMemory;
+	StagingRing stagingRing;
+	// The fence of the single time commands that aren't uploads
+	VkFence uploadFence;
+	// The timeline semaphore of the transfer queue and the value of the last upload, the regions of the recorded copies are retired with the next value
+	VkSemaphore uploadTimeline;
+	uint64_t uploadSubmission;
+	// The uploads that the transfer queue hasn't finished yet
+	std::vector<UploadSubmission> uploadsInFlight;
+	// The resources released by the transfer queue that the next frame acquires
+	std::vector<UploadAcquire> pendingAcquires;
+	// The uploads that are collected for the next submission
+	UploadBatch uploadBatch;
+	// The size of the bindless array of the chosen device
+	uint32_t maxBindlessTextures;
+
+	// The residency of the mip levels of the streamed textures
+	TextureStreamer textureStreamer;
+	// The mip chains of the streamed textures in the system memory, the levels are uploaded from them, the element is empty for the other textures
+	std::vector<TextureData> textureSources;
+	// The textures that were replaced by the streaming, they are destroyed when the frame of the second element is finished
+	std::vector<std::pair<BindlessTexture, uint64_t>> retiredTextures;
+	// The elements of the bindless array that are written to the descriptor set of each frame when the frame starts
+	std::vector<std::vector<uint32_t>> pendingTextureWrites;
 
 	std::vector<VkCommandBuffer> commandBuffer;
 	std::vector<VkCommandBuffer> commandBufferTransfer;
+	// The command buffers of all swap chain images for each frame in flight, the element of the frame and the image is frame * image count + image
+	/// The command buffer of the frame records only the acquires of the uploads when the cache is used
+	std::vector<VkCommandBuffer> cachedCommandBuffers;
+	std::vector<bool> cachedRecorded;
+	// The vertex layouts that are drawn by the cached command buffers, one bit for each layout
+	uint32_t cachedLayouts;
+	// The command pools of each frame in flight with one secondary command buffer each, the thread that records the part of the draws uses its own pool
+	std::vector<std::vector<VkCommandPool>> recordPools;
+	std::vector<std::vector<VkCommandBuffer>> secondaryCommandBuffers;
+	// The number of the threads that record the draws of the frame
+	uint32_t recordThreads;
 
 
 	std::vector<VkSemaphore> imageAvailableSemaphore;
 	std::vector<VkSemaphore> renderFinishedSemaphore;
-	std::vector<VkFence> inFlightFence;
+	// The timeline semaphore of the frames, each frame signals its number when the GPU finishes it
+	VkSemaphore frameTimeline;
+	uint64_t frameSubmission;
+	uint32_t framesInFlight;
 	bool framebufferResized;
 	uint32_t currentFrame;
 
 	bool hasRotated;
 
+	// Worker threads for the CPU heavy parts of the asset loading
+	ThreadPool threadPool;
+	// The coroutines of the asset loading, they run on the worker threads and upload on the render thread
+	AssetLoader assetLoader;
+	// The stages of initVulkanLib(), they run one after another when serialStartup is true
+	TaskGraph startupGraph;
+	bool serialStartup;
+
 };
 
 #endif // SCREEN_H
\ No newline at end of file
@@ -2,9 +2,9 @@
 
 #include "Setup.h"
 
-Setup::Setup()
+Setup::Setup(uint32_t framesInFlight)
 {
-	Screen screen;
+	Screen screen(false, framesInFlight);
 
 	gameLoop(screen);
 	
@@ -9,7 +9,8 @@
 class Setup
 {
 public:
-	Setup();
+	// The number of the frames in flight is taken from the command line option --frames-in-flight
+	explicit Setup(uint32_t framesInFlight = 2);
 
 	void gameLoop(Screen &screen);
 	
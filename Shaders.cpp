@@ -1,5 +1,9 @@
 #include "Shaders.h"
 
+#include <map>
+#include <cstring>
+#include <stdexcept>
+
 std::vector<char> Shaders::readFile(const std::string& fileName)
 {
 	std::ifstream file(fileName, std::ios::ate | std::ios::binary);
@@ -17,3 +21,89 @@ std::vector<char> Shaders::readFile(const std::string& fileName)
 
 	return buffer;
 }
+
+
+
+ShaderInterface Shaders::readInterface(const std::vector<char>& code)
+{
+	const uint32_t SPIRV_MAGIC = 0x07230203;
+	const uint32_t OP_DECORATE = 71;
+	const uint32_t OP_VARIABLE = 59;
+	const uint32_t DECORATION_BUILT_IN = 11;
+	const uint32_t DECORATION_LOCATION = 30;
+	const uint32_t DECORATION_BINDING = 33;
+	const uint32_t DECORATION_DESCRIPTOR_SET = 34;
+	const uint32_t STORAGE_CLASS_INPUT = 1;
+
+	std::vector<uint32_t> words(code.size() / sizeof(uint32_t));
+	memcpy(words.data(), code.data(), words.size() * sizeof(uint32_t));
+	if (words.size() < 5 || code.size() % sizeof(uint32_t) != 0 || words[0] != SPIRV_MAGIC)
+	{
+		throw std::runtime_error("ERROR::Shaders::readInterface()::The code isn't a SPIR-V module");
+	}
+
+	// The decorations go before the variables in the module, so the variables are matched with them at the end
+	std::map<uint32_t, uint32_t> locations;
+	std::map<uint32_t, uint32_t> bindings;
+	std::map<uint32_t, uint32_t> sets;
+	std::map<uint32_t, bool> builtIns;
+	std::vector<uint32_t> inputs;
+	std::vector<uint32_t> variables;
+	for (size_t i = 5; i < words.size();)
+	{
+		uint32_t wordCount = words[i] >> 16;
+		uint32_t opcode = words[i] & 0xffff;
+		if (wordCount == 0 || i + wordCount > words.size())
+		{
+			throw std::runtime_error("ERROR::Shaders::readInterface()::The SPIR-V module is truncated");
+		}
+
+		if (opcode == OP_DECORATE && wordCount >= 3)
+		{
+			uint32_t target = words[i + 1];
+			uint32_t decoration = words[i + 2];
+			if (decoration == DECORATION_BUILT_IN)
+			{
+				builtIns[target] = true;
+			}
+			else if (wordCount >= 4 && decoration == DECORATION_LOCATION)
+			{
+				locations[target] = words[i + 3];
+			}
+			else if (wordCount >= 4 && decoration == DECORATION_BINDING)
+			{
+				bindings[target] = words[i + 3];
+			}
+			else if (wordCount >= 4 && decoration == DECORATION_DESCRIPTOR_SET)
+			{
+				sets[target] = words[i + 3];
+			}
+		}
+		else if (opcode == OP_VARIABLE && wordCount >= 4)
+		{
+			variables.push_back(words[i + 2]);
+			if (words[i + 3] == STORAGE_CLASS_INPUT)
+			{
+				inputs.push_back(words[i + 2]);
+			}
+		}
+		i += wordCount;
+	}
+
+	ShaderInterface shaderInterface;
+	for (uint32_t input : inputs)
+	{
+		if (!builtIns[input] && locations.count(input) != 0)
+		{
+			shaderInterface.inputLocations.push_back(locations[input]);
+		}
+	}
+	for (uint32_t variable : variables)
+	{
+		if (bindings.count(variable) != 0 && sets[variable] == 0)
+		{
+			shaderInterface.bindings.push_back(bindings[variable]);
+		}
+	}
+	return shaderInterface;
+}
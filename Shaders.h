@@ -4,12 +4,24 @@
 #include <vector>
 #include <fstream>
 #include <ostream>
+#include <string>
+#include <cstdint>
 
+// The resources that the SPIR-V module declares, the pipeline checks them against its vertex input and descriptor set layout
+struct ShaderInterface
+{
+	// The locations of the input variables of the entry point, the built-in inputs aren't counted
+	std::vector<uint32_t> inputLocations;
+	// The bindings of the descriptors in the set 0
+	std::vector<uint32_t> bindings;
+};
 
 class Shaders
 {
 public:
 	std::vector<char> readFile(const std::string& fileName);
+	// Function to read the inputs and the descriptor bindings of the SPIR-V module, throws when the code isn't SPIR-V
+	ShaderInterface readInterface(const std::vector<char>& code);
 
 
 private:
@@ -1,3 +1,5 @@
-O:/C++/Libraries/VulkanSDK/Bin/glslc.exe Vertex_Triangle.vert -o vert.spv
-O:/C++/Libraries/VulkanSDK/Bin/glslc.exe Fragment_Triangle.frag -o frag.spv
+O:/C++/Libraries/VulkanSDK/Bin/glslc.exe Vertex_Triangle.vert -o vert.spv && O:/C++/Libraries/VulkanSDK/Bin/spirv-val.exe --target-env vulkan1.0 vert.spv || del vert.spv
+O:/C++/Libraries/VulkanSDK/Bin/glslc.exe Fragment_Triangle.frag -o frag.spv && O:/C++/Libraries/VulkanSDK/Bin/spirv-val.exe --target-env vulkan1.0 frag.spv || del frag.spv
+O:/C++/Libraries/VulkanSDK/Bin/glslc.exe Vertex_Compact.vert -o vert_compact.spv && O:/C++/Libraries/VulkanSDK/Bin/spirv-val.exe --target-env vulkan1.0 vert_compact.spv || del vert_compact.spv
+O:/C++/Libraries/VulkanSDK/Bin/glslc.exe Vertex_CompactNormal.vert -o vert_compact_normal.spv && O:/C++/Libraries/VulkanSDK/Bin/spirv-val.exe --target-env vulkan1.0 vert_compact_normal.spv || del vert_compact_normal.spv
 pause
\ No newline at end of file
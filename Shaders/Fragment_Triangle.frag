@@ -1,13 +1,18 @@
 #version 450
+#extension GL_EXT_nonuniform_qualifier : require
 
-layout(binding = 1) uniform sampler2D texSampler;
+// The sampler is shared by all textures of the bindless array
+layout(binding = 1) uniform sampler texSampler;
+layout(binding = 3) uniform texture2D textures[];
 
 layout(location = 0) in vec3 fragColor;
 layout(location = 1) in vec2 fragTexCoord;
+layout(location = 3) flat in uint fragTextureIndex;
 
 layout(location = 0) out vec4 outColor;
 
 void main()
 {
-	outColor = texture(texSampler, fragTexCoord);
+	// The fragments of the different draws can share one wave, so the index is marked as non-uniform
+	outColor = texture(sampler2D(textures[nonuniformEXT(fragTextureIndex)], texSampler), fragTexCoord);
 }
@@ -0,0 +1,37 @@
+#version 450
+
+layout(binding = 0) uniform UniformBufferObject
+{
+	mat4 model;
+	mat4 view;
+	mat4 proj;
+} ubo;
+
+// The data of the scene objects, the firstInstance of the draw command is the index of the object
+struct ObjectData
+{
+	mat4 model;
+	// The x component is the index of the texture in the bindless array
+	uvec4 material;
+};
+
+layout(std430, binding = 2) readonly buffer ObjectBuffer
+{
+	ObjectData objects[];
+} objectBuffer;
+
+// The position is unorm16 in the bounds of the mesh, the object matrix contains the scale and the offset of the bounds
+layout(location = 0) in vec3 inPosition;
+layout(location = 2) in vec2 inTexCoord;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 3) flat out uint fragTextureIndex;
+
+void main()
+{
+	gl_Position = ubo.proj * ubo.view * ubo.model * objectBuffer.objects[gl_InstanceIndex].model * vec4(inPosition, 1.0);
+	fragColor = vec3(1.0);
+	fragTexCoord = inTexCoord;
+	fragTextureIndex = objectBuffer.objects[gl_InstanceIndex].material.x;
+}
@@ -0,0 +1,51 @@
+#version 450
+
+layout(binding = 0) uniform UniformBufferObject
+{
+	mat4 model;
+	mat4 view;
+	mat4 proj;
+} ubo;
+
+// The data of the scene objects, the firstInstance of the draw command is the index of the object
+struct ObjectData
+{
+	mat4 model;
+	// The x component is the index of the texture in the bindless array
+	uvec4 material;
+};
+
+layout(std430, binding = 2) readonly buffer ObjectBuffer
+{
+	ObjectData objects[];
+} objectBuffer;
+
+// The position is unorm16 in the bounds of the mesh, the object matrix contains the scale and the offset of the bounds
+layout(location = 0) in vec3 inPosition;
+layout(location = 2) in vec2 inTexCoord;
+// The normal is packed by the octahedral mapping
+layout(location = 3) in vec2 inNormal;
+
+layout(location = 0) out vec3 fragColor;
+layout(location = 1) out vec2 fragTexCoord;
+layout(location = 2) out vec3 fragNormal;
+layout(location = 3) flat out uint fragTextureIndex;
+
+vec3 decodeOctahedral(vec2 encoded)
+{
+	vec3 normal = vec3(encoded, 1.0 - abs(encoded.x) - abs(encoded.y));
+	float fold = max(-normal.z, 0.0);
+	normal.x += normal.x >= 0.0 ? -fold : fold;
+	normal.y += normal.y >= 0.0 ? -fold : fold;
+	return normalize(normal);
+}
+
+void main()
+{
+	gl_Position = ubo.proj * ubo.view * ubo.model * objectBuffer.objects[gl_InstanceIndex].model * vec4(inPosition, 1.0);
+	fragColor = vec3(1.0);
+	fragTexCoord = inTexCoord;
+	fragTextureIndex = objectBuffer.objects[gl_InstanceIndex].material.x;
+	// The normal stays in the model space, the object matrix has the non-uniform scale of the bounds
+	fragNormal = decodeOctahedral(inNormal);
+}
@@ -0,0 +1,128 @@
+// StagingRing.cpp
+#include "StagingRing.h"
+
+StagingRing::StagingRing()
+{
+	memory = nullptr;
+	size = 0;
+	tail = 0;
+	nextId = 1;
+}
+
+
+
+void StagingRing::reset(void* mapped, uint64_t size)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	regions.clear();
+	memory = static_cast<unsigned char*>(mapped);
+	this->size = size;
+	tail = 0;
+}
+
+
+
+bool StagingRing::reserve(uint64_t size, uint64_t alignment, StagingRegion& region)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	if (size == 0 || size > this->size)
+	{
+		return false;
+	}
+
+	uint64_t offset = (tail + alignment - 1) / alignment * alignment;
+	if (!regions.empty())
+	{
+		uint64_t head = regions.front().begin;
+		if (tail > head)
+		{
+			// The used space doesn't wrap, the region goes after it or to the start of the ring before the oldest region
+			if (offset + size > this->size)
+			{
+				offset = 0;
+				if (size >= head)
+				{
+					return false;
+				}
+			}
+		}
+		else if (offset + size >= head)
+		{
+			// The used space wraps, the region has to fit between the newest and the oldest regions
+			return false;
+		}
+	}
+	else if (offset + size > this->size)
+	{
+		offset = 0;
+	}
+
+	region.id = nextId++;
+	region.offset = offset;
+	region.size = size;
+	region.data = memory + offset;
+	regions.push_back(Entry{ region.id, offset, offset + size, false, 0 });
+	tail = offset + size;
+	return true;
+}
+
+
+
+void StagingRing::release(const StagingRegion& region)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (Entry& entry : regions)
+	{
+		if (entry.id == region.id)
+		{
+			entry.released = true;
+			break;
+		}
+	}
+	popReleased();
+}
+
+
+
+void StagingRing::retire(const StagingRegion& region, uint64_t submission)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (Entry& entry : regions)
+	{
+		if (entry.id == region.id)
+		{
+			entry.submission = submission;
+			break;
+		}
+	}
+}
+
+
+
+void StagingRing::reclaim(uint64_t completedSubmission)
+{
+	std::lock_guard<std::mutex> lock(mutex);
+	for (Entry& entry : regions)
+	{
+		if (entry.submission != 0 && entry.submission <= completedSubmission)
+		{
+			entry.released = true;
+		}
+	}
+	popReleased();
+}
+
+
+
+void StagingRing::popReleased()
+{
+	// The space is freed from the oldest region, so the ring stays one continuous range
+	while (!regions.empty() && regions.front().released)
+	{
+		regions.pop_front();
+	}
+	if (regions.empty())
+	{
+		tail = 0;
+	}
+}
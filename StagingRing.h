@@ -0,0 +1,69 @@
+// StagingRing.h
+
+#ifndef STAGINGRING_H
+#define STAGINGRING_H
+
+#include <deque>
+#include <mutex>
+#include <cstdint>
+
+// The reserved part of the staging ring, the CPU writes to data and the GPU copies from offset of the ring buffer
+struct StagingRegion
+{
+	uint64_t id;
+	uint64_t offset;
+	uint64_t size;
+	unsigned char* data;
+};
+
+// The class that hands out the regions of one persistently mapped staging buffer
+/// The regions are taken one after another and the ring wraps to its start, so no memory is allocated for the uploads
+/// The regions are released in any order when the GPU has read them, the space is reused after all older regions are released
+/// The region that is read by a submission is retired with its number and released by reclaim() when the submission is completed
+/// reserve(), release() and retire() are called from the worker threads and the render thread
+class StagingRing
+{
+public:
+	StagingRing();
+
+	StagingRing(const StagingRing&) = delete;
+	StagingRing& operator=(const StagingRing&) = delete;
+
+	// 1. Function to set the mapped memory of the staging buffer, the regions of the previous memory must be released
+	void reset(void* mapped, uint64_t size);
+	// 2. Function to reserve the region, returns false when the ring is full until the older regions are released
+	bool reserve(uint64_t size, uint64_t alignment, StagingRegion& region);
+	// 3. Function to release the region when the GPU has finished the copy from it
+	void release(const StagingRegion& region);
+	// 4. Function to release the region when the submission that copies from it is completed
+	void retire(const StagingRegion& region, uint64_t submission);
+	// 5. Function to release the retired regions of the submissions up to the completed one
+	void reclaim(uint64_t completedSubmission);
+
+	uint64_t capacity() const { return size; };
+
+private:
+	struct Entry
+	{
+		uint64_t id;
+		uint64_t begin;
+		uint64_t end;
+		bool released;
+		// The submission that reads the retired region, 0 until it's retired
+		uint64_t submission;
+	};
+
+	// Function to drop the released regions from the oldest one
+	void popReleased();
+
+	std::mutex mutex;
+	// The reserved regions from the oldest one, the oldest one is the start of the used space
+	std::deque<Entry> regions;
+	unsigned char* memory;
+	uint64_t size;
+	// The end of the newest region, the next region is placed after it or at the start of the ring
+	uint64_t tail;
+	uint64_t nextId;
+};
+
+#endif // STAGINGRING_H
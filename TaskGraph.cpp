@@ -0,0 +1,261 @@
+// TaskGraph.cpp
+#include "TaskGraph.h"
+
+#include <deque>
+#include <chrono>
+#include <exception>
+#include <stdexcept>
+#include <condition_variable>
+
+using TaskClock = std::chrono::high_resolution_clock;
+
+static double milliseconds(TaskClock::duration duration)
+{
+	return std::chrono::duration<double, std::chrono::milliseconds::period>(duration).count();
+}
+
+
+
+struct TaskGraph::RunState
+{
+	std::vector<Task>* tasks;
+	ThreadPool* pool;
+	TaskClock::time_point startTime;
+
+	std::mutex mutex;
+	std::condition_variable changed;
+	// The tasks whose dependencies are finished, the main thread tasks are taken only by the calling thread of run()
+	std::deque<uint32_t> ready;
+	std::deque<uint32_t> readyMain;
+	// The number of the unfinished dependencies of each task
+	std::vector<uint32_t> waiting;
+	// The tasks that aren't started because their dependency has failed
+	std::vector<bool> skipped;
+	size_t finished;
+	std::exception_ptr error;
+};
+
+
+
+TaskGraph::TaskGraph()
+{
+	lastWallTime = 0.0;
+}
+
+
+
+uint32_t TaskGraph::add(const std::string& name, std::function<void()> task, const std::vector<uint32_t>& dependencies, bool mainThread)
+{
+	uint32_t index = static_cast<uint32_t>(tasks.size());
+	for (uint32_t dependency : dependencies)
+	{
+		// The dependencies that are added before the task keep the graph without cycles
+		if (dependency >= index)
+		{
+			throw std::runtime_error("ERROR::TaskGraph::add()::The dependency of " + name + " isn't added yet");
+		}
+		tasks[dependency].dependents.push_back(index);
+	}
+
+	tasks.push_back(Task{ name, std::move(task), dependencies, {}, mainThread, TaskTiming{ 0.0, 0.0 } });
+	return index;
+}
+
+
+
+void TaskGraph::run(ThreadPool& pool)
+{
+	auto state = std::make_shared<RunState>();
+	state->tasks = &tasks;
+	state->pool = &pool;
+	state->startTime = TaskClock::now();
+	state->waiting.resize(tasks.size());
+	state->skipped.assign(tasks.size(), false);
+	state->finished = 0;
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	size_t helperCount = 0;
+	for (uint32_t i = 0; i < static_cast<uint32_t>(tasks.size()); ++i)
+	{
+		tasks[i].timing = TaskTiming{ 0.0, 0.0 };
+		state->waiting[i] = static_cast<uint32_t>(tasks[i].dependencies.size());
+		if (state->waiting[i] == 0)
+		{
+			(tasks[i].mainThread ? state->readyMain : state->ready).push_back(i);
+			helperCount += tasks[i].mainThread ? 0 : 1;
+		}
+	}
+	lock.unlock();
+	for (size_t i = 0; i < helperCount; ++i)
+	{
+		pool.submit([state]() { helper(state); });
+	}
+	lock.lock();
+
+	// The calling thread runs the main thread tasks first and helps the pool while it has nothing else to do
+	while (state->finished < tasks.size())
+	{
+		if (!state->readyMain.empty())
+		{
+			uint32_t index = state->readyMain.front();
+			state->readyMain.pop_front();
+			execute(state, index, lock);
+		}
+		else if (!state->ready.empty())
+		{
+			uint32_t index = state->ready.front();
+			state->ready.pop_front();
+			execute(state, index, lock);
+		}
+		else
+		{
+			state->changed.wait(lock);
+		}
+	}
+	lastWallTime = milliseconds(TaskClock::now() - state->startTime);
+
+	if (state->error)
+	{
+		std::rethrow_exception(state->error);
+	}
+}
+
+
+
+void TaskGraph::runSerial()
+{
+	TaskClock::time_point startTime = TaskClock::now();
+	for (Task& task : tasks)
+	{
+		TaskClock::time_point begin = TaskClock::now();
+		task.body();
+		task.timing = TaskTiming{ milliseconds(begin - startTime), milliseconds(TaskClock::now() - begin) };
+	}
+	lastWallTime = milliseconds(TaskClock::now() - startTime);
+}
+
+
+
+double TaskGraph::criticalPath(std::vector<uint32_t>& path) const
+{
+	path.clear();
+	if (tasks.empty())
+	{
+		return 0.0;
+	}
+
+	// The dependencies are added before their tasks, so the chains are counted in the order of the tasks
+	std::vector<double> finish(tasks.size());
+	std::vector<uint32_t> previous(tasks.size(), UINT32_MAX);
+	uint32_t last = 0;
+	for (uint32_t i = 0; i < static_cast<uint32_t>(tasks.size()); ++i)
+	{
+		double start = 0.0;
+		for (uint32_t dependency : tasks[i].dependencies)
+		{
+			if (finish[dependency] > start)
+			{
+				start = finish[dependency];
+				previous[i] = dependency;
+			}
+		}
+		finish[i] = start + tasks[i].timing.duration;
+		last = (finish[i] > finish[last]) ? i : last;
+	}
+
+	for (uint32_t task = last; task != UINT32_MAX; task = previous[task])
+	{
+		path.insert(path.begin(), task);
+	}
+	return finish[last];
+}
+
+
+
+void TaskGraph::clear()
+{
+	tasks.clear();
+	lastWallTime = 0.0;
+}
+
+
+
+double TaskGraph::totalTime() const
+{
+	double total = 0.0;
+	for (const Task& task : tasks)
+	{
+		total += task.timing.duration;
+	}
+	return total;
+}
+
+
+
+void TaskGraph::execute(const std::shared_ptr<RunState>& state, uint32_t index, std::unique_lock<std::mutex>& lock)
+{
+	Task& task = (*state->tasks)[index];
+	bool skip = state->skipped[index];
+
+	lock.unlock();
+	TaskClock::time_point begin = TaskClock::now();
+	std::exception_ptr error;
+	if (!skip)
+	{
+		try
+		{
+			task.body();
+		}
+		catch (...)
+		{
+			error = std::current_exception();
+		}
+	}
+	TaskClock::time_point end = TaskClock::now();
+	lock.lock();
+
+	task.timing = TaskTiming{ milliseconds(begin - state->startTime), milliseconds(end - begin) };
+	if (error && !state->error)
+	{
+		state->error = error;
+	}
+
+	// The failure goes to all tasks that depend on this one, they are finished without running
+	size_t helperCount = 0;
+	for (uint32_t dependent : task.dependents)
+	{
+		if (skip || error)
+		{
+			state->skipped[dependent] = true;
+		}
+		if (--state->waiting[dependent] == 0)
+		{
+			bool mainThread = (*state->tasks)[dependent].mainThread;
+			(mainThread ? state->readyMain : state->ready).push_back(dependent);
+			helperCount += mainThread ? 0 : 1;
+		}
+	}
+	++state->finished;
+	state->changed.notify_all();
+
+	// One helper of the pool for each new task, the pool without workers runs the helper on this thread
+	lock.unlock();
+	for (size_t i = 0; i < helperCount; ++i)
+	{
+		state->pool->submit([state]() { helper(state); });
+	}
+	lock.lock();
+}
+
+
+
+void TaskGraph::helper(const std::shared_ptr<RunState>& state)
+{
+	std::unique_lock<std::mutex> lock(state->mutex);
+	while (!state->ready.empty())
+	{
+		uint32_t index = state->ready.front();
+		state->ready.pop_front();
+		execute(state, index, lock);
+	}
+}
@@ -0,0 +1,77 @@
+// TaskGraph.h
+
+#ifndef TASKGRAPH_H
+#define TASKGRAPH_H
+
+#include "ThreadPool.h"
+
+#include <string>
+#include <vector>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <cstdint>
+
+// The time of the task in the last run in milliseconds, the start is counted from the start of the run
+struct TaskTiming
+{
+	double start;
+	double duration;
+};
+
+// The graph of the tasks with the declared dependencies, each task starts when all tasks it depends on are finished
+/// The tasks that have to stay on the calling thread (the window, the queues) are marked as mainThread, the others run on the thread pool
+/// The calling thread takes the ready tasks of the pool too, so the graph goes on while the workers are busy with other work
+class TaskGraph
+{
+public:
+	TaskGraph();
+
+	TaskGraph(const TaskGraph&) = delete;
+	TaskGraph& operator=(const TaskGraph&) = delete;
+
+	// 1. Function to add the task, the dependencies are the indices of the tasks that were added before, returns the index of the task
+	uint32_t add(const std::string& name, std::function<void()> task, const std::vector<uint32_t>& dependencies = {}, bool mainThread = false);
+	// 2. Function to run all tasks on the pool and on the calling thread, it returns when all of them are finished
+	/// The first exception of the tasks is thrown at the end, the tasks that depend on the failed one aren't started
+	void run(ThreadPool& pool);
+	// 3. Function to run all tasks one after another on the calling thread in the order they were added
+	void runSerial();
+	// 4. Function to get the longest chain of the dependencies by the times of the last run, the path is the tasks of the chain from the first one
+	double criticalPath(std::vector<uint32_t>& path) const;
+	// 5. Function to remove all tasks
+	void clear();
+
+	uint32_t size() const { return static_cast<uint32_t>(tasks.size()); };
+	const std::string& name(uint32_t task) const { return tasks[task].name; };
+	const TaskTiming& timing(uint32_t task) const { return tasks[task].timing; };
+	// The time of the last run from its start to the end of the last task
+	double wallTime() const { return lastWallTime; };
+	// The sum of the times of all tasks, it's the time of the run on one thread
+	double totalTime() const;
+
+private:
+	struct Task
+	{
+		std::string name;
+		std::function<void()> body;
+		// The tasks that this one waits for and the tasks that wait for it
+		std::vector<uint32_t> dependencies;
+		std::vector<uint32_t> dependents;
+		bool mainThread;
+		TaskTiming timing;
+	};
+
+	// The state of run() that is shared with the helper tasks of the pool, which may start after the run is finished
+	struct RunState;
+
+	// Function to run the task and to make its dependents ready, the lock is taken before and after the call
+	static void execute(const std::shared_ptr<RunState>& state, uint32_t index, std::unique_lock<std::mutex>& lock);
+	// The helper task of the pool that takes the ready tasks until there are none
+	static void helper(const std::shared_ptr<RunState>& state);
+
+	std::vector<Task> tasks;
+	double lastWallTime;
+};
+
+#endif // TASKGRAPH_H
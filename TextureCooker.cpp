@@ -0,0 +1,225 @@
+// TextureCooker.cpp
+#include "TextureCooker.h"
+#include "MipGenerator.h"
+#include "Ktx2Loader.h"
+#include "TextureDecoder.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace
+{
+	// Function to quantize the color to the 5:6:5 bits of the BC1 endpoint
+	uint16_t packColor565(const float color[3])
+	{
+		uint32_t r = static_cast<uint32_t>(std::clamp(color[0], 0.0f, 255.0f) * 31.0f / 255.0f + 0.5f);
+		uint32_t g = static_cast<uint32_t>(std::clamp(color[1], 0.0f, 255.0f) * 63.0f / 255.0f + 0.5f);
+		uint32_t b = static_cast<uint32_t>(std::clamp(color[2], 0.0f, 255.0f) * 31.0f / 255.0f + 0.5f);
+		return static_cast<uint16_t>((r << 11) | (g << 5) | b);
+	}
+
+	// Function to expand the endpoint back to 8 bits per channel the same way as the GPU does
+	void unpackColor565(uint16_t packed, int color[3])
+	{
+		int r = (packed >> 11) & 31;
+		int g = (packed >> 5) & 63;
+		int b = packed & 31;
+		color[0] = (r << 3) | (r >> 2);
+		color[1] = (g << 2) | (g >> 4);
+		color[2] = (b << 3) | (b >> 2);
+	}
+}
+
+TextureCooker::TextureCooker(ThreadPool& pool, const TextureCookSettings& settings) : pool(pool), settings(settings)
+{
+}
+
+
+
+void TextureCooker::cook(const std::string& imagePath, const std::string& texturePath)
+{
+	TextureData texture{};
+	TextureDecoder::Header header;
+	if (!TextureDecoder::readInfo(imagePath, header))
+	{
+		throw std::runtime_error("ERROR::TextureCooker::cook()::Failed to load texture image: " + imagePath);
+	}
+	texture.width = header.width;
+	texture.height = header.height;
+
+	// The levels are built in the same way as the CPU fallback of the renderer, after the first level that is decoded into the chain
+	texture.format = VK_FORMAT_R8G8B8A8_SRGB;
+	texture.pixels.resize(static_cast<size_t>(texture.width) * texture.height * 4);
+	TextureDecoder::decode(imagePath, header, texture.pixels.data());
+	MipGenerator generator(pool);
+	generator.generateInPlace(texture.pixels, texture.width, texture.height, true, texture.levels);
+
+	if (settings.compressBC1)
+	{
+		// The BC1 levels take 8 bytes for each 4x4 block, the levels smaller than the block take the whole block
+		std::vector<MipLevel> levels;
+		uint64_t totalSize = 0;
+		for (const auto& level : texture.levels)
+		{
+			levels.push_back(MipLevel{ totalSize, level.width, level.height });
+			totalSize += static_cast<uint64_t>((level.width + 3) / 4) * ((level.height + 3) / 4) * 8;
+		}
+
+		std::vector<unsigned char> blocks(static_cast<size_t>(totalSize));
+		for (size_t i = 0; i < levels.size(); ++i)
+		{
+			encodeBC1(texture.pixels.data() + texture.levels[i].offset, levels[i].width, levels[i].height, blocks.data() + levels[i].offset);
+		}
+
+		texture.pixels.swap(blocks);
+		texture.levels.swap(levels);
+		texture.format = VK_FORMAT_BC1_RGB_SRGB_BLOCK;
+	}
+
+	Ktx2Loader::save(texturePath, texture);
+}
+
+
+
+void TextureCooker::encodeBC1(const unsigned char* pixels, uint32_t width, uint32_t height, unsigned char* blocks)
+{
+	uint32_t blocksX = (width + 3) / 4;
+	uint32_t blocksY = (height + 3) / 4;
+	pool.parallelFor(blocksY, [&](size_t blockY)
+	{
+		for (uint32_t blockX = 0; blockX < blocksX; ++blockX)
+		{
+			// The texels outside of the level repeat its edge
+			unsigned char texels[16][4];
+			for (uint32_t y = 0; y < 4; ++y)
+			{
+				for (uint32_t x = 0; x < 4; ++x)
+				{
+					uint32_t px = std::min(blockX * 4 + x, width - 1);
+					uint32_t py = std::min(static_cast<uint32_t>(blockY) * 4 + y, height - 1);
+					const unsigned char* texel = pixels + (static_cast<size_t>(py) * width + px) * 4;
+					std::copy(texel, texel + 4, texels[y * 4 + x]);
+				}
+			}
+			encodeBC1Block(texels, blocks + (blockY * blocksX + blockX) * 8);
+		}
+	});
+}
+
+
+
+void TextureCooker::encodeBC1Block(const unsigned char texels[16][4], unsigned char* block)
+{
+	// The endpoints are the ends of the range of the texels along the main axis of their colors
+	float mean[3] = { 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; ++i)
+	{
+		for (int c = 0; c < 3; ++c)
+		{
+			mean[c] += texels[i][c] / 16.0f;
+		}
+	}
+
+	float covariance[6] = { 0.0f, 0.0f, 0.0f, 0.0f, 0.0f, 0.0f };
+	for (int i = 0; i < 16; ++i)
+	{
+		float r = texels[i][0] - mean[0];
+		float g = texels[i][1] - mean[1];
+		float b = texels[i][2] - mean[2];
+		covariance[0] += r * r;
+		covariance[1] += r * g;
+		covariance[2] += r * b;
+		covariance[3] += g * g;
+		covariance[4] += g * b;
+		covariance[5] += b * b;
+	}
+
+	// The power iteration converges to the eigenvector of the largest eigenvalue in a few steps
+	float axis[3] = { 1.0f, 1.0f, 1.0f };
+	for (int iteration = 0; iteration < 8; ++iteration)
+	{
+		float next[3] = {
+			covariance[0] * axis[0] + covariance[1] * axis[1] + covariance[2] * axis[2],
+			covariance[1] * axis[0] + covariance[3] * axis[1] + covariance[4] * axis[2],
+			covariance[2] * axis[0] + covariance[4] * axis[1] + covariance[5] * axis[2]
+		};
+		float length = std::max({ std::fabs(next[0]), std::fabs(next[1]), std::fabs(next[2]) });
+		if (length < 1e-6f)
+		{
+			break;
+		}
+		for (int c = 0; c < 3; ++c)
+		{
+			axis[c] = next[c] / length;
+		}
+	}
+
+	float minProjection = std::numeric_limits<float>::max();
+	float maxProjection = -std::numeric_limits<float>::max();
+	float axisLength = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+	for (int i = 0; i < 16; ++i)
+	{
+		float projection = ((texels[i][0] - mean[0]) * axis[0] + (texels[i][1] - mean[1]) * axis[1] + (texels[i][2] - mean[2]) * axis[2]) / axisLength;
+		minProjection = std::min(minProjection, projection);
+		maxProjection = std::max(maxProjection, projection);
+	}
+
+	float start[3], end[3];
+	for (int c = 0; c < 3; ++c)
+	{
+		start[c] = mean[c] + axis[c] * maxProjection;
+		end[c] = mean[c] + axis[c] * minProjection;
+	}
+
+	// The four color mode needs color0 > color1, the equal endpoints make the block of one color
+	uint16_t color0 = packColor565(start);
+	uint16_t color1 = packColor565(end);
+	if (color0 < color1)
+	{
+		std::swap(color0, color1);
+	}
+
+	uint32_t indices = 0;
+	if (color0 != color1)
+	{
+		int palette[4][3];
+		unpackColor565(color0, palette[0]);
+		unpackColor565(color1, palette[1]);
+		for (int c = 0; c < 3; ++c)
+		{
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+
+		for (int i = 0; i < 16; ++i)
+		{
+			uint32_t best = 0;
+			int bestDistance = std::numeric_limits<int>::max();
+			for (uint32_t p = 0; p < 4; ++p)
+			{
+				int dr = texels[i][0] - palette[p][0];
+				int dg = texels[i][1] - palette[p][1];
+				int db = texels[i][2] - palette[p][2];
+				int distance = dr * dr + dg * dg + db * db;
+				if (distance < bestDistance)
+				{
+					bestDistance = distance;
+					best = p;
+				}
+			}
+			indices |= best << (2 * i);
+		}
+	}
+
+	// The endpoints and the indices are little endian, the first texel is in the lowest bits
+	block[0] = static_cast<unsigned char>(color0 & 0xFF);
+	block[1] = static_cast<unsigned char>(color0 >> 8);
+	block[2] = static_cast<unsigned char>(color1 & 0xFF);
+	block[3] = static_cast<unsigned char>(color1 >> 8);
+	for (int i = 0; i < 4; ++i)
+	{
+		block[4 + i] = static_cast<unsigned char>((indices >> (8 * i)) & 0xFF);
+	}
+}
@@ -0,0 +1,39 @@
+// TextureCooker.h
+
+#ifndef TEXTURECOOKER_H
+#define TEXTURECOOKER_H
+
+#include "ThreadPool.h"
+#include "TextureData.h"
+
+#include <string>
+#include <cstdint>
+
+// The processing steps of the texture
+struct TextureCookSettings
+{
+	// Encoding of all levels to BC1, otherwise the levels stay in RGBA8
+	/// BC1 keeps no alpha, so it's meant for the color textures without transparency
+	bool compressBC1;
+};
+
+// The class that turns the image into the KTX2 texture with the whole mip chain, the renderer uploads it without decoding
+class TextureCooker
+{
+public:
+	TextureCooker(ThreadPool& pool, const TextureCookSettings& settings);
+
+	// 1. Function to decode the image, to build its levels and to write them to texturePath
+	void cook(const std::string& imagePath, const std::string& texturePath);
+
+private:
+	// Function to encode the RGBA8 level to the 4x4 BC1 blocks, the blocks are encoded in parallel
+	void encodeBC1(const unsigned char* pixels, uint32_t width, uint32_t height, unsigned char* blocks);
+	// Function to encode one block of 16 texels
+	static void encodeBC1Block(const unsigned char texels[16][4], unsigned char* block);
+
+	ThreadPool& pool;
+	TextureCookSettings settings;
+};
+
+#endif // TEXTURECOOKER_H
@@ -0,0 +1,29 @@
+// TextureData.h
+
+#ifndef TEXTUREDATA_H
+#define TEXTUREDATA_H
+
+#include "MipGenerator.h"
+#include "StagingRing.h"
+
+#include <vulkan/vulkan.h>
+
+#include <vector>
+#include <cstdint>
+
+// The decoded texture that is ready for the upload
+/// The RGBA8 pixels have no levels, createTextureImage() builds their mip chain
+/// The texture loaded from KTX2 keeps all levels that were stored in the file one after another in pixels
+/// The image that was decoded straight into the staging ring has the empty pixels, its RGBA8 level is in the staged region
+struct TextureData
+{
+	std::vector<unsigned char> pixels;
+	uint32_t width;
+	uint32_t height;
+	VkFormat format = VK_FORMAT_R8G8B8A8_SRGB;
+	std::vector<MipLevel> levels;
+	// The region of the staging ring with the pixels, its size is 0 when the pixels are in the vector
+	StagingRegion staged{};
+};
+
+#endif // TEXTUREDATA_H
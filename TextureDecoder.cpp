@@ -0,0 +1,115 @@
+// TextureDecoder.cpp
+#include "TextureDecoder.h"
+
+#include <stb_image.h>
+
+#include <stdexcept>
+#include <cstring>
+
+// The shuffle of SSSE3 is compiled on all x86 targets, MSVC doesn't define __SSSE3__, so the CPU is checked when the program runs
+#if defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__x86_64__) || defined(__i386__)
+#include <tmmintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#define TEXTURE_DECODER_TARGET_SSSE3
+#else
+#define TEXTURE_DECODER_TARGET_SSSE3 __attribute__((target("ssse3")))
+#endif
+#define TEXTURE_DECODER_SSSE3
+#endif
+
+#ifdef TEXTURE_DECODER_SSSE3
+static bool hasSsse3()
+{
+#ifdef _MSC_VER
+	int info[4];
+	__cpuid(info, 1);
+	return (info[2] & (1 << 9)) != 0;
+#else
+	return __builtin_cpu_supports("ssse3");
+#endif
+}
+
+
+
+// Four pixels are moved to their places by one shuffle, the load reads 16 bytes, so the last pixels are left to the caller, returns the number of done pixels
+TEXTURE_DECODER_TARGET_SSSE3 static size_t expandRgbToRgbaSsse3(const unsigned char* rgb, size_t pixelCount, unsigned char* rgba)
+{
+	const __m128i shuffle = _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+	const __m128i alpha = _mm_set1_epi32(static_cast<int>(0xFF000000));
+	size_t i = 0;
+	for (; i + 6 <= pixelCount; i += 4)
+	{
+		__m128i source = _mm_loadu_si128(reinterpret_cast<const __m128i*>(rgb + 3 * i));
+		_mm_storeu_si128(reinterpret_cast<__m128i*>(rgba + 4 * i), _mm_or_si128(_mm_shuffle_epi8(source, shuffle), alpha));
+	}
+	return i;
+}
+#endif
+
+
+
+bool TextureDecoder::readInfo(const std::string& path, Header& header)
+{
+	int texWidth, texHeight, texChannels;
+	if (!stbi_info(path.c_str(), &texWidth, &texHeight, &texChannels))
+	{
+		return false;
+	}
+
+	header.width = static_cast<uint32_t>(texWidth);
+	header.height = static_cast<uint32_t>(texHeight);
+	header.channels = texChannels;
+	return true;
+}
+
+
+
+void TextureDecoder::decode(const std::string& path, const Header& header, unsigned char* destination)
+{
+	// The images with alpha are decoded to RGBA by stb_image, the others to RGB that is expanded below
+	bool hasAlpha = (header.channels == STBI_grey_alpha || header.channels == STBI_rgb_alpha);
+	int texWidth, texHeight, texChannels;
+	stbi_uc* pixels = stbi_load(path.c_str(), &texWidth, &texHeight, &texChannels, hasAlpha ? STBI_rgb_alpha : STBI_rgb);
+	if (!pixels)
+	{
+		throw std::runtime_error("ERROR::TextureDecoder::decode()::Failed to load texture image: " + path);
+	}
+	if (static_cast<uint32_t>(texWidth) != header.width || static_cast<uint32_t>(texHeight) != header.height)
+	{
+		stbi_image_free(pixels);
+		throw std::runtime_error("ERROR::TextureDecoder::decode()::The size of the image was changed: " + path);
+	}
+
+	size_t pixelCount = static_cast<size_t>(header.width) * header.height;
+	if (hasAlpha)
+	{
+		memcpy(destination, pixels, pixelCount * 4);
+	}
+	else
+	{
+		expandRgbToRgba(pixels, pixelCount, destination);
+	}
+	stbi_image_free(pixels);
+}
+
+
+
+void TextureDecoder::expandRgbToRgba(const unsigned char* rgb, size_t pixelCount, unsigned char* rgba)
+{
+	size_t i = 0;
+#ifdef TEXTURE_DECODER_SSSE3
+	static const bool ssse3 = hasSsse3();
+	if (ssse3)
+	{
+		i = expandRgbToRgbaSsse3(rgb, pixelCount, rgba);
+	}
+#endif
+	for (; i < pixelCount; ++i)
+	{
+		rgba[4 * i + 0] = rgb[3 * i + 0];
+		rgba[4 * i + 1] = rgb[3 * i + 1];
+		rgba[4 * i + 2] = rgb[3 * i + 2];
+		rgba[4 * i + 3] = 255;
+	}
+}
@@ -0,0 +1,34 @@
+// TextureDecoder.h
+
+#ifndef TEXTUREDECODER_H
+#define TEXTUREDECODER_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// The class that decodes the PNG and JPEG images to RGBA8 straight into the memory of the caller
+/// The caller reads the header first, so it can give the staging memory or the first level of the mip chain as the destination
+/// The images without alpha are decoded to RGB and expanded to RGBA by SIMD, which is faster than the conversion of stb_image
+/// stb_image decodes into its own buffer, so the pixels are still copied once to the destination, only the second copy is removed
+class TextureDecoder
+{
+public:
+	// The size and the channels of the image from its header
+	struct Header
+	{
+		uint32_t width = 0;
+		uint32_t height = 0;
+		int channels = 0;
+	};
+
+	// 1. Function to read the header of the image without decoding it, returns false if it isn't an image
+	static bool readInfo(const std::string& path, Header& header);
+	// 2. Function to decode the image into the destination of width * height * 4 bytes
+	/// The header from readInfo() isn't read again, the size of the decoded image is checked against it, the file could be changed between the calls
+	static void decode(const std::string& path, const Header& header, unsigned char* destination);
+	// 3. Function to add the opaque alpha to the RGB pixels
+	static void expandRgbToRgba(const unsigned char* rgb, size_t pixelCount, unsigned char* rgba);
+};
+
+#endif // TEXTUREDECODER_H
@@ -0,0 +1,202 @@
+// TextureStreamer.cpp
+#include "TextureStreamer.h"
+
+#include <algorithm>
+#include <cmath>
+
+TextureStreamer::TextureStreamer()
+{
+	budget = 256ull * 1024 * 1024;
+	uploadPerFrame = 16ull * 1024 * 1024;
+	tailSize = 128;
+	usedBytes = 0;
+	frame = 0;
+}
+
+
+
+void TextureStreamer::configure(uint64_t budget, uint64_t uploadPerFrame, uint32_t tailSize)
+{
+	this->budget = budget;
+	this->uploadPerFrame = uploadPerFrame;
+	this->tailSize = std::max(tailSize, 1u);
+}
+
+
+
+uint32_t TextureStreamer::tailLevel(const TextureData& texture) const
+{
+	// The texture without the stored levels is uploaded with all its levels at once
+	uint32_t level = 0;
+	while (level + 1 < texture.levels.size() && std::max(texture.levels[level].width, texture.levels[level].height) > tailSize)
+	{
+		++level;
+	}
+	return level;
+}
+
+
+
+void TextureStreamer::addTexture(uint32_t texture, const TextureData& data, uint32_t residentLevel)
+{
+	if (texture >= entries.size())
+	{
+		entries.resize(texture + 1);
+	}
+
+	Entry& entry = entries[texture];
+	entry.chainSizes.clear();
+	for (const MipLevel& level : data.levels)
+	{
+		entry.chainSizes.push_back(data.pixels.size() - level.offset);
+	}
+	if (entry.chainSizes.empty())
+	{
+		return;
+	}
+
+	entry.width = data.width;
+	entry.height = data.height;
+	entry.tailLevel = tailLevel(data);
+	entry.residentLevel = std::min(residentLevel, entry.tailLevel);
+	entry.requestedLevel = entry.tailLevel;
+	entry.lastUsed = frame;
+	usedBytes += entry.chainSizes[entry.residentLevel];
+}
+
+
+
+void TextureStreamer::request(uint32_t texture, float screenSize)
+{
+	if (texture >= entries.size() || entries[texture].chainSizes.empty())
+	{
+		return;
+	}
+
+	// The level where one texel covers about one pixel, the texture is assumed to cover the object once
+	Entry& entry = entries[texture];
+	float texels = static_cast<float>(std::max(entry.width, entry.height));
+	uint32_t level = entry.tailLevel;
+	if (screenSize >= texels)
+	{
+		level = 0;
+	}
+	else if (screenSize >= 1.0f)
+	{
+		level = std::min(static_cast<uint32_t>(std::log2(texels / screenSize)), entry.tailLevel);
+	}
+
+	entry.requestedLevel = std::min(entry.requestedLevel, level);
+	entry.lastUsed = frame;
+}
+
+
+
+const std::vector<TextureResidency>& TextureStreamer::update()
+{
+	changes.clear();
+
+	// The textures that need the finer levels, the largest difference is loaded first
+	std::vector<uint32_t> loads;
+	for (uint32_t i = 0; i < static_cast<uint32_t>(entries.size()); ++i)
+	{
+		if (!entries[i].chainSizes.empty() && entries[i].requestedLevel < entries[i].residentLevel)
+		{
+			loads.push_back(i);
+		}
+	}
+	std::sort(loads.begin(), loads.end(), [this](uint32_t a, uint32_t b)
+	{
+		return entries[a].residentLevel - entries[a].requestedLevel > entries[b].residentLevel - entries[b].requestedLevel;
+	});
+
+	uint64_t uploaded = 0;
+	for (uint32_t texture : loads)
+	{
+		Entry& entry = entries[texture];
+
+		// The image is recreated with all its levels, the uploads of one frame are limited and the rest waits for the next frames
+		/// The first upload of the frame is always allowed, so the level larger than the limit is loaded too
+		if (uploaded > 0 && uploaded + entry.chainSizes[entry.requestedLevel] > uploadPerFrame)
+		{
+			break;
+		}
+
+		// The coarser levels are tried when the requested one doesn't fit the budget after the eviction
+		size_t firstEviction = changes.size();
+		uint32_t level = entry.requestedLevel;
+		while (level < entry.residentLevel && !evict(entry.chainSizes[level] - entry.chainSizes[entry.residentLevel], texture))
+		{
+			++level;
+		}
+		if (level >= entry.residentLevel)
+		{
+			// Nothing is loaded, so the evictions made for this texture are given back and every eviction in the changes belongs to the load after it
+			for (size_t i = changes.size(); i > firstEviction; --i)
+			{
+				restore(changes[i - 1]);
+			}
+			changes.resize(firstEviction);
+			continue;
+		}
+
+		uploaded += entry.chainSizes[level];
+		usedBytes += entry.chainSizes[level] - entry.chainSizes[entry.residentLevel];
+		changes.push_back(TextureResidency{ texture, level, entry.residentLevel, false });
+		entry.residentLevel = level;
+	}
+
+	// The requests are collected again during the next frame
+	for (Entry& entry : entries)
+	{
+		entry.requestedLevel = entry.tailLevel;
+	}
+	++frame;
+
+	return changes;
+}
+
+
+
+void TextureStreamer::restore(const TextureResidency& change)
+{
+	Entry& entry = entries[change.texture];
+	usedBytes = usedBytes + entry.chainSizes[change.previousLevel] - entry.chainSizes[change.level];
+	entry.residentLevel = change.previousLevel;
+}
+
+
+
+bool TextureStreamer::evict(uint64_t neededBytes, uint32_t loadingTexture)
+{
+	if (usedBytes + neededBytes <= budget)
+	{
+		return true;
+	}
+
+	// The candidates have the levels finer than they requested in the last frame, the least recently used one goes first
+	std::vector<uint32_t> candidates;
+	for (uint32_t i = 0; i < static_cast<uint32_t>(entries.size()); ++i)
+	{
+		const Entry& entry = entries[i];
+		if (i != loadingTexture && !entry.chainSizes.empty() && entry.residentLevel < entry.requestedLevel)
+		{
+			candidates.push_back(i);
+		}
+	}
+	std::sort(candidates.begin(), candidates.end(), [this](uint32_t a, uint32_t b) { return entries[a].lastUsed < entries[b].lastUsed; });
+
+	for (uint32_t texture : candidates)
+	{
+		Entry& entry = entries[texture];
+		usedBytes -= entry.chainSizes[entry.residentLevel] - entry.chainSizes[entry.requestedLevel];
+		changes.push_back(TextureResidency{ texture, entry.requestedLevel, entry.residentLevel, true });
+		entry.residentLevel = entry.requestedLevel;
+
+		if (usedBytes + neededBytes <= budget)
+		{
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,77 @@
+// TextureStreamer.h
+
+#ifndef TEXTURESTREAMER_H
+#define TEXTURESTREAMER_H
+
+#include "TextureData.h"
+
+#include <vector>
+#include <cstdint>
+
+// The new first level of the texture image, the renderer recreates the image with the levels from it
+struct TextureResidency
+{
+	uint32_t texture;
+	uint32_t level;
+	// The first level before the change, the renderer gives it back by restore() when the new image can't be created
+	uint32_t previousLevel;
+	// True when the fine levels are dropped, false when they are loaded
+	bool evicted;
+};
+
+// The class that decides which mip levels of the textures are kept in the video memory
+/// The levels from the mip tail are resident all the time, the finer levels are loaded when the texture is large on the screen
+/// When the loaded levels exceed the budget, the fine levels of the least recently used textures are evicted
+/// It keeps only the sizes of the levels, the renderer does the uploads by the returned changes
+class TextureStreamer
+{
+public:
+	TextureStreamer();
+
+	// 1. Function to set the budget of the streamed textures in bytes, the bytes that can be uploaded in one frame
+	/// and the size of the largest level of the mip tail in texels
+	void configure(uint64_t budget, uint64_t uploadPerFrame, uint32_t tailSize);
+	// 2. Function to get the first level of the mip tail, the texture is never reduced below it
+	uint32_t tailLevel(const TextureData& texture) const;
+	// 3. Function to register the texture with the index of the bindless array, its levels from residentLevel are already uploaded
+	void addTexture(uint32_t texture, const TextureData& data, uint32_t residentLevel);
+	// 4. Function to request the level of the texture by its size on the screen in pixels, it's called for each visible object
+	void request(uint32_t texture, float screenSize);
+	// 5. Function to choose the residency changes of the frame by the requests since the previous update, the requests are cleared
+	/// The evictions come right before the load they were made for, the load that doesn't fit has its evictions undone
+	const std::vector<TextureResidency>& update();
+	// 6. Function to undo the change that the renderer couldn't apply, the texture keeps the levels of its current image
+	void restore(const TextureResidency& change);
+
+	uint64_t residentBytes() const { return usedBytes; };
+	uint64_t getBudget() const { return budget; };
+
+private:
+	struct Entry
+	{
+		// The sizes of the image from each level to the end of the chain, it's empty for the textures that aren't streamed
+		std::vector<uint64_t> chainSizes;
+		uint32_t width;
+		uint32_t height;
+		uint32_t tailLevel;
+		uint32_t residentLevel;
+		// The finest level that was requested since the previous update, tailLevel when the texture wasn't visible
+		uint32_t requestedLevel;
+		uint64_t lastUsed;
+	};
+
+	// Function to drop the fine levels of the least recently used textures until the bytes fit the budget, returns false if they don't fit
+	bool evict(uint64_t neededBytes, uint32_t loadingTexture);
+
+	std::vector<Entry> entries;
+	std::vector<TextureResidency> changes;
+
+	uint64_t budget;
+	uint64_t uploadPerFrame;
+	uint32_t tailSize;
+	// The bytes of the resident levels of the streamed textures with their mip tails
+	uint64_t usedBytes;
+	uint64_t frame;
+};
+
+#endif // TEXTURESTREAMER_H
@@ -0,0 +1,122 @@
+// ThreadPool.cpp
+#include "ThreadPool.h"
+
+#include <atomic>
+#include <exception>
+#include <algorithm>
+
+ThreadPool::ThreadPool(uint32_t threadCount)
+{
+	stopping = false;
+
+	workers.reserve(threadCount);
+	for (uint32_t i{}; i < threadCount; ++i)
+	{
+		workers.emplace_back(&ThreadPool::workerLoop, this);
+	}
+}
+
+
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)>& body)
+{
+	if (count == 0)
+	{
+		return;
+	}
+
+	// The shared state is kept alive by the helper tasks, which may start after the loop is already finished
+	struct LoopState
+	{
+		std::atomic<size_t> next{ 0 };
+		std::atomic<size_t> done{ 0 };
+		std::mutex mutex;
+		std::condition_variable finished;
+		std::exception_ptr error;
+	};
+	auto state = std::make_shared<LoopState>();
+	const std::function<void(size_t)>* loopBody = &body;
+
+	auto runIterations = [state, loopBody, count]()
+	{
+		for (size_t i = state->next.fetch_add(1); i < count; i = state->next.fetch_add(1))
+		{
+			try
+			{
+				(*loopBody)(i);
+			}
+			catch (...)
+			{
+				std::lock_guard<std::mutex> lock(state->mutex);
+				if (!state->error)
+				{
+					state->error = std::current_exception();
+				}
+			}
+
+			if (state->done.fetch_add(1) + 1 == count)
+			{
+				std::lock_guard<std::mutex> lock(state->mutex);
+				state->finished.notify_all();
+			}
+		}
+	};
+
+	// Waking up no more helpers than there are iterations for them
+	size_t helperCount = std::min(count - 1, workers.size());
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		for (size_t i{}; i < helperCount; ++i)
+		{
+			tasks.emplace_back(runIterations);
+		}
+	}
+	queueCondition.notify_all();
+
+	runIterations();
+
+	std::unique_lock<std::mutex> lock(state->mutex);
+	state->finished.wait(lock, [&state, count]() { return state->done.load() == count; });
+
+	if (state->error)
+	{
+		std::rethrow_exception(state->error);
+	}
+}
+
+
+
+void ThreadPool::workerLoop()
+{
+	while (true)
+	{
+		std::function<void()> task;
+		{
+			std::unique_lock<std::mutex> lock(queueMutex);
+			queueCondition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+			if (stopping && tasks.empty())
+			{
+				return;
+			}
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+		task();
+	}
+}
+
+
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(queueMutex);
+		stopping = true;
+	}
+	queueCondition.notify_all();
+
+	for (auto& worker : workers)
+	{
+		worker.join();
+	}
+}
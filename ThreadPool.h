@@ -0,0 +1,65 @@
+// ThreadPool.h
+
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <cstdint>
+
+// The pool of worker threads that executes the CPU heavy parts of the asset loading
+class ThreadPool
+{
+public:
+	// The pool without worker threads runs all tasks of parallelFor() on the calling thread
+	explicit ThreadPool(uint32_t threadCount = std::thread::hardware_concurrency());
+
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+
+	// 1. Function to put the task to the queue, the result is returned through the future
+	template<typename Task>
+	auto submit(Task task) -> std::future<decltype(task())>
+	{
+		auto packagedTask = std::make_shared<std::packaged_task<decltype(task())()>>(std::move(task));
+		std::future<decltype(task())> result = packagedTask->get_future();
+		// Without the worker threads nobody would take the task from the queue
+		if (workers.empty())
+		{
+			(*packagedTask)();
+			return result;
+		}
+		{
+			std::lock_guard<std::mutex> lock(queueMutex);
+			tasks.emplace_back([packagedTask]() { (*packagedTask)(); });
+		}
+		queueCondition.notify_one();
+		return result;
+	}
+
+	// 2. Function to call body(i) for each i in [0, count), the calling thread takes part in the work
+	/// Exceptions of the body are passed to the calling thread after all iterations are finished
+	void parallelFor(size_t count, const std::function<void(size_t)>& body);
+
+	uint32_t size() const { return static_cast<uint32_t>(workers.size()); };
+
+	~ThreadPool();
+
+private:
+	// The loop of the worker threads
+	void workerLoop();
+
+	std::vector<std::thread> workers;
+	std::deque<std::function<void()>> tasks;
+	std::mutex queueMutex;
+	std::condition_variable queueCondition;
+	bool stopping;
+};
+
+#endif // THREADPOOL_H
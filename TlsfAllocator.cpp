@@ -0,0 +1,304 @@
+// TlsfAllocator.cpp
+#include "TlsfAllocator.h"
+
+// The index of the lowest and the highest set bit, the value isn't zero
+static uint32_t lowestBit(uint64_t value)
+{
+	uint32_t bit = 0;
+	while (!(value & 1))
+	{
+		value >>= 1;
+		++bit;
+	}
+	return bit;
+}
+
+static uint32_t highestBit(uint64_t value)
+{
+	uint32_t bit = 0;
+	while (value >>= 1)
+	{
+		++bit;
+	}
+	return bit;
+}
+
+
+
+TlsfAllocator::TlsfAllocator()
+{
+	reset(0);
+}
+
+
+
+void TlsfAllocator::reset(uint64_t size)
+{
+	nodes.clear();
+	spareNodes.clear();
+	for (uint32_t i = 0; i < FIRST_LEVEL_COUNT; ++i)
+	{
+		for (uint32_t j = 0; j < SECOND_LEVEL_COUNT; ++j)
+		{
+			heads[i][j] = NO_NODE;
+		}
+		secondLevelBitmaps[i] = 0;
+	}
+	firstLevelBitmap = 0;
+	totalSize = size;
+	usedSize = 0;
+	usedCount = 0;
+
+	if (size > 0)
+	{
+		insertFree(createNode(0, size));
+	}
+}
+
+
+
+bool TlsfAllocator::allocate(uint64_t size, uint64_t alignment, TlsfRange& range)
+{
+	if (size == 0 || size > totalSize)
+	{
+		return false;
+	}
+	alignment = alignment > 0 ? alignment : 1;
+
+	// The range of size + alignment - 1 fits the aligned size wherever it starts
+	/// The range of the size is tried first, it's enough when its offset is already aligned
+	uint32_t node = findFree(size);
+	if (node != NO_NODE && (nodes[node].offset & (alignment - 1)) != 0)
+	{
+		node = alignment > 1 ? findFree(size + alignment - 1) : NO_NODE;
+	}
+	if (node == NO_NODE)
+	{
+		return false;
+	}
+	removeFree(node);
+
+	// The padding before the aligned offset is a free range of its own, its previous neighbour is never free
+	uint64_t aligned = (nodes[node].offset + alignment - 1) & ~(alignment - 1);
+	uint64_t padding = aligned - nodes[node].offset;
+	if (padding > 0)
+	{
+		uint32_t front = createNode(nodes[node].offset, padding);
+		nodes[front].prevPhysical = nodes[node].prevPhysical;
+		nodes[front].nextPhysical = node;
+		if (nodes[node].prevPhysical != NO_NODE)
+		{
+			nodes[nodes[node].prevPhysical].nextPhysical = front;
+		}
+		nodes[node].prevPhysical = front;
+		nodes[node].offset = aligned;
+		nodes[node].size -= padding;
+		insertFree(front);
+	}
+
+	// The rest after the range goes back to the lists
+	if (nodes[node].size > size)
+	{
+		uint32_t back = createNode(aligned + size, nodes[node].size - size);
+		nodes[back].prevPhysical = node;
+		nodes[back].nextPhysical = nodes[node].nextPhysical;
+		if (nodes[node].nextPhysical != NO_NODE)
+		{
+			nodes[nodes[node].nextPhysical].prevPhysical = back;
+		}
+		nodes[node].nextPhysical = back;
+		nodes[node].size = size;
+		insertFree(back);
+	}
+
+	nodes[node].free = false;
+	usedSize += size;
+	++usedCount;
+
+	range.offset = aligned;
+	range.size = size;
+	range.node = node;
+	return true;
+}
+
+
+
+void TlsfAllocator::free(uint32_t node)
+{
+	usedSize -= nodes[node].size;
+	--usedCount;
+
+	// The free neighbours are merged into the range, so two free ranges are never next to each other
+	uint32_t prev = nodes[node].prevPhysical;
+	if (prev != NO_NODE && nodes[prev].free)
+	{
+		removeFree(prev);
+		nodes[node].offset = nodes[prev].offset;
+		nodes[node].size += nodes[prev].size;
+		nodes[node].prevPhysical = nodes[prev].prevPhysical;
+		if (nodes[prev].prevPhysical != NO_NODE)
+		{
+			nodes[nodes[prev].prevPhysical].nextPhysical = node;
+		}
+		releaseNode(prev);
+	}
+
+	uint32_t next = nodes[node].nextPhysical;
+	if (next != NO_NODE && nodes[next].free)
+	{
+		removeFree(next);
+		nodes[node].size += nodes[next].size;
+		nodes[node].nextPhysical = nodes[next].nextPhysical;
+		if (nodes[next].nextPhysical != NO_NODE)
+		{
+			nodes[nodes[next].nextPhysical].prevPhysical = node;
+		}
+		releaseNode(next);
+	}
+
+	insertFree(node);
+}
+
+
+
+uint64_t TlsfAllocator::largestFreeRange() const
+{
+	if (firstLevelBitmap == 0)
+	{
+		return 0;
+	}
+
+	// The ranges of the highest non empty list have different sizes inside its step
+	uint32_t firstLevel = highestBit(firstLevelBitmap);
+	uint32_t secondLevel = highestBit(secondLevelBitmaps[firstLevel]);
+	uint64_t largest = 0;
+	for (uint32_t node = heads[firstLevel][secondLevel]; node != NO_NODE; node = nodes[node].nextFree)
+	{
+		largest = nodes[node].size > largest ? nodes[node].size : largest;
+	}
+	return largest;
+}
+
+
+
+void TlsfAllocator::mapping(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel) const
+{
+	// The small sizes have one list for each size
+	if (size < SECOND_LEVEL_COUNT)
+	{
+		firstLevel = 0;
+		secondLevel = static_cast<uint32_t>(size);
+		return;
+	}
+
+	uint32_t bit = highestBit(size);
+	firstLevel = bit - SECOND_LEVEL_BITS + 1;
+	secondLevel = static_cast<uint32_t>(size >> (bit - SECOND_LEVEL_BITS)) - SECOND_LEVEL_COUNT;
+}
+
+
+
+uint32_t TlsfAllocator::findFree(uint64_t size) const
+{
+	// The size is rounded up to the next list, so any range of the found list fits it
+	if (size >= SECOND_LEVEL_COUNT)
+	{
+		size += (1ull << (highestBit(size) - SECOND_LEVEL_BITS)) - 1;
+	}
+	uint32_t firstLevel, secondLevel;
+	mapping(size, firstLevel, secondLevel);
+	if (firstLevel >= FIRST_LEVEL_COUNT)
+	{
+		return NO_NODE;
+	}
+
+	uint32_t secondMap = secondLevelBitmaps[firstLevel] & (~0u << secondLevel);
+	if (secondMap == 0)
+	{
+		uint64_t firstMap = firstLevel + 1 < 64 ? firstLevelBitmap & (~0ull << (firstLevel + 1)) : 0;
+		if (firstMap == 0)
+		{
+			return NO_NODE;
+		}
+		firstLevel = lowestBit(firstMap);
+		secondMap = secondLevelBitmaps[firstLevel];
+	}
+	return heads[firstLevel][lowestBit(secondMap)];
+}
+
+
+
+void TlsfAllocator::insertFree(uint32_t node)
+{
+	uint32_t firstLevel, secondLevel;
+	mapping(nodes[node].size, firstLevel, secondLevel);
+
+	nodes[node].free = true;
+	nodes[node].prevFree = NO_NODE;
+	nodes[node].nextFree = heads[firstLevel][secondLevel];
+	if (nodes[node].nextFree != NO_NODE)
+	{
+		nodes[nodes[node].nextFree].prevFree = node;
+	}
+	heads[firstLevel][secondLevel] = node;
+	firstLevelBitmap |= 1ull << firstLevel;
+	secondLevelBitmaps[firstLevel] |= 1u << secondLevel;
+}
+
+
+
+void TlsfAllocator::removeFree(uint32_t node)
+{
+	uint32_t firstLevel, secondLevel;
+	mapping(nodes[node].size, firstLevel, secondLevel);
+
+	if (nodes[node].prevFree != NO_NODE)
+	{
+		nodes[nodes[node].prevFree].nextFree = nodes[node].nextFree;
+	}
+	else
+	{
+		heads[firstLevel][secondLevel] = nodes[node].nextFree;
+	}
+	if (nodes[node].nextFree != NO_NODE)
+	{
+		nodes[nodes[node].nextFree].prevFree = nodes[node].prevFree;
+	}
+
+	if (heads[firstLevel][secondLevel] == NO_NODE)
+	{
+		secondLevelBitmaps[firstLevel] &= ~(1u << secondLevel);
+		if (secondLevelBitmaps[firstLevel] == 0)
+		{
+			firstLevelBitmap &= ~(1ull << firstLevel);
+		}
+	}
+	nodes[node].free = false;
+}
+
+
+
+uint32_t TlsfAllocator::createNode(uint64_t offset, uint64_t size)
+{
+	uint32_t node;
+	if (!spareNodes.empty())
+	{
+		node = spareNodes.back();
+		spareNodes.pop_back();
+	}
+	else
+	{
+		node = static_cast<uint32_t>(nodes.size());
+		nodes.emplace_back();
+	}
+
+	nodes[node] = Node{ offset, size, NO_NODE, NO_NODE, NO_NODE, NO_NODE, false };
+	return node;
+}
+
+
+
+void TlsfAllocator::releaseNode(uint32_t node)
+{
+	spareNodes.push_back(node);
+}
@@ -0,0 +1,79 @@
+// TlsfAllocator.h
+
+#ifndef TLSFALLOCATOR_H
+#define TLSFALLOCATOR_H
+
+#include <vector>
+#include <cstdint>
+
+// The range that was taken from the allocator, node is the handle that gives the range back
+struct TlsfRange
+{
+	uint64_t offset;
+	uint64_t size;
+	uint32_t node;
+};
+
+// The two level segregated fit allocator of the offsets in one range, it doesn't touch any memory
+/// The free ranges are kept in the lists by the power of two of their size (first level) and 32 steps inside it (second level)
+/// The bitmaps of the non empty lists find the fitting range in constant time, the freed ranges are merged with their free neighbours
+class TlsfAllocator
+{
+public:
+	TlsfAllocator();
+
+	// 1. Function to start again with one free range of the size, the previous ranges are dropped
+	void reset(uint64_t size);
+	// 2. Function to take the range with the offset aligned to the alignment (power of two), returns false if no free range fits
+	bool allocate(uint64_t size, uint64_t alignment, TlsfRange& range);
+	// 3. Function to give the range back
+	void free(uint32_t node);
+	// 4. Function to get the size of the largest free range
+	uint64_t largestFreeRange() const;
+
+	uint64_t capacity() const { return totalSize; };
+	uint64_t usedBytes() const { return usedSize; };
+	uint64_t freeBytes() const { return totalSize - usedSize; };
+	uint32_t allocationCount() const { return usedCount; };
+	bool empty() const { return usedCount == 0; };
+
+private:
+	static const uint32_t SECOND_LEVEL_BITS = 5;
+	static const uint32_t SECOND_LEVEL_COUNT = 1u << SECOND_LEVEL_BITS;
+	static const uint32_t FIRST_LEVEL_COUNT = 64 - SECOND_LEVEL_BITS + 1;
+	static const uint32_t NO_NODE = UINT32_MAX;
+
+	// The range of the whole space, the physical neighbours are linked for the merges and the free ones are also linked in their list
+	struct Node
+	{
+		uint64_t offset;
+		uint64_t size;
+		uint32_t prevPhysical;
+		uint32_t nextPhysical;
+		uint32_t prevFree;
+		uint32_t nextFree;
+		bool free;
+	};
+
+	// Function to get the lists of the size
+	void mapping(uint64_t size, uint32_t& firstLevel, uint32_t& secondLevel) const;
+	// Function to find the free node of the first non empty list from the size, NO_NODE if there is none
+	uint32_t findFree(uint64_t size) const;
+	void insertFree(uint32_t node);
+	void removeFree(uint32_t node);
+	uint32_t createNode(uint64_t offset, uint64_t size);
+	void releaseNode(uint32_t node);
+
+	std::vector<Node> nodes;
+	// The unused elements of nodes
+	std::vector<uint32_t> spareNodes;
+	uint32_t heads[FIRST_LEVEL_COUNT][SECOND_LEVEL_COUNT];
+	uint64_t firstLevelBitmap;
+	uint32_t secondLevelBitmaps[FIRST_LEVEL_COUNT];
+
+	uint64_t totalSize;
+	uint64_t usedSize;
+	uint32_t usedCount;
+};
+
+#endif // TLSFALLOCATOR_H
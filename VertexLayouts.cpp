@@ -0,0 +1,234 @@
+// VertexLayouts.cpp
+#include "VertexLayouts.h"
+
+#include <stdexcept>
+#include <cstring>
+#include <cmath>
+
+namespace
+{
+	// The position on the axis of the bounds to the unorm16 value
+	uint16_t quantizeUnorm16(float value, float min, float size)
+	{
+		if (!(size > 0.0f))
+		{
+			return 0;
+		}
+		float normalized = (value - min) / size;
+		normalized = normalized < 0.0f ? 0.0f : (normalized > 1.0f ? 1.0f : normalized);
+		return static_cast<uint16_t>(std::lround(normalized * 65535.0f));
+	}
+
+	int16_t quantizeSnorm16(float value)
+	{
+		value = value < -1.0f ? -1.0f : (value > 1.0f ? 1.0f : value);
+		return static_cast<int16_t>(std::lround(value * 32767.0f));
+	}
+
+	// The normal is projected to the octahedron and the lower half is folded over the upper one
+	void encodeOctahedral(const glm::vec3& normal, int16_t output[2])
+	{
+		float length = std::fabs(normal.x) + std::fabs(normal.y) + std::fabs(normal.z);
+		if (length == 0.0f)
+		{
+			output[0] = 0;
+			output[1] = 0;
+			return;
+		}
+
+		float x = normal.x / length;
+		float y = normal.y / length;
+		if (normal.z < 0.0f)
+		{
+			float foldedX = (1.0f - std::fabs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+			float foldedY = (1.0f - std::fabs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+			x = foldedX;
+			y = foldedY;
+		}
+		output[0] = quantizeSnorm16(x);
+		output[1] = quantizeSnorm16(y);
+	}
+
+	void encodePosition(const glm::vec3& pos, const VertexBounds& bounds, uint16_t output[4])
+	{
+		output[0] = quantizeUnorm16(pos.x, bounds.min.x, bounds.size.x);
+		output[1] = quantizeUnorm16(pos.y, bounds.min.y, bounds.size.y);
+		output[2] = quantizeUnorm16(pos.z, bounds.min.z, bounds.size.z);
+		output[3] = 0;
+	}
+
+	VkVertexInputAttributeDescription makeAttribute(uint32_t location, VkFormat format, uint32_t offset)
+	{
+		VkVertexInputAttributeDescription attributeDescription{};
+		attributeDescription.binding = 0;
+		attributeDescription.location = location;
+		attributeDescription.format = format;
+		attributeDescription.offset = offset;
+		return attributeDescription;
+	}
+
+	template<typename Layout>
+	VertexLayoutInfo makeLayoutInfo(const char* vertexShader)
+	{
+		VertexLayoutInfo info{};
+		info.layout = Layout::LAYOUT;
+		info.stride = sizeof(Layout);
+		info.vertexShader = vertexShader;
+		info.bindingDescription = Layout::getBindingDescription();
+		info.attributeDescriptions = Layout::getAttributeDescriptions();
+		return info;
+	}
+}
+
+
+
+std::vector<VkVertexInputAttributeDescription> VertexFull::getAttributeDescriptions()
+{
+	// The shader locations are the same in all layouts: 0 - position, 1 - color, 2 - texture coordinates, 3 - normal
+	return {
+		makeAttribute(0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(VertexFull, pos)),
+		makeAttribute(1, VK_FORMAT_R32G32B32_SFLOAT, offsetof(VertexFull, color)),
+		makeAttribute(2, VK_FORMAT_R32G32_SFLOAT, offsetof(VertexFull, texCoord))
+	};
+}
+
+
+
+VertexFull VertexFull::encode(const Vertex& vertex, const VertexBounds&)
+{
+	// The full precision layout keeps the positions as they are, the bounds are used only by the quantized layouts
+	VertexFull output{};
+	output.pos = vertex.pos;
+	output.color = vertex.color;
+	output.texCoord = vertex.texCoord;
+	return output;
+}
+
+
+
+std::vector<VkVertexInputAttributeDescription> VertexCompact::getAttributeDescriptions()
+{
+	return {
+		makeAttribute(0, VK_FORMAT_R16G16B16A16_UNORM, offsetof(VertexCompact, pos)),
+		makeAttribute(2, VK_FORMAT_R16G16_SFLOAT, offsetof(VertexCompact, texCoord))
+	};
+}
+
+
+
+VertexCompact VertexCompact::encode(const Vertex& vertex, const VertexBounds& bounds)
+{
+	VertexCompact output{};
+	encodePosition(vertex.pos, bounds, output.pos);
+	output.texCoord[0] = floatToHalf(vertex.texCoord.x);
+	output.texCoord[1] = floatToHalf(vertex.texCoord.y);
+	return output;
+}
+
+
+
+std::vector<VkVertexInputAttributeDescription> VertexCompactNormal::getAttributeDescriptions()
+{
+	return {
+		makeAttribute(0, VK_FORMAT_R16G16B16A16_UNORM, offsetof(VertexCompactNormal, pos)),
+		makeAttribute(2, VK_FORMAT_R16G16_SFLOAT, offsetof(VertexCompactNormal, texCoord)),
+		makeAttribute(3, VK_FORMAT_R16G16_SNORM, offsetof(VertexCompactNormal, normal))
+	};
+}
+
+
+
+VertexCompactNormal VertexCompactNormal::encode(const Vertex& vertex, const VertexBounds& bounds)
+{
+	VertexCompactNormal output{};
+	encodePosition(vertex.pos, bounds, output.pos);
+	output.texCoord[0] = floatToHalf(vertex.texCoord.x);
+	output.texCoord[1] = floatToHalf(vertex.texCoord.y);
+	encodeOctahedral(vertex.normal, output.normal);
+	return output;
+}
+
+
+
+VertexLayoutInfo getVertexLayoutInfo(VertexLayout layout)
+{
+	switch (layout)
+	{
+	case VERTEX_LAYOUT_FULL:
+		return makeLayoutInfo<VertexFull>("Shaders/vert.spv");
+	case VERTEX_LAYOUT_COMPACT:
+		return makeLayoutInfo<VertexCompact>("Shaders/vert_compact.spv");
+	case VERTEX_LAYOUT_COMPACT_NORMAL:
+		return makeLayoutInfo<VertexCompactNormal>("Shaders/vert_compact_normal.spv");
+	default:
+		break;
+	}
+	throw std::runtime_error("ERROR::VertexLayouts::getVertexLayoutInfo()::Unknown vertex layout");
+}
+
+
+
+std::vector<char> encodeVertices(VertexLayout layout, const std::vector<Vertex>& vertices, const VertexBounds& bounds)
+{
+	switch (layout)
+	{
+	case VERTEX_LAYOUT_FULL:
+		return encodeVertices<VertexFull>(vertices, bounds);
+	case VERTEX_LAYOUT_COMPACT:
+		return encodeVertices<VertexCompact>(vertices, bounds);
+	case VERTEX_LAYOUT_COMPACT_NORMAL:
+		return encodeVertices<VertexCompactNormal>(vertices, bounds);
+	default:
+		break;
+	}
+	throw std::runtime_error("ERROR::VertexLayouts::encodeVertices()::Unknown vertex layout");
+}
+
+
+
+uint16_t floatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+
+	uint32_t sign = (bits >> 16) & 0x8000u;
+	uint32_t magnitude = bits & 0x7fffffffu;
+
+	// Infinity and NaN, the NaN keeps one bit of the mantissa
+	if (magnitude >= 0x7f800000u)
+	{
+		return static_cast<uint16_t>(sign | 0x7c00u | (magnitude > 0x7f800000u ? 0x200u : 0u));
+	}
+	// The values from 65520 are rounded to the infinity
+	if (magnitude >= 0x477ff000u)
+	{
+		return static_cast<uint16_t>(sign | 0x7c00u);
+	}
+	// The values below 2^-14 become the subnormal half floats
+	if (magnitude < 0x38800000u)
+	{
+		if (magnitude < 0x33000000u)
+		{
+			return static_cast<uint16_t>(sign);
+		}
+		uint32_t mantissa = (magnitude & 0x7fffffu) | 0x800000u;
+		uint32_t shift = 126u - (magnitude >> 23);
+		uint32_t half = mantissa >> shift;
+		uint32_t remainder = mantissa & ((1u << shift) - 1u);
+		uint32_t halfway = 1u << (shift - 1u);
+		if (remainder > halfway || (remainder == halfway && (half & 1u)))
+		{
+			++half;
+		}
+		return static_cast<uint16_t>(sign | half);
+	}
+
+	// The exponent is rebiased from 127 to 15, the carry of the rounding moves to the exponent
+	uint32_t half = (magnitude - 0x38000000u) >> 13;
+	uint32_t remainder = magnitude & 0x1fffu;
+	if (remainder > 0x1000u || (remainder == 0x1000u && (half & 1u)))
+	{
+		++half;
+	}
+	return static_cast<uint16_t>(sign | half);
+}
@@ -0,0 +1,137 @@
+// VertexLayouts.h
+
+#ifndef VERTEXLAYOUTS_H
+#define VERTEXLAYOUTS_H
+
+#include <vulkan/vulkan.h>
+#include <glm.hpp>
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// The vertex of the loader with all attributes in full precision, it's converted to one of the layouts below before the upload
+struct Vertex
+{
+	glm::vec3 pos;
+	glm::vec3 color;
+	glm::vec2 texCoord;
+	// Filled only for the layouts with the normal, otherwise it's zero and doesn't split the welded vertices
+	glm::vec3 normal;
+
+	bool operator==(const Vertex& other) const
+	{
+		return pos == other.pos && color == other.color && texCoord == other.texCoord && normal == other.normal;
+	}
+};
+
+// VertexWelder compares the vertices by their bytes, the padding would make the equal vertices different
+static_assert(sizeof(Vertex) == sizeof(glm::vec3) * 3 + sizeof(glm::vec2), "Vertex must not contain padding");
+
+// The identifiers of the vertex layouts, the identifier of the uploaded layout is saved in the mesh cache
+enum VertexLayout : uint32_t
+{
+	VERTEX_LAYOUT_FULL = 0,
+	VERTEX_LAYOUT_COMPACT = 1,
+	VERTEX_LAYOUT_COMPACT_NORMAL = 2,
+	// The number of the layouts, the renderer has one graphics pipeline for each of them
+	VERTEX_LAYOUT_COUNT = 3
+};
+
+// The box that the quantized positions are relative to, the vertex shader gets it through the model matrix
+struct VertexBounds
+{
+	glm::vec3 min;
+	// Size of the box, the positions on the axis with zero size are quantized to 0
+	glm::vec3 size;
+};
+
+// The binding description is the same for all layouts, only the stride differs
+template<typename Layout>
+struct VertexBinding
+{
+	static VkVertexInputBindingDescription getBindingDescription()
+	{
+		VkVertexInputBindingDescription bindingDescription{};
+		bindingDescription.binding = 0;
+		bindingDescription.stride = sizeof(Layout);
+		bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+
+		return bindingDescription;
+	}
+};
+
+// 1. Full precision layout, 32 bytes: fp32 position, color and texture coordinates
+/// It's used when the model has vertex colors or the compact layouts are switched off
+struct VertexFull : VertexBinding<VertexFull>
+{
+	glm::vec3 pos;
+	glm::vec3 color;
+	glm::vec2 texCoord;
+
+	static const VertexLayout LAYOUT = VERTEX_LAYOUT_FULL;
+
+	static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+	static VertexFull encode(const Vertex& vertex, const VertexBounds& bounds);
+};
+
+// 2. Compact layout, 12 bytes: unorm16 position relative to the bounds and half float texture coordinates
+struct VertexCompact : VertexBinding<VertexCompact>
+{
+	// The fourth component keeps the 8 byte alignment of the attribute, RGB16 formats are rarely supported for vertex buffers
+	uint16_t pos[4];
+	uint16_t texCoord[2];
+
+	static const VertexLayout LAYOUT = VERTEX_LAYOUT_COMPACT;
+
+	static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+	static VertexCompact encode(const Vertex& vertex, const VertexBounds& bounds);
+};
+
+// 3. Compact layout with the normal, 16 bytes: the normal is packed by the octahedral mapping to two snorm16 values
+struct VertexCompactNormal : VertexBinding<VertexCompactNormal>
+{
+	uint16_t pos[4];
+	uint16_t texCoord[2];
+	int16_t normal[2];
+
+	static const VertexLayout LAYOUT = VERTEX_LAYOUT_COMPACT_NORMAL;
+
+	static std::vector<VkVertexInputAttributeDescription> getAttributeDescriptions();
+	static VertexCompactNormal encode(const Vertex& vertex, const VertexBounds& bounds);
+};
+
+// The description of the layout for the loader and the graphics pipeline
+struct VertexLayoutInfo
+{
+	VertexLayout layout;
+	uint32_t stride;
+	// The vertex shader variant that reads this layout
+	const char* vertexShader;
+	VkVertexInputBindingDescription bindingDescription;
+	std::vector<VkVertexInputAttributeDescription> attributeDescriptions;
+};
+
+// Function to get the description of the layout, throws for the unknown identifier
+VertexLayoutInfo getVertexLayoutInfo(VertexLayout layout);
+
+// Function to convert the vertices of the loader to the layout with the given identifier
+std::vector<char> encodeVertices(VertexLayout layout, const std::vector<Vertex>& vertices, const VertexBounds& bounds);
+
+// Function to convert the vertices of the loader to the layout
+template<typename Layout>
+std::vector<char> encodeVertices(const std::vector<Vertex>& vertices, const VertexBounds& bounds)
+{
+	std::vector<char> data(vertices.size() * sizeof(Layout));
+	Layout* output = reinterpret_cast<Layout*>(data.data());
+	for (size_t i = 0; i < vertices.size(); ++i)
+	{
+		output[i] = Layout::encode(vertices[i], bounds);
+	}
+	return data;
+}
+
+// Function to convert the float to the half float with rounding to the nearest even
+uint16_t floatToHalf(float value);
+
+#endif // VERTEXLAYOUTS_H
@@ -0,0 +1,299 @@
+// VertexWelder.cpp
+#include "VertexWelder.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <limits>
+#include <cstring>
+
+namespace
+{
+	const uint32_t EMPTY_SLOT = std::numeric_limits<uint32_t>::max();
+	// The number of corners processed by one task of the parallel mode
+	const size_t BLOCK_SIZE = 64 * 1024;
+
+	// The finalizer of MurmurHash3, every input bit affects every output bit
+	uint64_t mix64(uint64_t value)
+	{
+		value ^= value >> 33;
+		value *= 0xff51afd7ed558ccdull;
+		value ^= value >> 33;
+		value *= 0xc4ceb9fe1a85ec53ull;
+		value ^= value >> 33;
+		return value;
+	}
+
+	// The hash of the corner together with its number, the sort by this pair keeps the order of the corners in each group
+	struct CornerKey
+	{
+		uint64_t hash;
+		uint32_t corner;
+
+		bool operator<(const CornerKey& other) const
+		{
+			return hash < other.hash || (hash == other.hash && corner < other.corner);
+		}
+	};
+}
+
+
+
+VertexWelder::VertexWelder(ThreadPool& pool) : pool(pool)
+{
+}
+
+
+
+void VertexWelder::weld(const void* corners, size_t stride, size_t count, std::vector<uint32_t>& indices, std::vector<uint32_t>& firstCorners)
+{
+	if (count >= std::numeric_limits<uint32_t>::max())
+	{
+		throw std::runtime_error("ERROR::VertexWelder::weld()::Too many corners for 32-bit indices");
+	}
+
+	indices.resize(count);
+	firstCorners.clear();
+
+	if (count >= PARALLEL_THRESHOLD && pool.size() > 0)
+	{
+		weldSorted(static_cast<const char*>(corners), stride, count, indices, firstCorners);
+	}
+	else
+	{
+		weldHashTable(static_cast<const char*>(corners), stride, count, indices, firstCorners);
+	}
+}
+
+
+
+uint64_t VertexWelder::hashBytes(const void* data, size_t size)
+{
+	const char* bytes = static_cast<const char*>(data);
+	uint64_t hash = 0x9e3779b97f4a7c15ull ^ size;
+
+	size_t i = 0;
+	for (; i + 8 <= size; i += 8)
+	{
+		uint64_t word;
+		memcpy(&word, bytes + i, sizeof(word));
+		hash = (hash ^ mix64(word)) * 0x100000001b3ull;
+	}
+	if (i < size)
+	{
+		uint64_t word = 0;
+		memcpy(&word, bytes + i, size - i);
+		hash = (hash ^ mix64(word)) * 0x100000001b3ull;
+	}
+	return mix64(hash);
+}
+
+
+
+void VertexWelder::canonicalizeZeros(void* data, size_t size)
+{
+	char* bytes = static_cast<char*>(data);
+	for (size_t i = 0; i + sizeof(uint32_t) <= size; i += sizeof(uint32_t))
+	{
+		// Only the sign bit is set in -0.0f
+		uint32_t word;
+		memcpy(&word, bytes + i, sizeof(word));
+		if (word == 0x80000000u)
+		{
+			word = 0;
+			memcpy(bytes + i, &word, sizeof(word));
+		}
+	}
+}
+
+
+
+void VertexWelder::weldHashTable(const char* corners, size_t stride, size_t count, std::vector<uint32_t>& indices, std::vector<uint32_t>& firstCorners)
+{
+	// The table is at most half full, so the probe sequences stay short and the table is never rehashed
+	size_t capacity = 16;
+	while (capacity < count * 2)
+	{
+		capacity *= 2;
+	}
+	size_t mask = capacity - 1;
+
+	std::vector<uint32_t> table(capacity, EMPTY_SLOT);
+	// The hashes of the unique vertices, most of the mismatches are rejected without reading the vertex
+	std::vector<uint64_t> uniqueHashes;
+	uniqueHashes.reserve(count / 2);
+	firstCorners.reserve(count / 2);
+
+	for (size_t i = 0; i < count; ++i)
+	{
+		const char* corner = corners + i * stride;
+		uint64_t hash = hashBytes(corner, stride);
+
+		size_t slot = static_cast<size_t>(hash) & mask;
+		while (true)
+		{
+			uint32_t unique = table[slot];
+			if (unique == EMPTY_SLOT)
+			{
+				unique = static_cast<uint32_t>(firstCorners.size());
+				table[slot] = unique;
+				uniqueHashes.emplace_back(hash);
+				firstCorners.emplace_back(static_cast<uint32_t>(i));
+				indices[i] = unique;
+				break;
+			}
+			if (uniqueHashes[unique] == hash && memcmp(corners + firstCorners[unique] * stride, corner, stride) == 0)
+			{
+				indices[i] = unique;
+				break;
+			}
+			slot = (slot + 1) & mask;
+		}
+	}
+}
+
+
+
+void VertexWelder::weldSorted(const char* corners, size_t stride, size_t count, std::vector<uint32_t>& indices, std::vector<uint32_t>& firstCorners)
+{
+	size_t blockCount = (count + BLOCK_SIZE - 1) / BLOCK_SIZE;
+
+	// 1. Hashing the corners
+	std::vector<CornerKey> keys(count);
+	pool.parallelFor(blockCount, [&](size_t block)
+	{
+		size_t end = std::min(count, (block + 1) * BLOCK_SIZE);
+		for (size_t i = block * BLOCK_SIZE; i < end; ++i)
+		{
+			keys[i].hash = hashBytes(corners + i * stride, stride);
+			keys[i].corner = static_cast<uint32_t>(i);
+		}
+	});
+
+	// 2. Sorting the runs of keys on the threads and merging them pairwise
+	size_t runCount = std::min<size_t>(blockCount, pool.size() + 1);
+	std::vector<size_t> runBegins(runCount + 1);
+	for (size_t run = 0; run <= runCount; ++run)
+	{
+		runBegins[run] = count * run / runCount;
+	}
+
+	pool.parallelFor(runCount, [&](size_t run)
+	{
+		std::sort(keys.begin() + runBegins[run], keys.begin() + runBegins[run + 1]);
+	});
+
+	for (size_t width = 1; width < runCount; width *= 2)
+	{
+		size_t mergeCount = (runCount + 2 * width - 1) / (2 * width);
+		pool.parallelFor(mergeCount, [&](size_t merge)
+		{
+			size_t first = merge * 2 * width;
+			size_t middle = std::min(first + width, runCount);
+			size_t last = std::min(first + 2 * width, runCount);
+			if (middle < last)
+			{
+				std::inplace_merge(keys.begin() + runBegins[first], keys.begin() + runBegins[middle], keys.begin() + runBegins[last]);
+			}
+		});
+	}
+
+	// 3. Finding the first equal corner for each corner, the groups of equal hashes don't cross the ranges
+	std::vector<size_t> rangeBegins(blockCount + 1, count);
+	rangeBegins[0] = 0;
+	for (size_t block = 1; block < blockCount; ++block)
+	{
+		size_t begin = std::max(block * BLOCK_SIZE, rangeBegins[block - 1]);
+		while (begin < count && keys[begin].hash == keys[begin - 1].hash)
+		{
+			++begin;
+		}
+		rangeBegins[block] = begin;
+	}
+
+	std::vector<uint32_t> canonical(count);
+	pool.parallelFor(blockCount, [&](size_t block)
+	{
+		std::vector<uint32_t> groupUniques;
+		size_t i = rangeBegins[block];
+		size_t end = rangeBegins[block + 1];
+		while (i < end)
+		{
+			size_t groupEnd = i + 1;
+			while (groupEnd < end && keys[groupEnd].hash == keys[i].hash)
+			{
+				++groupEnd;
+			}
+
+			// The corners of the group go in increasing order, so the first match is the earliest equal corner
+			groupUniques.clear();
+			for (size_t k = i; k < groupEnd; ++k)
+			{
+				uint32_t corner = keys[k].corner;
+				uint32_t match = corner;
+				for (uint32_t unique : groupUniques)
+				{
+					if (memcmp(corners + static_cast<size_t>(unique) * stride, corners + static_cast<size_t>(corner) * stride, stride) == 0)
+					{
+						match = unique;
+						break;
+					}
+				}
+				if (match == corner)
+				{
+					groupUniques.emplace_back(corner);
+				}
+				canonical[corner] = match;
+			}
+			i = groupEnd;
+		}
+	});
+
+	// 4. Numbering the unique vertices in order of their first corner
+	std::vector<uint32_t> blockUniqueCounts(blockCount, 0);
+	pool.parallelFor(blockCount, [&](size_t block)
+	{
+		size_t end = std::min(count, (block + 1) * BLOCK_SIZE);
+		uint32_t uniqueCount = 0;
+		for (size_t i = block * BLOCK_SIZE; i < end; ++i)
+		{
+			uniqueCount += (canonical[i] == i) ? 1 : 0;
+		}
+		blockUniqueCounts[block] = uniqueCount;
+	});
+
+	std::vector<uint32_t> blockFirstUnique(blockCount, 0);
+	uint32_t uniqueTotal = 0;
+	for (size_t block = 0; block < blockCount; ++block)
+	{
+		blockFirstUnique[block] = uniqueTotal;
+		uniqueTotal += blockUniqueCounts[block];
+	}
+	firstCorners.resize(uniqueTotal);
+
+	// The number of the unique vertex is written to the slot of its first corner
+	pool.parallelFor(blockCount, [&](size_t block)
+	{
+		size_t end = std::min(count, (block + 1) * BLOCK_SIZE);
+		uint32_t unique = blockFirstUnique[block];
+		for (size_t i = block * BLOCK_SIZE; i < end; ++i)
+		{
+			if (canonical[i] == i)
+			{
+				firstCorners[unique] = static_cast<uint32_t>(i);
+				indices[i] = unique++;
+			}
+		}
+	});
+
+	pool.parallelFor(blockCount, [&](size_t block)
+	{
+		size_t end = std::min(count, (block + 1) * BLOCK_SIZE);
+		for (size_t i = block * BLOCK_SIZE; i < end; ++i)
+		{
+			if (canonical[i] != i)
+			{
+				indices[i] = indices[canonical[i]];
+			}
+		}
+	});
+}
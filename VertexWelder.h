@@ -0,0 +1,56 @@
+// VertexWelder.h
+
+#ifndef VERTEXWELDER_H
+#define VERTEXWELDER_H
+
+#include "ThreadPool.h"
+
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// The class that merges the equal corners of the triangles into the unique vertices of the index buffer
+/// The vertices are compared by their bytes, so the vertex type must not contain padding
+/// The bytes of -0.0f and +0.0f differ, the callers pass the float vertices through canonicalizeZeros() first, so they are welded like operator== of the floats did
+/// The unique vertices are numbered in order of their first appearance, both modes give the same result
+class VertexWelder
+{
+public:
+	// The number of corners from which the parallel sort-based mode is used
+	static const size_t PARALLEL_THRESHOLD = size_t(1) << 20;
+
+	explicit VertexWelder(ThreadPool& pool);
+
+	// 1. Function to weld the corners of the triangles, corners[i] becomes vertices[indices[i]]
+	template<typename VertexType>
+	void weld(const std::vector<VertexType>& corners, std::vector<VertexType>& vertices, std::vector<uint32_t>& indices)
+	{
+		std::vector<uint32_t> firstCorners;
+		weld(corners.data(), sizeof(VertexType), corners.size(), indices, firstCorners);
+
+		vertices.resize(firstCorners.size());
+		for (size_t i = 0; i < firstCorners.size(); ++i)
+		{
+			vertices[i] = corners[firstCorners[i]];
+		}
+	}
+
+	// 2. Function to weld the array of corners with the given stride
+	/// indices gets the number of the unique vertex for each corner, firstCorners gets the corner of each unique vertex
+	void weld(const void* corners, size_t stride, size_t count, std::vector<uint32_t>& indices, std::vector<uint32_t>& firstCorners);
+
+	// 3. Function to hash the bytes of the vertex
+	static uint64_t hashBytes(const void* data, size_t size);
+	// 4. Function to replace -0.0f by +0.0f in the array of floats of the given size in bytes
+	static void canonicalizeZeros(void* data, size_t size);
+
+private:
+	// The single thread mode with the open addressing table presized from the number of corners
+	void weldHashTable(const char* corners, size_t stride, size_t count, std::vector<uint32_t>& indices, std::vector<uint32_t>& firstCorners);
+	// The parallel mode which sorts the corners by their hashes and takes the first corner of each group of equals
+	void weldSorted(const char* corners, size_t stride, size_t count, std::vector<uint32_t>& indices, std::vector<uint32_t>& firstCorners);
+
+	ThreadPool& pool;
+};
+
+#endif // VERTEXWELDER_H
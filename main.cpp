@@ -7,12 +7,33 @@
 #define STB_IMAGE_IMPLEMENTATION
 
 #include "Setup.h"
+#include "Benchmark.h"
 
 int SDL_main(int argc, char* argv[])
 {
 	try
 	{
-		Setup setup;
+		// The benchmarks of the loading stages are started instead of the window
+		if (argc > 1)
+		{
+			Benchmark benchmark;
+			if (benchmark.run(argv[1]))
+			{
+				return 0;
+			}
+		}
+
+		// The number of the frames that the CPU prepares ahead of the GPU, from 1 for the lowest latency to Screen::MAX_FRAMES_IN_FLIGHT
+		uint32_t framesInFlight = 2;
+		for (int i = 1; i + 1 < argc; ++i)
+		{
+			if (std::string(argv[i]) == "--frames-in-flight")
+			{
+				framesInFlight = static_cast<uint32_t>(std::stoul(argv[i + 1]));
+			}
+		}
+
+		Setup setup(framesInFlight);
 	}
 	catch (const std::exception& ex)
 	{